@@ -49,7 +49,7 @@ bool AdaptiveLoopSubdivisionMesh::subdivide(float flatAngle)
 			unsigned int e0, e1, e2;
 			e0 = (*it).edge;
 			e1 = mEdges[(*it).edge].next;
-			e2 = mEdges[(*it).edge].prev;
+			e2 = prev((*it).edge);
 
 
 			// Compute positions of the vertices
@@ -119,7 +119,7 @@ void AdaptiveLoopSubdivisionMesh::treatFlatFaces(HalfEdgeMesh& subDivMesh)
 			for (unsigned int i = 0; i < 3; i++)
 			{
 				// See if edge is shared by subdivided triangle
-				unsigned int neighbourFace = mEdges[mEdges[edge].pair].face;
+				unsigned int neighbourFace = mEdges[pair(edge)].face;
 				if (mFlatness[neighbourFace] == 0)
 				{
 					sharedEdges.push_back(edge);
@@ -149,7 +149,7 @@ void AdaptiveLoopSubdivisionMesh::treatFlatFaces(HalfEdgeMesh& subDivMesh)
 						verts[i] = computeVertex(edge);
 					}
 					else{
-						verts[i] = mVerts[mEdges[edge].vert].vec;
+						verts[i] = mVertPositions[mEdges[edge].vert];
 					}
 
 					edge = mEdges[edge].next;
@@ -169,7 +169,7 @@ void AdaptiveLoopSubdivisionMesh::treatFlatFaces(HalfEdgeMesh& subDivMesh)
 				unsigned int e0, e1, e2;
 				e0 = sharedEdge;
 				e1 = mEdges[e0].next;
-				e2 = mEdges[e0].prev;
+				e2 = prev(e0);
 
 				// Compute positions of the old vertices
 				Vector3<float> pn0 = computeVertex(e0);
@@ -195,7 +195,7 @@ void AdaptiveLoopSubdivisionMesh::treatFlatFaces(HalfEdgeMesh& subDivMesh)
 				unsigned int e0, e1, e2;
 				e0 = sharedEdge1;
 				e1 = mEdges[e0].next;
-				e2 = mEdges[e0].prev;
+				e2 = prev(e0);
 
 				// Compute positions of the old vertices
 				Vector3<float> pn0 = computeVertex(e0);
@@ -257,10 +257,10 @@ void AdaptiveLoopSubdivisionMesh::findFlatTriangles(float flatAngle)
 		unsigned int neighbourFaceIndex3;
 		findTriangleNeighbours(*it, neighbourFaceIndex1, neighbourFaceIndex2, neighbourFaceIndex3);
 
-		const Vector3<float>& thisNormal = (*it).normal;
-		const Vector3<float>& face1Normal = mFaces[neighbourFaceIndex1].normal;
-		const Vector3<float>& face2Normal = mFaces[neighbourFaceIndex2].normal;
-		const Vector3<float>& face3Normal = mFaces[neighbourFaceIndex3].normal;
+		const Vector3<float>& thisNormal = mFaceNormals[it - mFaces.begin()];
+		const Vector3<float>& face1Normal = mFaceNormals[neighbourFaceIndex1];
+		const Vector3<float>& face2Normal = mFaceNormals[neighbourFaceIndex2];
+		const Vector3<float>& face3Normal = mFaceNormals[neighbourFaceIndex3];
 
 		//Test angles
 		bool flat = true; // flat face?
@@ -331,11 +331,11 @@ void AdaptiveLoopSubdivisionMesh::findTriangleNeighbours(const Face& face, unsig
 	// Find neighbour faces
 	unsigned int edgeIndex = face.edge;
 
-	neighbourIndex1 = mEdges[mEdges[edgeIndex].pair].face;
+	neighbourIndex1 = mEdges[pair(edgeIndex)].face;
 	edgeIndex = mEdges[edgeIndex].next;
-	neighbourIndex2 = mEdges[mEdges[edgeIndex].pair].face;
+	neighbourIndex2 = mEdges[pair(edgeIndex)].face;
 	edgeIndex = mEdges[edgeIndex].next;
-	neighbourIndex3 = mEdges[mEdges[edgeIndex].pair].face;
+	neighbourIndex3 = mEdges[pair(edgeIndex)].face;
 
 }
 
@@ -351,7 +351,7 @@ unsigned int AdaptiveLoopSubdivisionMesh::findSharedEdge(const Face& face1, cons
 		// Loop trough edges of triangle 2 and compare their pair with triangle 1
 		unsigned int f2EdgeIndex = face2.edge;
 		for (int j = 0; j < 3; j++){
-			if (f1EdgeIndex == mEdges[f2EdgeIndex].pair){
+			if (f1EdgeIndex == pair(f2EdgeIndex)){
 				sharedEdge = f1EdgeIndex;
 				numShared++;
 			}
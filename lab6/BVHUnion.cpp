@@ -0,0 +1,229 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#include "BVHUnion.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+BVHUnion::BVHUnion(const Implicit * root, float tolerance) : mBlend(0), mTolerance(tolerance)
+{
+  const BlendedUnion * blended = dynamic_cast<const BlendedUnion *>(root);
+  if (blended != NULL && blended->getBlend() > 0)
+    mBlend = blended->getBlend();
+
+  collect(root);
+  if (!mLeafs.empty())
+    build(0, mLeafs.size());
+
+  mBox = root->getBoundingBox();
+}
+
+
+void BVHUnion::collect(const Implicit * root)
+{
+  // The chains of unions can be thousands of nodes deep, so walk them without recursion
+  std::vector<const Implicit *> stack(1, root);
+  while (!stack.empty()) {
+    const Implicit * node = stack.back();
+    stack.pop_back();
+
+    const CSG_Operator * op = NULL;
+    if (mBlend == 0)
+      op = dynamic_cast<const Union *>(node);
+    else {
+      const BlendedUnion * blended = dynamic_cast<const BlendedUnion *>(node);
+      if (blended != NULL && blended->getBlend() == mBlend) op = blended;
+    }
+    if (op != NULL) {
+      stack.push_back(op->getRight());
+      stack.push_back(op->getLeft());
+      continue;
+    }
+
+    Leaf leaf;
+    if (!node->getValueBound(leaf.mA, leaf.mB)) {
+      mUnbounded.push_back(node);
+      continue;
+    }
+    leaf.mImplicit = node;
+    leaf.mBox = node->getBoundingBox();
+    leaf.mCenter = (leaf.mBox.pMin + leaf.mBox.pMax) * 0.5f;
+    mLeafs.push_back(leaf);
+  }
+}
+
+
+int BVHUnion::build(int first, int count)
+{
+  // Children are added after the parent, so fill in the node last
+  const int index = mNodes.size();
+  mNodes.push_back(Node());
+
+  Node node;
+  node.mFirst = first;
+  node.mCount = count;
+  node.mBox = mLeafs[first].mBox;
+  node.mA = mLeafs[first].mA;
+  node.mB = mLeafs[first].mB;
+  Bbox centers(mLeafs[first].mCenter, mLeafs[first].mCenter);
+  for (int n = first + 1; n < first + count; n++) {
+    node.mBox = boxUnion(node.mBox, mLeafs[n].mBox);
+    node.mA = std::min(node.mA, mLeafs[n].mA);
+    node.mB = std::min(node.mB, mLeafs[n].mB);
+    centers = pointUnion(centers, mLeafs[n].mCenter);
+  }
+
+  if (count <= LEAF_SIZE)
+    node.mRight = -1;
+  else {
+    // Split at the median center along the longest axis
+    const Vector3<float> extent = centers.pMax - centers.pMin;
+    int axis = 0;
+    if (extent[1] > extent[axis]) axis = 1;
+    if (extent[2] > extent[axis]) axis = 2;
+
+    const int half = count / 2;
+    std::nth_element(mLeafs.begin() + first, mLeafs.begin() + first + half,
+                     mLeafs.begin() + first + count, CenterLess(axis));
+    build(first, half);
+    node.mRight = build(first + half, count - half);
+  }
+
+  mNodes[index] = node;
+  return index;
+}
+
+
+float BVHUnion::distance(const Bbox & box, float x, float y, float z)
+{
+  const float dx = std::max(std::max(box.pMin.x() - x, x - box.pMax.x()), 0.f);
+  const float dy = std::max(std::max(box.pMin.y() - y, y - box.pMax.y()), 0.f);
+  const float dz = std::max(std::max(box.pMin.z() - z, z - box.pMax.z()), 0.f);
+  return std::sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+
+float BVHUnion::getBlendSkipBound(double sum) const
+{
+  // Contributions below the smallest double vanish from the sum anyway
+  const double skip = std::max(mTolerance * mBlend / getNumImplicits() * sum, std::numeric_limits<double>::denorm_min());
+  return -std::log(skip) / mBlend;
+}
+
+
+float BVHUnion::getValue(float x, float y, float z) const
+{
+  return evaluate(x, y, z, NULL, NULL, 0);
+}
+
+
+float BVHUnion::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const
+{
+  return evaluate(x, y, z, &gradient, &curvature, delta);
+}
+
+
+void BVHUnion::add(const Implicit * implicit, float x, float y, float z, float delta, bool derivatives, Sum & sum) const
+{
+  Vector3<float> gradient;
+  float curvature = 0;
+  const float value = derivatives ? implicit->getValueAndDerivatives(x,y,z, gradient, curvature, delta) : implicit->getValue(x,y,z);
+
+  if (mBlend == 0) {
+    if (value < sum.mValue) {
+      sum.mValue = value;
+      if (derivatives) {
+        for (unsigned int i = 0; i < 3; i++) sum.mGradient[i] = gradient[i];
+        sum.mCurvature = curvature;
+      }
+    }
+  }
+  else {
+    const double weight = std::exp(-(double)mBlend * value);
+    sum.mSum += weight;
+    if (derivatives) {
+      for (unsigned int i = 0; i < 3; i++) sum.mGradient[i] += weight*gradient[i];
+      sum.mCurvature += weight*curvature;
+      sum.mGradientNorm += weight*gradient.norm();
+    }
+  }
+}
+
+
+float BVHUnion::evaluate(float x, float y, float z, Vector3<float> * gradient, float * curvature, float delta) const
+{
+  // For a union the value is the smallest value, and implicits whose bound is
+  // at least the smallest value found so far are skipped. The blended union is
+  // -log(sum of exp(-p*value))/p, an implicit with bound g adds at most exp(-p*g)
+  // to the sum, and skipping only when that is below tolerance*p*sum/N changes
+  // the value by at most tolerance. Both become a test g >= skipBound. The sum
+  // is kept in double so far from the spheres it does not underflow to zero
+  const bool derivatives = gradient != NULL;
+  Sum sum = { std::numeric_limits<float>::max(), 0, { 0, 0, 0 }, 0, 0 };
+  for (unsigned int n = 0; n < mUnbounded.size(); n++)
+    add(mUnbounded[n], x, y, z, delta, derivatives, sum);
+  float skipBound = mBlend == 0 ? sum.mValue : getBlendSkipBound(sum.mSum);
+
+  // Nodes left to visit and their distance from (x,y,z). The hierarchy is
+  // balanced, so the stack never holds more than one node per level
+  int stack[64];
+  float stackDist[64];
+  int top = 0;
+  if (!mNodes.empty()) {
+    stack[0] = 0;
+    stackDist[0] = distance(mNodes[0].mBox, x, y, z);
+    top = 1;
+  }
+
+  while (top > 0) {
+    top--;
+    const Node & node = mNodes[stack[top]];
+    const float d = stackDist[top];
+    if (d > 0 && (node.mA*d + node.mB)*d >= skipBound) continue;
+
+    if (node.mRight < 0) {
+      for (int n = node.mFirst; n < node.mFirst + node.mCount; n++) {
+        const Leaf & leaf = mLeafs[n];
+        const float dl = distance(leaf.mBox, x, y, z);
+        if (dl > 0 && (leaf.mA*dl + leaf.mB)*dl >= skipBound) continue;
+
+        add(leaf.mImplicit, x, y, z, delta, derivatives, sum);
+        skipBound = mBlend == 0 ? sum.mValue : getBlendSkipBound(sum.mSum);
+      }
+    }
+    else {
+      // Visit the nearer child first, it is more likely to tighten the bound
+      const int left = stack[top] + 1, right = node.mRight;
+      const float dLeft = distance(mNodes[left].mBox, x, y, z);
+      const float dRight = distance(mNodes[right].mBox, x, y, z);
+      const bool leftFirst = dLeft <= dRight;
+      stack[top] = leftFirst ? right : left;  stackDist[top++] = leftFirst ? dRight : dLeft;
+      stack[top] = leftFirst ? left : right;  stackDist[top++] = leftFirst ? dLeft : dRight;
+    }
+  }
+
+  if (mBlend == 0) {
+    if (derivatives) {
+      *gradient = Vector3<float>(sum.mGradient[0], sum.mGradient[1], sum.mGradient[2]);
+      *curvature = sum.mCurvature;
+    }
+    return sum.mValue;
+  }
+
+  if (derivatives) {
+    // See CSG_Operator::blendDerivatives()
+    const double gx = sum.mGradient[0] / sum.mSum, gy = sum.mGradient[1] / sum.mSum, gz = sum.mGradient[2] / sum.mSum;
+    *gradient = Vector3<float>(gx, gy, gz);
+    *curvature = sum.mCurvature / sum.mSum - mBlend * (sum.mGradientNorm / sum.mSum - (gx*gx + gy*gy + gz*gz));
+  }
+  return -std::log(sum.mSum) / mBlend;
+}
@@ -0,0 +1,111 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#ifndef __bvh_union_h__
+#define __bvh_union_h__
+
+#include "Implicit.h"
+#include "CSG.h"
+#include <vector>
+
+/*! \brief Union of many implicits evaluated through a bounding volume hierarchy
+ *
+ * The Union nodes, or BlendedUnion nodes with the same blending exponent, at the
+ * root of a CSG tree are flattened into a list of implicits, and an axis aligned
+ * box hierarchy is built over them. Implicits that bound their value outside
+ * their bounding box (Implicit::getValueBound) are skipped at query time when
+ * they cannot affect the result: for a union, subtrees whose bound is no smaller
+ * than the smallest value found so far, which gives exactly the value of the
+ * tree; for a blended union, subtrees whose contribution to the blend changes
+ * the value by less than the tolerance in total.
+ *
+ * The tree is not copied and must outlive the BVHUnion.
+ */
+class BVHUnion : public Implicit {
+public:
+  BVHUnion(const Implicit * root, float tolerance = 1e-5f);
+
+  virtual float getValue(float x, float y, float z) const;
+  /*!
+   * The derivatives of a union are those of the smallest value. Those of a
+   * blended union are mixed from the implicits evaluated, the ones skipped
+   * carry a weight below the tolerance.
+   */
+  virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const;
+  virtual Vector3<float> getGradient(float x, float y, float z, float delta = 1e-3) const { return getDerivativesGradient(x, y, z, delta); }
+
+  //! Returns the number of implicits in the union
+  int getNumImplicits() const { return mLeafs.size() + mUnbounded.size(); }
+
+protected:
+  //! Maximum number of implicits in a leaf node
+  static const int LEAF_SIZE = 4;
+
+  struct Leaf {
+    const Implicit * mImplicit;
+    Bbox mBox;
+    Vector3<float> mCenter;
+    //! Value bound a*d*d + b*d outside the box
+    float mA, mB;
+  };
+
+  struct Node {
+    Bbox mBox;
+    //! Value bound of all implicits below the node
+    float mA, mB;
+    //! Range of the implicits below the node in mLeafs
+    int mFirst, mCount;
+    //! Index of the second child, the first child follows the node. -1 for leaf nodes
+    int mRight;
+  };
+
+  //! The union or blended union of the implicits evaluated so far
+  struct Sum {
+    //! Smallest value for a union
+    float mValue;
+    //! Sum of exp(-p*value) for a blended union
+    double mSum;
+    //! Derivatives of the smallest value, or their sums weighted by exp(-p*value),
+    //! mGradientNorm being that of the squared gradient lengths
+    double mGradient[3], mCurvature, mGradientNorm;
+  };
+
+  //! Orders leafs by their center along one axis
+  struct CenterLess {
+    int mAxis;
+    CenterLess(int axis) : mAxis(axis) { }
+    bool operator()(const Leaf & l1, const Leaf & l2) const { return l1.mCenter[mAxis] < l2.mCenter[mAxis]; }
+  };
+
+  //! Adds the implicits below root to mLeafs and mUnbounded
+  void collect(const Implicit * root);
+  //! Builds the subtree over count leafs from first, returns its index
+  int build(int first, int count);
+  //! Evaluates the union, and its derivatives if gradient is not NULL
+  float evaluate(float x, float y, float z, Vector3<float> * gradient, float * curvature, float delta) const;
+  //! Adds the value of implicit at (x,y,z) to sum, with its derivatives if derivatives is set
+  void add(const Implicit * implicit, float x, float y, float z, float delta, bool derivatives, Sum & sum) const;
+  //! Returns the value bound above which implicits are skipped for the blended sum so far
+  float getBlendSkipBound(double sum) const;
+  //! Distance from (x,y,z) to the box, zero inside
+  static float distance(const Bbox & box, float x, float y, float z);
+
+  std::vector<Node> mNodes;
+  std::vector<Leaf> mLeafs;
+  //! Implicits without a value bound, always evaluated
+  std::vector<const Implicit *> mUnbounded;
+
+  //! Blending exponent, zero for a plain union
+  float mBlend;
+  float mTolerance;
+};
+
+#endif
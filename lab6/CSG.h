@@ -14,13 +14,44 @@
 #define __CSG_H__
 
 #include "Implicit.h"
+#include "ImplicitProgram.h"
 
 
 /*! \brief CSG Operator base class */
 class CSG_Operator : public Implicit
 	{
 
+	public:
+		const Implicit * getLeft() const { return left; }
+		const Implicit * getRight() const { return right; }
+
+		virtual Vector3<float> getGradient(float x, float y, float z, float delta = 1e-3) const {
+			return getDerivativesGradient(x, y, z, delta);
+			}
+
 	protected:
+		//! Adds the instructions of both children followed by the operator
+		void compileOperator(ImplicitProgram & program, ImplicitProgram::OpCode op, float p = 0) const {
+			left->compile(program);
+			right->compile(program);
+			program.addOperator(op, p);
+			}
+
+		/*!
+		 * Sets the derivatives of the blend -log(exp(-p a) + exp(-p b))/p from
+		 * those of a and b. The gradient is the mean of the gradients weighted by
+		 * exp(-p a) and exp(-p b), the curvature likewise less p times the
+		 * spread of the gradients around the mean.
+		 */
+		static void blendDerivatives(float p, float a, const Vector3<float> & ga, float ca,
+		                             float b, const Vector3<float> & gb, float cb,
+		                             Vector3<float> & gradient, float & curvature) {
+			const float wa = 1.0f / (1.0f + exp(-p*(b - a)));
+			const float wb = 1.0f - wa;
+			gradient = ga*wa + gb*wb;
+			curvature = wa*ca + wb*cb - p*(wa*ga.norm() + wb*gb.norm() - gradient.norm());
+			}
+
 		//! Constructor
 		CSG_Operator(Implicit * l, Implicit * r) : left(l), right(r) { }
 
@@ -39,6 +70,10 @@ class Union : public CSG_Operator
 			mBox = boxUnion(l->getBoundingBox(), r->getBoundingBox());
 			}
 
+		virtual void compile(ImplicitProgram & program) const {
+			compileOperator(program, ImplicitProgram::UNION);
+			}
+
 		virtual float getValue(float x, float y, float z) const {
 			// Get values from left and right children and perform the
 			// boolean operation. The coordinates (x,y,z) are passed in
@@ -47,6 +82,20 @@ class Union : public CSG_Operator
 
 			return std::min( left->getValue(x,y,z), right->getValue(x,y,z) );
 			}
+
+		virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const {
+			// The derivatives are those of the child giving the value
+			Vector3<float> gb;
+			float cb;
+			const float a = left->getValueAndDerivatives(x,y,z, gradient, curvature, delta);
+			const float b = right->getValueAndDerivatives(x,y,z, gb, cb, delta);
+			if (b < a) {
+				gradient = gb;
+				curvature = cb;
+				return b;
+				}
+			return a;
+			}
 	};
 
 
@@ -60,6 +109,10 @@ class Intersection : public CSG_Operator
 			mBox = boxIntersection(l->getBoundingBox(), r->getBoundingBox());
 			}
 
+		virtual void compile(ImplicitProgram & program) const {
+			compileOperator(program, ImplicitProgram::INTERSECTION);
+			}
+
 		virtual float getValue(float x, float y, float z) const {
 			// Get values from left and right children and perform the
 			// boolean operation. The coordinates (x,y,z) are passed in
@@ -68,6 +121,20 @@ class Intersection : public CSG_Operator
 
 			return std::max( left->getValue(x,y,z), right->getValue(x,y,z) );
 			}
+
+		virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const {
+			// The derivatives are those of the child giving the value
+			Vector3<float> gb;
+			float cb;
+			const float a = left->getValueAndDerivatives(x,y,z, gradient, curvature, delta);
+			const float b = right->getValueAndDerivatives(x,y,z, gb, cb, delta);
+			if (a < b) {
+				gradient = gb;
+				curvature = cb;
+				return b;
+				}
+			return a;
+			}
 	};
 
 /*! \brief Difference boolean operation */
@@ -80,6 +147,10 @@ class Difference : public CSG_Operator
 			mBox = boxDifference(l->getBoundingBox(), r->getBoundingBox());
 			} 
 
+		virtual void compile(ImplicitProgram & program) const {
+			compileOperator(program, ImplicitProgram::DIFFERENCE);
+			}
+
 		virtual float getValue(float x, float y, float z) const {
 			// Get values from left and right children and perform the
 			// boolean operation. The coordinates (x,y,z) are passed in
@@ -88,6 +159,20 @@ class Difference : public CSG_Operator
 
 			return std::max( left->getValue(x,y,z), -(right->getValue(x,y,z)) );
 			}
+
+		virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const {
+			// The derivatives are those of the left child or the negated right child
+			Vector3<float> gb;
+			float cb;
+			const float a = left->getValueAndDerivatives(x,y,z, gradient, curvature, delta);
+			const float b = right->getValueAndDerivatives(x,y,z, gb, cb, delta);
+			if (a < -b) {
+				gradient = gb * -1.0f;
+				curvature = -cb;
+				return -b;
+				}
+			return a;
+			}
 	};
 
 //Blended
@@ -106,6 +191,13 @@ class BlendedUnion : public CSG_Operator
 			mBox = boxUnion(l->getBoundingBox(), r->getBoundingBox());
 			}
 
+		//! Returns the blending exponent
+		float getBlend() const { return p; }
+
+		virtual void compile(ImplicitProgram & program) const {
+			compileOperator(program, ImplicitProgram::BLENDED_UNION, p);
+			}
+
 		virtual float getValue(float x, float y, float z) const {
 			// Get values from left and right children and perform the
 			// boolean operation. The coordinates (x,y,z) are passed in
@@ -122,6 +214,18 @@ class BlendedUnion : public CSG_Operator
 			//float Db = exp(-right->getValue(x,y,z) );
 			//return  log( pow( pow(Da, p) + pow(Db, p), 1.0f/p ) );
 			}
+
+		virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const {
+			Vector3<float> ga, gb;
+			float ca, cb;
+			const float a = left->getValueAndDerivatives(x,y,z, ga, ca, delta);
+			const float b = right->getValueAndDerivatives(x,y,z, gb, cb, delta);
+			blendDerivatives(p, a, ga, ca, b, gb, cb, gradient, curvature);
+
+			float Da = exp(-a * p );
+			float Db = exp(-b * p );
+			return -log( pow( Da + Db, 1.0f/p ) );
+			}
 	};
 
 
@@ -140,6 +244,10 @@ class BlendedIntersection : public CSG_Operator
 			mBox = boxIntersection(l->getBoundingBox(), r->getBoundingBox());
 			}
 
+		virtual void compile(ImplicitProgram & program) const {
+			compileOperator(program, ImplicitProgram::BLENDED_INTERSECTION, p);
+			}
+
 		virtual float getValue(float x, float y, float z) const {
 			// Get values from left and right children and perform the
 			// boolean operation. The coordinates (x,y,z) are passed in
@@ -150,6 +258,18 @@ class BlendedIntersection : public CSG_Operator
 			float Db = exp(-right->getValue(x,y,z)* -p );
 			return -log( pow( Da + Db, 1.0f/-p ) );
 			}
+
+		virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const {
+			Vector3<float> ga, gb;
+			float ca, cb;
+			const float a = left->getValueAndDerivatives(x,y,z, ga, ca, delta);
+			const float b = right->getValueAndDerivatives(x,y,z, gb, cb, delta);
+			blendDerivatives(-p, a, ga, ca, b, gb, cb, gradient, curvature);
+
+			float Da = exp(-a * -p );
+			float Db = exp(-b * -p );
+			return -log( pow( Da + Db, 1.0f/-p ) );
+			}
 	};
 
 /*! \brief BlendedDifference boolean operation */
@@ -167,6 +287,10 @@ class BlendedDifference : public CSG_Operator
 			mBox = boxDifference(l->getBoundingBox(), r->getBoundingBox());
 			} 
 
+		virtual void compile(ImplicitProgram & program) const {
+			compileOperator(program, ImplicitProgram::BLENDED_DIFFERENCE, p);
+			}
+
 		virtual float getValue(float x, float y, float z) const {
 			// Get values from left and right children and perform the
 			// boolean operation. The coordinates (x,y,z) are passed in
@@ -177,6 +301,19 @@ class BlendedDifference : public CSG_Operator
 			float Db = exp( right->getValue(x,y,z)* -p );
 			return -log( pow( Da + Db, 1.0f/-p ) );
 			}
+
+		virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const {
+			// The blended intersection with the negated right child
+			Vector3<float> ga, gb;
+			float ca, cb;
+			const float a = left->getValueAndDerivatives(x,y,z, ga, ca, delta);
+			const float b = right->getValueAndDerivatives(x,y,z, gb, cb, delta);
+			blendDerivatives(-p, a, ga, ca, -b, gb * -1.0f, -cb, gradient, curvature);
+
+			float Da = exp(-a * -p );
+			float Db = exp( b * -p );
+			return -log( pow( Da + Db, 1.0f/-p ) );
+			}
 	};
 
 
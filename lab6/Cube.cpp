@@ -1,4 +1,5 @@
 #include "Cube.h"
+#include "ImplicitProgram.h"
 
 Cube::Cube()
 {
@@ -93,3 +94,39 @@ float Cube::getValue(float x, float y, float z) const
 
   return value;
 }
+
+
+float Cube::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const
+{
+  // The derivatives are those of the plane giving the value, taken in the
+  // frame of the cube. The planes are linear, so the curvature is zero
+  Vector4<float> vprim, v = Vector4<float>(x, y, z, 1.f);
+  vprim = mWorld2Obj*v;
+
+  float value = mPlanes[0]->getValueAndDerivatives(vprim[0], vprim[1], vprim[2], gradient, curvature);
+  for (unsigned int i = 1; i < mPlanes.size(); i++){
+    Vector3<float> planeGradient;
+    const float planeValue = mPlanes[i]->getValueAndDerivatives(vprim[0], vprim[1], vprim[2], planeGradient, curvature);
+    if (value < planeValue) {
+      value = planeValue;
+      gradient = planeGradient;
+    }
+  }
+  gradient = gradientObj2World(gradient);
+  curvature = 0;
+
+  return value;
+}
+
+
+void Cube::compile(ImplicitProgram & program) const
+{
+  // The planes are evaluated in the frame of the cube
+  program.pushFrame(mWorld2Obj);
+  mPlanes[0]->compile(program);
+  for (unsigned int i = 1; i < mPlanes.size(); i++){
+    mPlanes[i]->compile(program);
+    program.addOperator(ImplicitProgram::INTERSECTION);
+  }
+  program.popFrame();
+}
@@ -10,6 +10,7 @@
  *
  *************************************************************************************************/
 #include "Cyclide.h"
+#include "ImplicitProgram.h"
 
 Cyclide::Cyclide(){
   this->A = 1.5;
@@ -42,3 +43,28 @@ float Cyclide::getValue(float x, float y, float z) const{
 		   );
   return f;
 }
+
+float Cyclide::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const{
+  // f = s^2 - 4((A x - C D)^2 + B^2 y^2) with s = |q|^2 + B^2 - D^2 in object
+  // space has gradient 4 s q - 8(A (A x - C D), B^2 y, 0) and Hessian
+  // 4 s I + 8 q q^T - 8 diag(A^2, B^2, 0). The Laplacian in world space of a
+  // Hessian H in object space is trace(M^T H M)
+  Vector4<float> vprim, v = Vector4<float>(x, y, z, 1.f);
+  vprim = mWorld2Obj*v;
+  const Vector3<float> q(vprim[0], vprim[1], vprim[2]);
+  const float s = q.norm() + B*B - D*D;
+  const float ax = A*vprim[0] - C*D;
+
+  gradient = gradientObj2World(Vector3<float>(4.f*s*q[0] - 8.f*A*ax,
+                                              4.f*s*q[1] - 8.f*B*B*q[1],
+                                              4.f*s*q[2]));
+  const float rowNorm0 = getWorld2ObjRowNorm(0), rowNorm1 = getWorld2ObjRowNorm(1);
+  curvature = 4.f*s*(rowNorm0 + rowNorm1 + getWorld2ObjRowNorm(2))
+    + 8.f*gradientObj2World(q).norm() - 8.f*(A*A*rowNorm0 + B*B*rowNorm1);
+
+  return s*s - 4.f*(ax*ax + B*B * vprim[1]*vprim[1]);
+}
+
+void Cyclide::compile(ImplicitProgram & program) const{
+  program.addCyclide(mWorld2Obj, A, B, C, D);
+}
@@ -20,6 +20,9 @@ public:
   Cyclide();
   virtual ~Cyclide();
   virtual float getValue(float x, float y, float z) const;
+  virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const;
+  virtual Vector3<float> getGradient(float x, float y, float z, float delta = 1e-3) const { return getDerivativesGradient(x, y, z, delta); }
+  virtual void compile(ImplicitProgram & program) const;
 protected:
   float A, B, C, D;
 };
@@ -1,8 +1,12 @@
 #include "FluidSimSetup.h"
 #include "Quadric.h"
 #include "OperatorReinitialize.h"
+#include "OperatorReinitializeFastMarching.h"
+#include "OperatorAdvect.h"
+#include "OperatorAdvectSemiLagrangian.h"
 
-FluidSimSetup::FluidSimSetup(float dx, float bandWidth) : mDx(dx), mBandWidth(bandWidth)
+FluidSimSetup::FluidSimSetup(float dx, float bandWidth)
+  : mDx(dx), mBandWidth(bandWidth), mUseFastMarching(true), mUseSemiLagrangian(false)
 {
 }
 
@@ -10,6 +14,38 @@ FluidSimSetup::~FluidSimSetup()
 {
 }
 
+void FluidSimSetup::reinitialize(LevelSet* ls)
+{
+  if (mUseFastMarching) {
+    OperatorReinitializeFastMarching opReInit(ls);
+    opReInit.propagate(4*ls->getDx());
+  }
+  else {
+    OperatorReinitialize opReInit(ls);
+    opReInit.propagate(4*ls->getDx());
+  }
+}
+
+void FluidSimSetup::advect(VolumeLevelSet* fluid, float dt)
+{
+  NavierStokesVectorField* advectionField = fluid->getAdvectionField();
+  if (mUseSemiLagrangian) {
+    OperatorAdvectSemiLagrangian opAdvect(fluid, advectionField);
+    opAdvect.propagate(dt);
+  }
+  else {
+    OperatorAdvect opAdvect(fluid, advectionField);
+    opAdvect.propagate(dt);
+  }
+  delete advectionField;
+
+  reinitialize(fluid);
+  fluid->setNarrowBandWidth(mBandWidth);
+
+  // Only the blocks the step changed are triangulated again
+  fluid->triangulateIncremental<SimpleMesh>(true);
+}
+
 LevelSet* FluidSimSetup::getSimpleSolid()
 {
 	Vector3<float> lowP(-1,0,-1);
@@ -35,13 +71,10 @@ LevelSet* FluidSimSetup::getSimpleSolid()
 	q->translate(0.0, 0.4, 0);
 	q->setBoundingBox(Bbox(lowP, highP));
 
-	LevelSet* ls = new LevelSet(dx, *q);
-  ls->setNarrowBandWidth(mBandWidth);
-  OperatorReinitialize opReInit(ls);
-  opReInit.propagate(4*ls->getDx());
+	LevelSet* ls = new LevelSet(dx, *q, mBandWidth);
+  reinitialize(ls);
 
-	ls->triangulate<SimpleMesh>(ls->getDx());
-	ls->getMesh<SimpleMesh>().calculateFaceNormals();
+	ls->triangulate<SimpleMesh>(ls->getDx(), 0, true);
 
   return ls;
 
@@ -58,11 +91,9 @@ VolumeLevelSet* FluidSimSetup::getSimpleFluid()
 	s->translate(0.0, 0.70, 0);
 	s->setBoundingBox(Bbox(lowP, highP));
 
-	VolumeLevelSet* ls = new VolumeLevelSet(dx, *s);
-  ls->setNarrowBandWidth(mBandWidth);
+	VolumeLevelSet* ls = new VolumeLevelSet(dx, *s, mBandWidth);
 
-	ls->triangulate<SimpleMesh>(ls->getDx());
-	ls->getMesh<SimpleMesh>().calculateFaceNormals();
+	ls->triangulate<SimpleMesh>(ls->getDx(), 0, true);
 
   return ls;
 }
@@ -86,14 +117,12 @@ LevelSet* FluidSimSetup::getFluidBoxSolid()
   Difference* box = new Difference(cube2,cube1);
 
   box->setBoundingBox(Bbox(lowP, highP));
-	LevelSet* ls = new LevelSet(dx, *box);
-  ls->setNarrowBandWidth(mBandWidth);
+  // The gradient of the cubes is at most one over their smallest scale
+	LevelSet* ls = new LevelSet(dx, *box, mBandWidth, 1/0.4f);
 
-  OperatorReinitialize opReInit(ls);
-  opReInit.propagate(4*ls->getDx());
+  reinitialize(ls);
 
-	ls->triangulate<SimpleMesh>(ls->getDx());
-	ls->getMesh<SimpleMesh>().calculateFaceNormals();
+	ls->triangulate<SimpleMesh>(ls->getDx(), 0, true);
 
 	return ls;
 }
@@ -116,14 +145,12 @@ VolumeLevelSet* FluidSimSetup::getFluidBoxFluid()
   Union* fluid = new Union(cube,cube2);
   fluid->setBoundingBox(Bbox(lowP, highP));
 
-	VolumeLevelSet* ls = new VolumeLevelSet(dx, *fluid);
-  ls->setNarrowBandWidth(mBandWidth);
+  // The gradient of the cubes is at most one over their smallest scale
+	VolumeLevelSet* ls = new VolumeLevelSet(dx, *fluid, mBandWidth, 1/0.1f);
 
-  OperatorReinitialize opReInit(ls);
-  opReInit.propagate(4*ls->getDx());
+  reinitialize(ls);
 
-	ls->triangulate<SimpleMesh>(ls->getDx());
-	ls->getMesh<SimpleMesh>().calculateFaceNormals();
+	ls->triangulate<SimpleMesh>(ls->getDx(), 0, true);
 
 	return ls;
 }
@@ -143,11 +170,9 @@ VolumeLevelSet* FluidSimSetup::getComplexFluid()
   s->translate(-0.2, 0.75, 0);
   s->setBoundingBox(Bbox(lowP, highP));
 
-  VolumeLevelSet* ls = new VolumeLevelSet(dx, *s);
-  ls->setNarrowBandWidth(mBandWidth);
+  VolumeLevelSet* ls = new VolumeLevelSet(dx, *s, mBandWidth);
 
-	ls->triangulate<SimpleMesh>(ls->getDx());
-	ls->getMesh<SimpleMesh>().calculateFaceNormals();
+	ls->triangulate<SimpleMesh>(ls->getDx(), 0, true);
 
   return ls;
   //return s;
@@ -212,11 +237,10 @@ LevelSet* FluidSimSetup::getComplexSolid()
   Union* u5 = new Union(diff2, diff3);
 	u5->setBoundingBox(Bbox(lowP, highP));
 
-  LevelSet* solidLs = new LevelSet(dx, *u5);
-  solidLs->setNarrowBandWidth(mBandWidth);
+  // The gradient of the flattened spheres is at most one over their smallest scale
+  LevelSet* solidLs = new LevelSet(dx, *u5, mBandWidth, 1/0.2f);
 
-	solidLs->triangulate<SimpleMesh>(dx);
-	solidLs->getMesh<SimpleMesh>().calculateFaceNormals();
+	solidLs->triangulate<SimpleMesh>(dx, 0, true);
 
   return solidLs;
 
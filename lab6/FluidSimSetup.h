@@ -22,13 +22,31 @@ class FluidSimSetup{
     LevelSet* getComplexSolid();
     VolumeLevelSet* getComplexFluid();
 
+    //! Selects fast marching, the default, or the reinitialization PDE for the setups
+    void setUseFastMarching(bool useFastMarching) { mUseFastMarching = useFastMarching; }
+
+    /*!
+     * Advects fluid one time step dt in its advection field, then reinitializes
+     * it, rebuilds its narrow band and triangulates it
+     */
+    void advect(VolumeLevelSet* fluid, float dt);
+
+    //! Selects the semi-Lagrangian scheme instead of the upwind OperatorAdvect in advect()
+    void setUseSemiLagrangian(bool useSemiLagrangian) { mUseSemiLagrangian = useSemiLagrangian; }
+    bool getUseSemiLagrangian() const { return mUseSemiLagrangian; }
+
 //    Implicit* getComplexSolid();
 //    Implicit* getComplexFluid();
 
 
 	private:
+		//! Reinitializes ls to a signed distance function with the selected operator
+		void reinitialize(LevelSet* ls);
+
 		float mDx;
 		float mBandWidth;
+		bool mUseFastMarching;
+		bool mUseSemiLagrangian;
 };
 
 #endif
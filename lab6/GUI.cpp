@@ -45,6 +45,8 @@ GUI::GUI()
 {
   mPlayback = false;
   mPlaybackIndex = 0;
+  mSimulationTimeCounter = 0;
+  mFluidSetup = FluidSimSetup(0.02, 6);
   mDrawWireframe = false;
   mDrawXZPlane = true;
   mCurrentFPS = 0.0;
@@ -91,8 +93,12 @@ GUI::GUI()
   mMenu.addMenuLine("(5)   Loop subdivision");
   mMenu.addMenuLine("(6)   Load Adaptive subdivision mesh (cube)");
   mMenu.addMenuLine("(7)   Adaptive Loop Subdivision");
-  mMenu.addMenuLine("(8)   ");
-  mMenu.addMenuLine("(9)   ");
+  mMenu.addMenuLine("(8)   Load fluid in a box");
+  mMenu.addMenuLine("(9)   Toggle semi-Lagrangian fluid advection");
+  mMenu.addMenuLine("(k/K) Fluid time step");
+  mMenu.addMenuLine("(l/L) Fluid frame (1/25 s)");
+  mMenu.addMenuLine("(-)   Next surface extractor of triangulate()");
+  mMenu.addMenuLine("(_)   Write the last implicit to implicit.obj");
 
 }
 
@@ -472,6 +478,8 @@ void GUI::keyboardFunc(unsigned char keycode, GLint mouseX, GLint mouseY)
     break;
   case 'b' : case 'B':
     {
+      // Throughput of the level set kernels, scalar against SIMD
+      LevelSetKernels::benchmark(std::cerr);
     }
     break;
 
@@ -609,33 +617,94 @@ void GUI::keyboardFunc(unsigned char keycode, GLint mouseX, GLint mouseY)
     break;
   case '8' :
     {
+      mSimulationTimeCounter = 0;
+
+      // Add fluid
+      VolumeLevelSet* fluid = mFluidSetup.getFluidBoxFluid();
+      addGeometry("Fluid LevelSet", fluid);
+
+      // Add solid
+      LevelSet* solid = mFluidSetup.getFluidBoxSolid();
+      addGeometry("Solid LevelSet", solid, 10);
     }
     break;
   case '9' :
     {
+      mFluidSetup.setUseSemiLagrangian(!mFluidSetup.getUseSemiLagrangian());
+      std::cerr << "Fluid advection: " << (mFluidSetup.getUseSemiLagrangian() ? "semi-Lagrangian" : "upwind") << std::endl;
     }
     break;
   case '-' :
     {
+      // Marching cubes, surface nets, dual contouring, and around again
+      static const char * names[] = { "marching cubes", "surface nets", "dual contouring" };
+      const int extractor = (Implicit::getExtractor() + 1) % 3;
+      Implicit::setExtractor((Implicit::Extractor)extractor);
+      std::cerr << "Surface extractor: " << names[extractor] << std::endl;
     }
     break;
   case '_' :
     {
+      // The implicit added last, written slab by slab without building its mesh
+      Implicit * implicit = NULL;
+      for (unsigned int i = mGeometryList.size(); i > 0 && implicit == NULL; i--)
+        implicit = dynamic_cast<Implicit *>(mGeometryList[i-1].geometry);
+      if (implicit == NULL) {
+        std::cerr << "Warning: no implicit in geometry list!" << std::endl;
+        break;
+      }
+
+      // Level sets are written at their grid spacing
+      LevelSet * levelSet = dynamic_cast<LevelSet *>(implicit);
+      const float delta = levelSet != NULL ? levelSet->getDx() : 0.01f;
+
+      std::ofstream outfile("implicit.obj");
+      if (implicit->streamTriangulation(outfile, delta))
+        std::cerr << "Wrote implicit.obj" << std::endl;
+      else
+        std::cerr << "Error: could not write implicit.obj" << std::endl;
     }
     break;
 
   case 'k' : case 'K' :
     {
+      VolumeLevelSet * fluid = getGeometry<VolumeLevelSet>("Fluid LevelSet");
+      if (fluid != NULL)
+        stepFluid(fluid);
     }
     break;
   case 'l' : case 'L' :
     {
+      VolumeLevelSet * fluid = getGeometry<VolumeLevelSet>("Fluid LevelSet");
+      float maxTime = 1.0f/25.0f;
+      float timeCounter = 0;
+      while (fluid != NULL && timeCounter < maxTime)
+        timeCounter += stepFluid(fluid);
     }
   }
   // Updating graphics
   glutPostRedisplay();
 }
 
+//-----------------------------------------------------------------------------
+float GUI::stepFluid(VolumeLevelSet * fluid)
+{
+  // Advect fluid level set one step
+  float dt = mNSSolver.getTimestep(); // Get latest dt max from the solver
+  mSimulationTimeCounter += dt;
+  mFluidSetup.advect(fluid, dt);
+
+  // Create list of geometry to pass to the solver
+  vector<Geometry*> geometryList;
+  for (unsigned int i = 0; i < mGeometryList.size(); i++)
+    geometryList.push_back(mGeometryList[i].geometry);
+
+  mNSSolver.solve(geometryList, dt);
+
+  std::cerr << "Fluid time: " << mSimulationTimeCounter << std::endl;
+  return dt;
+}
+
 //-----------------------------------------------------------------------------
 void GUI::specialFunc(GLint keycode, GLint mouseX, GLint mouseY)
 {
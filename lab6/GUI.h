@@ -146,6 +146,12 @@ private:
   // Navier Stokes Solver
   NavierStokesSolver mNSSolver;
 
+  // Fluid setups and level set advection of the fluid
+  FluidSimSetup mFluidSetup;
+
+  //! Advances fluid and the solver one time step, returns the time step
+  float stepFluid(VolumeLevelSet * fluid);
+
 
 	// Mesh array for playback of fluid simulation
 	float mSimulationTimeCounter;
@@ -17,7 +17,12 @@
 #include "GL/glut.h"
 #endif
 #include <limits>
+#include <cassert>
 #include <queue>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 const unsigned int HalfEdgeMesh::BORDER = std::numeric_limits<unsigned int>::max();
@@ -46,6 +51,141 @@ bool HalfEdgeMesh::addTriangle(const Vector3<float> &v1, const Vector3<float> &v
 	addVertex(v2, ind2);
 	addVertex(v3, ind3);
 
+	addFace(ind1, ind2, ind3);
+	return true;
+	}
+
+
+//-----------------------------------------------------------------------------
+void HalfEdgeMesh::buildFromIndexed(const std::vector<Vector3<float> > & verts, const std::vector<unsigned int> & indices)
+	{
+	assert(mVertSize == 0 && mFaceSize == 0);
+
+	// The vertices are unique already, only the edges need to be paired up
+	mVerts.resize(verts.size());
+	mVertPositions = verts;
+	mVertNormals.resize(verts.size());
+	mVertSize = verts.size();
+
+	const int numFaces = indices.size() / 3;
+	const int numHalfEdges = 3*numFaces;
+	std::vector<unsigned int> mates;
+	pairHalfEdges(indices, verts.size(), mates);
+
+	// Number the edges in the order addFace() would create them, a half-edge
+	// and its pair being consecutive. As there, each vertex points to the last
+	// half-edge created from it
+	std::vector<unsigned int> edges(numHalfEdges);
+	mEdgeSize = 0;
+	for (int h = 0; h < numHalfEdges; h++)
+		{
+		if (mates[h] != UNINITIALIZED && mates[h] < (unsigned int)h)
+			{
+			edges[h] = edges[mates[h]] + 1;
+			continue;
+			}
+		edges[h] = mEdgeSize;
+		mVerts[indices[h]].edge = mEdgeSize;
+		mVerts[indices[h % 3 == 2 ? h - 2 : h + 1]].edge = mEdgeSize + 1;
+		mEdgeSize += 2;
+		}
+
+	mEdges.resize(mEdgeSize);
+	mFaces.resize(numFaces);
+	mFaceNormals.resize(numFaces);
+	mFaceAreas.resize(numFaces);
+	mFaceSize = numFaces;
+
+#pragma omp parallel for schedule(static)
+	for (int n = 0; n < numFaces; n++)
+		{
+		mFaces[n].edge = edges[3*n];
+		for (int c = 0; c < 3; c++)
+			{
+			const int h = 3*n + c;
+			HalfEdge & edge = mEdges[edges[h]];
+			edge.vert = indices[h];
+			edge.face = n;
+			edge.next = edges[3*n + (c+1)%3];
+
+			// A border half-edge, without a face, runs the other way
+			if (mates[h] == UNINITIALIZED)
+				mEdges[pair(edges[h])].vert = indices[3*n + (c+1)%3];
+			}
+		}
+	}
+
+
+//-----------------------------------------------------------------------------
+void HalfEdgeMesh::pairHalfEdges(const std::vector<unsigned int> & indices, unsigned int numVerts, std::vector<unsigned int> & mates)
+	{
+	const int numHalfEdges = indices.size() / 3 * 3;
+
+	// The key of a half-edge is its smaller vertex followed by its larger one,
+	// in just enough bits to hold the vertex indices
+	int bits = 1;
+	while (bits < 32 && (numVerts - 1) >> bits) bits++;
+
+	std::vector<unsigned long long> keys(numHalfEdges), sortedKeys(numHalfEdges);
+	std::vector<unsigned int> ids(numHalfEdges), sortedIds(numHalfEdges);
+#pragma omp parallel for schedule(static)
+	for (int h = 0; h < numHalfEdges; h++)
+		{
+		const unsigned int v1 = indices[h], v2 = indices[h % 3 == 2 ? h - 2 : h + 1];
+		keys[h] = ((unsigned long long)std::min(v1, v2) << bits) | std::max(v1, v2);
+		ids[h] = h;
+		}
+
+	// Least significant digit first radix sort. Each pass is stable, so the
+	// half-edges of an edge end up next to each other in increasing order
+	const unsigned int mask = (1 << RADIX_BITS) - 1;
+	std::vector<unsigned int> start(1 << RADIX_BITS);
+	for (int shift = 0; shift < 2*bits; shift += RADIX_BITS)
+		{
+		std::fill(start.begin(), start.end(), 0);
+		for (int h = 0; h < numHalfEdges; h++)
+			start[(keys[h] >> shift) & mask]++;
+
+		unsigned int sum = 0;
+		for (unsigned int d = 0; d < start.size(); d++)
+			{
+			const unsigned int count = start[d];
+			start[d] = sum;
+			sum += count;
+			}
+
+		for (int h = 0; h < numHalfEdges; h++)
+			{
+			const unsigned int n = start[(keys[h] >> shift) & mask]++;
+			sortedKeys[n] = keys[h];
+			sortedIds[n] = ids[h];
+			}
+		keys.swap(sortedKeys);
+		ids.swap(sortedIds);
+		}
+
+	// Pair the half-edges of edges used twice, in opposite directions
+	mates.assign(numHalfEdges, UNINITIALIZED);
+#pragma omp parallel for schedule(static)
+	for (int n = 0; n < numHalfEdges; n++)
+		{
+		if (n > 0 && keys[n] == keys[n-1])
+			continue;
+		int end = n + 1;
+		while (end < numHalfEdges && keys[end] == keys[n])
+			end++;
+		if (end - n == 2 && indices[ids[n]] != indices[ids[n+1]])
+			{
+			mates[ids[n]] = ids[n+1];
+			mates[ids[n+1]] = ids[n];
+			}
+		}
+	}
+
+
+//-----------------------------------------------------------------------------
+void HalfEdgeMesh::addFace(unsigned int ind1, unsigned int ind2, unsigned int ind3)
+	{
 	// Add all half-edge pairs
 	unsigned int edgeind1, edgeind2, edgeind3;
 	unsigned int edgeind1pair, edgeind2pair, edgeind3pair;
@@ -56,19 +196,16 @@ bool HalfEdgeMesh::addTriangle(const Vector3<float> &v1, const Vector3<float> &v
 
 	// Connect inner ring
 	mEdges[edgeind1].next = edgeind2;
-	mEdges[edgeind1 ].prev = edgeind3;
-
 	mEdges[ edgeind2 ].next = edgeind3;
-	mEdges[ edgeind2 ].prev = edgeind1;
-
 	mEdges[edgeind3 ].next = edgeind1;
-	mEdges[ edgeind3 ].prev = edgeind2;
 
 
 	// Finally, create the face
 	Face f;
 	f.edge = edgeind1;
 	mFaces.push_back( f );
+	mFaceNormals.push_back( Vector3<float>(0,0,0) );
+	mFaceAreas.push_back( 0 );
 
 	// All half-edges share the same left face (previously added)
 	int index = mFaceSize++;
@@ -76,8 +213,6 @@ bool HalfEdgeMesh::addTriangle(const Vector3<float> &v1, const Vector3<float> &v
 	mEdges[ edgeind1 ].face = index;
 	mEdges[ edgeind2 ].face = index;
 	mEdges[ edgeind3 ].face = index;
-
-	return true;
 	}
 
 
@@ -97,9 +232,9 @@ bool HalfEdgeMesh::addVertex(const Vector3<float> & v, unsigned int &indx)
 	mUniqueVerts[v] = indx = mVertSize; // op. [ ] constructs a new entry in map
 	mVertSize++;
 
-	Vertex vert;
-	vert.vec = v;
-	mVerts.push_back(vert);
+	mVerts.push_back(Vertex());
+	mVertPositions.push_back(v);
+	mVertNormals.push_back(Vector3<float>(0,0,0));
 
 	return true;
 	}
@@ -121,7 +256,7 @@ bool HalfEdgeMesh::addHalfEdgePair(unsigned int v1, unsigned int v2, unsigned in
 	//	iter++;
 	//	}
 
-	std::pair<unsigned int, unsigned int> key = std::make_pair( std::min(v1,v2), std::max(v1,v2) );
+	const unsigned long long key = edgeKey( v1, v2 );
 	EdgeHashTable::iterator it = mUniqueEdges.find( key );
 
 	//does not exist yet
@@ -131,10 +266,8 @@ bool HalfEdgeMesh::addHalfEdgePair(unsigned int v1, unsigned int v2, unsigned in
 		indx1 = mEdgeSize++;
 		indx2 = mEdgeSize++;
 
-		// Create edges and set pair index
+		// Create edges, each the pair of the other
 		HalfEdge edge1, edge2;
-		edge1.pair = indx2;
-		edge2.pair = indx1;
 
 		// Connect the edges to the verts
 		edge1.vert = v1;
@@ -155,8 +288,8 @@ bool HalfEdgeMesh::addHalfEdgePair(unsigned int v1, unsigned int v2, unsigned in
 	//edge already created
 	else
 		{
-		indx1 = (v1<v2)? it->second : mEdges[ it->second].pair;
-		indx2 = (v1<v2)? mEdges[ it->second ].pair : it->second;
+		indx1 = (v1<v2)? it->second : pair(it->second);
+		indx2 = (v1<v2)? pair(it->second) : it->second;
 		return false;
 		}
 	}
@@ -175,8 +308,6 @@ void HalfEdgeMesh::validate()
 	while (iterEdge != iterEdgeEnd) {
 		if ((*iterEdge).face == UNINITIALIZED ||
 			(*iterEdge).next == UNINITIALIZED ||
-			(*iterEdge).pair == UNINITIALIZED ||
-			(*iterEdge).prev == UNINITIALIZED ||
 			(*iterEdge).vert == UNINITIALIZED)
 			std::cerr << "HalfEdge " << iterEdge - mEdges.begin() << " not properly initialized" << std::endl;
 
@@ -229,60 +360,47 @@ bool HalfEdgeMesh::findNeighbourTriangles(const unsigned int vertexIndex, std::v
 	unsigned int edge = mVerts.at( vertexIndex ).edge;
 
 	//go to the previous so we can always proceed in the same way in the loop
-	int pair = mEdges[edge].prev;
-	edge = pair;
+	unsigned int incoming = prev(edge);
+	edge = incoming;
 
-	int next(0);
+	unsigned int next(0);
 
 	//find the neighbours
 	do
 		{
-		foundTriangles.push_back( mEdges.at( pair ).face );
+		foundTriangles.push_back( mEdges.at( incoming ).face );
 
-		next = mEdges[pair].next;
-		pair = mEdges[next].pair;
+		next = mEdges[incoming].next;
+		incoming = pair(next);
 
-		} while( pair != edge );
+		} while( incoming != edge );
 
 
 		return !(foundTriangles.size() == 0);			
 	}
 
-float HalfEdgeMesh::area()
+float HalfEdgeMesh::area() const
 	{
-	float totalArea(0);
-	unsigned int numTriangles = mFaceSize;
-	for (unsigned int i = 0; i < numTriangles; i++)
-		{
-		totalArea += calculateFaceNormal( i ).length() / 2.0f;
-		}		
-	return totalArea;
+	const int numTriangles = mFaceSize;
+	double totalArea = 0;
+#pragma omp parallel for schedule(static) reduction(+:totalArea)
+	for (int i = 0; i < numTriangles; i++)
+		totalArea += faceCross(i).length();
+	return totalArea / 2.0;
 	}
 
-float HalfEdgeMesh::volume()
+float HalfEdgeMesh::volume() const
 	{
-	float totalVolume(0);
-
-	unsigned int numTriangles = mFaceSize;
-	for (unsigned int i = 0; i < numTriangles; i++)
-		{
-		Vector3<float> normal = calculateFaceNormal( i );
-		float length = normal.length();
-		normal.normalize();
-		int edgeIndex1 = mFaces.at(i).edge;
-		int edgeIndex2 = mEdges.at( edgeIndex1 ).next;
-		int edgeIndex3 = mEdges.at( edgeIndex2 ).next;
-
-		Vertex v1 = mVerts.at( mEdges.at( edgeIndex1 ).vert );
-		Vertex v2 = mVerts.at( mEdges.at( edgeIndex2 ).vert );
-		Vertex v3 = mVerts.at( mEdges.at( edgeIndex3 ).vert );
-
-		float area = length / 2.0f;
-		totalVolume += (( v1.vec + v2.vec + v3.vec ) / 3.0f)*normal * area;
-		}
-
-	return totalVolume/3.0f;
+	// By the divergence theorem, the sum of the signed volumes of the
+	// tetrahedra between the origin and each face
+	const int numTriangles = mFaceSize;
+	double totalVolume = 0;
+#pragma omp parallel for schedule(static) reduction(+:totalVolume)
+	for (int i = 0; i < numTriangles; i++)
+		totalVolume += mVertPositions[mEdges[mFaces[i].edge].vert]*faceCross(i);
+	return totalVolume / 6.0;
 	}
+
 int HalfEdgeMesh::genus() const
 	{
 	printf("Genus calculation not implemented for half-edge mesh!\n");
@@ -305,67 +423,85 @@ float HalfEdgeMesh::curvature(const unsigned int vertexIndex, const Vector3<floa
 
 void HalfEdgeMesh::calculateFaceNormals()
 	{
-	unsigned int numTriangles = mFaceSize;
-	for (unsigned int i = 0; i < numTriangles; i++){
-
-		HalfEdge* edge = &mEdges[mFaces[i].edge];
-
-		Vector3<float>& p0 = mVerts[edge->vert].vec;
-		edge = &mEdges[edge->next];
-
-		Vector3<float>& p1 = mVerts[edge->vert].vec;
-		edge = &mEdges[edge->next];
-
-		Vector3<float>& p2 = mVerts[edge->vert].vec;
+	const int numTriangles = mFaceSize;
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < numTriangles; i++)
+		{
+		const Vector3<float> n = faceCross(i);
+		const float length = n.length();
+		// Degenerate faces get a zero normal, so they add nothing to the vertices
+		mFaceNormals[i] = length > 0 ? n / length : Vector3<float>(0,0,0);
+		mFaceAreas[i] = length / 2.0f;
+		}
+	}
 
-		// Calculate face normal
-		Vector3<float> v1 = p1-p0;
-		Vector3<float> v2 = p2-p0;
-		Vector3<float> n = cross(v1,v2);
-		n.normalize();
-		mFaces[i].normal = n; // assign normal to face
-		}	
+void HalfEdgeMesh::setVertexNormals(const std::vector<Vector3<float> > & normals)
+	{
+	assert((int)normals.size() == mVertSize);
+	mVertNormals = normals;
 	}
 
 void HalfEdgeMesh::calculateVertexNormals()
 	{
-	std::vector<unsigned int> foundTriangles;
+	calculateFaceNormals();
 
-	for (int i=0, endI=mVertSize; i<endI; i++)
-		{
-		findNeighbourTriangles(i, foundTriangles );
+	// Each face adds its normal, weighted by its area, to its three vertices.
+	// The vertices are shared between faces, so the faces are split into one
+	// chunk per thread, each summing into its own normals, and the sums of the
+	// chunks are added up per vertex afterwards
+	const int numVerts = mVertSize;
+	const int numTriangles = mFaceSize;
+#ifdef _OPENMP
+	const int numChunks = std::max(std::min(omp_get_max_threads(), numTriangles), 1);
+#else
+	const int numChunks = 1;
+#endif
+	const int chunkSize = (numTriangles + numChunks - 1) / numChunks;
+	std::vector<std::vector<Vector3<float> > > chunkNormals(numChunks);
 
-		Vector3<float> normal;
-		int endJ=foundTriangles.size();
-		for (int j=0; j<endJ; j++)
+#pragma omp parallel for schedule(static, 1) num_threads(numChunks)
+	for (int c = 0; c < numChunks; c++)
+		{
+		std::vector<Vector3<float> > & normals = chunkNormals[c];
+		normals.assign(numVerts, Vector3<float>(0,0,0));
+		for (int i = c*chunkSize, end = std::min(i + chunkSize, numTriangles); i < end; i++)
 			{
-			normal += calculateFaceNormal( foundTriangles[j] ).normalize();
+			const Vector3<float> n = mFaceNormals[i]*mFaceAreas[i];
+			unsigned int edge = mFaces[i].edge;
+			for (int k = 0; k < 3; k++, edge = mEdges[edge].next)
+				normals[mEdges[edge].vert] += n;
 			}
-		normal = normal/endJ;
+		}
 
-		//mNormals.push_back( normal );
-		mVerts[i].normal = normal;
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < numVerts; i++)
+		{
+		Vector3<float> normal = chunkNormals[0][i];
+		for (int c = 1; c < numChunks; c++)
+			normal += chunkNormals[c][i];
+		if (normal.length() > 0)
+			normal.normalize();
+		mVertNormals[i] = normal;
 		}
 	}
 
 
 Vector3<float> HalfEdgeMesh::calculateFaceNormal( unsigned int aTriangle )
 	{
-	HalfEdge* edge = &mEdges[mFaces[aTriangle].edge];
-
-	Vector3<float>& p0 = mVerts[edge->vert].vec;
-	edge = &mEdges[edge->next];
-
-	Vector3<float>& p1 = mVerts[edge->vert].vec;
-	edge = &mEdges[edge->next];
+	return faceCross(aTriangle).normalize();
+	}
 
-	Vector3<float>& p2 = mVerts[edge->vert].vec;
 
-	// Calculate face normal
-	Vector3<float> v1 = p1-p0;
-	Vector3<float> v2 = p2-p0;
-	Vector3<float> n = cross(v1,v2);
-	return n.normalize();
+Vector3<float> HalfEdgeMesh::faceCross(unsigned int face) const
+	{
+	const HalfEdge & e0 = mEdges[mFaces[face].edge];
+	const HalfEdge & e1 = mEdges[e0.next];
+	const HalfEdge & e2 = mEdges[e1.next];
+
+	const Vector3<float> & p0 = mVertPositions[e0.vert];
+	const Vector3<float> & p1 = mVertPositions[e1.vert];
+	const Vector3<float> & p2 = mVertPositions[e2.vert];
+	return cross(p1 - p0, p2 - p0);
 	}
 
 //-----------------------------------------------------------------------------
@@ -392,16 +528,16 @@ void HalfEdgeMesh::draw()
 
 		HalfEdge* edge = &mEdges[mFaces[i].edge];
 
-		Vector3<float>& p0 = mVerts[edge->vert].vec;
+		Vector3<float>& p0 = mVertPositions[edge->vert];
 		edge = &mEdges[edge->next];
 
-		Vector3<float>& p1 = mVerts[edge->vert].vec;
+		Vector3<float>& p1 = mVertPositions[edge->vert];
 		edge = &mEdges[edge->next];
 
-		Vector3<float>& p2 = mVerts[edge->vert].vec;
+		Vector3<float>& p2 = mVertPositions[edge->vert];
 
 		if (getShadingFlag() == FLAT_SHADING){
-			Vector3<float>& n = mFaces[i].normal;
+			Vector3<float>& n = mFaceNormals[i];
 			Vector3<float> color = colorMap.map(n, -1, 1);
 
 			glColor3f(color[0],color[1], color[2]); 			
@@ -423,9 +559,9 @@ void HalfEdgeMesh::draw()
 			unsigned int v3 = edge->vert;
 
 			// Fetching normals - the normal index is the same as the vertex index
-			Vector3<float>& n0 = mVerts[v1].normal;
-			Vector3<float>& n1 = mVerts[v2].normal;
-			Vector3<float>& n2 = mVerts[v3].normal;
+			Vector3<float>& n0 = mVertNormals[v1];
+			Vector3<float>& n1 = mVertNormals[v2];
+			Vector3<float>& n2 = mVertNormals[v3];
 
 			// Color mapping, maps the normal components to R,G,B. From [-1, 1] to [0,1] respectively
 			Vector3<float> color0 = colorMap.map(n0, -1, 1);
@@ -23,21 +23,34 @@ public:
 
 	//! Adds a triangle to the mesh. \sa addTriangle
 	virtual bool addTriangle(const Vector3<float> &v1, const Vector3<float> &v2, const Vector3<float> & v3);
+	/*!
+	 * Builds the mesh from indexed triangles, see Mesh::buildFromIndexed().
+	 * The half-edges are paired by sorting them on their vertices instead of
+	 * through mUniqueEdges, and numbered as addTriangle() would number them.
+	 * An edge used by other than two triangles in opposite directions gets a
+	 * border half-edge of its own for each of them.
+	 */
+	virtual void buildFromIndexed(const std::vector<Vector3<float> > & verts, const std::vector<unsigned int> & indices);
 
 
-	virtual float area();
+	virtual float area() const;
 
-	virtual float volume();
+	virtual float volume() const;
 
 	virtual int genus() const;
 	virtual int shells() const;
 
 	virtual float curvature(const unsigned int vertexIndex, const Vector3<float>& n);
 
+	//! Calculates the normal and area of every face, in parallel
 	virtual void calculateFaceNormals();
 
+	//! Calculates the normals of the vertices, from the face normals weighted by area
 	virtual void calculateVertexNormals();
 
+	//! Sets the normals of the vertices. \sa Mesh::setVertexNormals
+	virtual void setVertexNormals(const std::vector<Vector3<float> > & normals);
+
 	Vector3<float> calculateFaceNormal( unsigned int aTriangle );
 
 	virtual void draw();
@@ -51,28 +64,37 @@ protected:
 	//! Denotes a reference to a non-existing object
 	const static unsigned int UNINITIALIZED;
 
+	/*!
+	 * The half-edges are created in pairs, so the pair of a half-edge is found
+	 * at the neighbouring index, see pair(), and the faces are triangles, so the
+	 * previous half-edge is the next of the next, see prev()
+	 */
 	struct HalfEdge {
-		HalfEdge() : vert(UNINITIALIZED), face(UNINITIALIZED), next(UNINITIALIZED), prev(UNINITIALIZED), pair(UNINITIALIZED) { }
+		HalfEdge() : vert(UNINITIALIZED), face(UNINITIALIZED), next(UNINITIALIZED) { }
 		unsigned int vert;  // index into mVerts
 		unsigned int face;   // index into mFaces
 		unsigned int next;  // index into mEdges
-		unsigned int prev;  // index into mEdges
-		unsigned int pair;  // index into mEdges
 		};
 
 	struct Vertex {
 		Vertex() : edge(UNINITIALIZED) { }
-		Vector3<float> vec;  // the vertex coordinates
 		unsigned int edge; // index into mEdges
-		Vector3<float> normal;
 		};
 
 	struct Face {
 		Face() : edge(UNINITIALIZED) { }
 		unsigned int edge; // index into mEdges
-		Vector3<float> normal; // the face normal
 		};
 
+	//! Returns the half-edge running the other way along the same edge
+	static unsigned int pair(unsigned int edge) { return edge ^ 1; }
+
+	//! Returns the half-edge before edge around its face
+	unsigned int prev(unsigned int edge) const {
+		const unsigned int next = mEdges[edge].next;
+		return next == UNINITIALIZED ? UNINITIALIZED : mEdges[next].next;
+		}
+
 	int mEdgeSize;
 	std::vector<HalfEdge> mEdges;
 	int mVertSize;
@@ -80,9 +102,15 @@ protected:
 	int mFaceSize;
 	std::vector<Face> mFaces;
 
-
-	//std::vector<Vector3<float> > mNormals;
+	//! \name Attributes, each in an array of its own indexed as mVerts or mFaces
+	//@{
+	std::vector<Vector3<float> > mVertPositions;
+	std::vector<Vector3<float> > mVertNormals;
 	std::vector<float> mCurvature;
+	std::vector<Vector3<float> > mFaceNormals;
+	//! The areas of the faces, from calculateFaceNormals()
+	std::vector<float> mFaceAreas;
+	//@}
 
 	//  std::map<Vector3<float>, unsigned int> mUniqueVerts;
 	VertexHashTable mUniqueVerts;
@@ -93,6 +121,25 @@ protected:
 
 	bool addHalfEdgePair(unsigned int v1, unsigned int v2, unsigned int &indx1, unsigned int &indx2);
 
+	//! Adds the face between the vertices with the given indices
+	void addFace(unsigned int ind1, unsigned int ind2, unsigned int ind3);
+
+	//! Number of key bits sorted per pass in pairHalfEdges()
+	static const int RADIX_BITS = 11;
+
+	/*!
+	 * Finds the pair of each half-edge of the triangles of indices, where
+	 * half-edge 3*n+c goes from corner c of triangle n to the next corner.
+	 * mates gets the half-edge running the other way along the same edge, or
+	 * UNINITIALIZED if there is none or the edge is not used by exactly two
+	 * half-edges. The half-edges are radix sorted on their vertex indices, below
+	 * numVerts, so the time is linear in the number of triangles.
+	 */
+	static void pairHalfEdges(const std::vector<unsigned int> & indices, unsigned int numVerts, std::vector<unsigned int> & mates);
+
+	//! Returns the unnormalized normal of a face, twice its area long
+	Vector3<float> faceCross(unsigned int face) const;
+
 	void mergeBoundaryEdge(unsigned int indx);
 
 
@@ -10,6 +10,11 @@
 *
 *************************************************************************************************/
 #include "Implicit.h"
+#include "ImplicitProgram.h"
+#include "ObjIO.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
 #ifdef __APPLE__
 #include "GLUT/glut.h"
@@ -17,6 +22,8 @@
 #include "GL/glut.h"
 #endif
 
+Implicit::Extractor Implicit::mExtractor = Implicit::MARCHING_CUBES;
+
 Implicit::Implicit() : mMesh(NULL) {}
 
 Implicit::~Implicit()
@@ -48,27 +55,53 @@ Vector3<float> Implicit::getGradient(float x, float y, float z, float delta) con
 	}
 
 
+Vector3<float> Implicit::getDerivativesGradient(float x, float y, float z, float delta) const
+	{
+	Vector3<float> gradient;
+	float curvature;
+	getValueAndDerivatives(x, y, z, gradient, curvature, delta);
+	return gradient;
+	}
+
+
 /*!
 * Evaluation of world coordinates are done through transformation
 * of the world-coordinates by mWorld2Obj and then evaluation.
 */
 float Implicit::getCurvature(float x, float y, float z, float delta) const
 	{
-	double deltaX0 = getValue(x+delta, y, z );
-	double deltaX1 = getValue(x-delta, y, z );
-	double deltaY0 = getValue(x, y+delta, z );
-	double deltaY1 = getValue(x, y-delta, z );
-	double deltaZ0 = getValue(x, y, z+delta );
-	double deltaZ1 = getValue(x, y, z-delta );
-	double point   = getValue(x, y, z );
-	double deltaInvSq = 1.0f/(delta*delta);
+	Vector3<float> gradient;
+	float curvature;
+	getValueAndDerivatives(x, y, z, gradient, curvature, delta);
+	return curvature;
+	}
+
+
+/*!
+* The gradient and the curvature share the six samples around the point.
+*/
+float Implicit::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const
+	{
+	float deltaX0 = getValue(x+delta, y, z );
+	float deltaX1 = getValue(x-delta, y, z );
+	float deltaY0 = getValue(x, y+delta, z );
+	float deltaY1 = getValue(x, y-delta, z );
+	float deltaZ0 = getValue(x, y, z+delta );
+	float deltaZ1 = getValue(x, y, z-delta );
+	float point   = getValue(x, y, z );
+
+	float dX = (deltaX0 - deltaX1 ) / (2.0f * delta) ;
+	float dY = (deltaY0 - deltaY1 ) / (2.0f * delta) ;
+	float dZ = (deltaZ0 - deltaZ1 ) / (2.0f * delta) ;
+	gradient = Vector3<float>(dX, dY, dZ);
 
-	float dX = ( deltaX0 - 2.0f*point + deltaX1 ) * deltaInvSq;
-	float dY = ( deltaY0 - 2.0f*point + deltaY1 ) * deltaInvSq;
-	float dZ = ( deltaZ0 - 2.0f*point + deltaZ1 ) * deltaInvSq;
+	double deltaInvSq = 1.0f/(delta*delta);
+	float dXX = ( (double)deltaX0 - 2.0f*point + deltaX1 ) * deltaInvSq;
+	float dYY = ( (double)deltaY0 - 2.0f*point + deltaY1 ) * deltaInvSq;
+	float dZZ = ( (double)deltaZ0 - 2.0f*point + deltaZ1 ) * deltaInvSq;
+	curvature = dXX + dYY + dZZ;
 
-	//printf("[%f](%f)\n", dX + dY + dZ, delta);
-	return (dX + dY + dZ);
+	return point;
 	}
 
 /*!
@@ -194,6 +227,231 @@ void Implicit::draw(){
 	}
 
 
+void Implicit::compile(ImplicitProgram & program) const
+	{
+	program.addCall(this);
+	}
+
+
+void Implicit::getCellCorners(float delta, std::vector<float> & xs, std::vector<float> & ys, std::vector<float> & zs) const
+	{
+	// Get axis aligned bounding box (in world space)
+	Bbox b = getBoundingBox();
+	Vector3<float> & pmin = b.pMin;
+	Vector3<float> & pmax = b.pMax;
+
+	// Accumulated the same way as the cells are stepped so a corner shared by
+	// neighbouring cells has a single position
+	xs.clear();  ys.clear();  zs.clear();
+	for(float i = pmin.x(); i < pmax.x()-0.5*delta; i += delta ) xs.push_back(i);
+	for(float j = pmin.y(); j < pmax.y()-0.5*delta; j += delta ) ys.push_back(j);
+	for(float k = pmin.z(); k < pmax.z()-0.5*delta; k += delta ) zs.push_back(k);
+	xs.push_back(xs.empty() ? pmin.x() : xs.back() + delta);
+	ys.push_back(ys.empty() ? pmin.y() : ys.back() + delta);
+	zs.push_back(zs.empty() ? pmin.z() : zs.back() + delta);
+	}
+
+
+bool Implicit::streamTriangulation(std::ostream & os, float delta, float maxGradient) const
+	{
+	std::vector<float> xs, ys, zs;
+	getCellCorners(delta, xs, ys, zs);
+	const unsigned int cellsX = xs.size()-1;
+	const ImplicitProgram program(*this);
+
+	std::vector<unsigned char> blocks;
+	if (maxGradient > 0)
+		findSurfaceBlocks(program, xs, ys, zs, delta, maxGradient, blocks);
+
+	// The slabs are extracted one after the other, in the order they are
+	// written, while the values of the next slabs are evaluated in parallel,
+	// one plane per thread. Slab i of a batch is between planes i and i+1
+	const int numThreads = MarchingCubes::getNumThreads();
+	std::vector<SlabSampler *> samplers(numThreads);
+	for (int t = 0; t < numThreads; t++)
+		samplers[t] = new SlabSampler(program, xs, ys, zs, blocks);
+	std::vector<std::vector<float> > planes(numThreads+1, std::vector<float>(samplers[0]->getSlabSize()));
+	samplers[0]->sample(0, &planes[0][0]);
+
+	IndexedMesh mesh;
+	MarchingCubes marchingCubes(xs, ys, zs, delta, mesh);
+	ObjIO objIO;
+	bool success = true;
+	os << "# " << cellsX << "x" << ys.size()-1 << "x" << zs.size()-1 << " cells of size " << delta << "\n";
+
+	std::cerr << "Triangulating to stream [";
+	unsigned int reportedSlabs = 0;
+	for (unsigned int first = 0; first < cellsX && success; first += numThreads)
+		{
+		const int count = std::min((unsigned int)numThreads, cellsX - first);
+#pragma omp parallel for schedule(static, 1) num_threads(count)
+		for (int n = 1; n <= count; n++)
+			samplers[n-1]->sample(first + n, &planes[n][0]);
+
+		for (int n = 0; n < count; n++)
+			{
+			const unsigned int i = first + n;
+			marchingCubes.addSlab(i, &planes[n][0], &planes[n+1][0], samplers[0]->getCells(i));
+			success = objIO.saveIndexed(mesh, os) && success;
+
+			for (; reportedSlabs < (i+1)*30/cellsX; reportedSlabs++)
+				std::cerr << "=";
+			}
+		planes[0].swap(planes[count]);
+		}
+
+	for (int t = 0; t < numThreads; t++)
+		delete samplers[t];
+	std::cerr << "]" << std::endl << "done: " << mesh.mFirstVert << " vertices" << std::endl;
+	return success;
+	}
+
+
+Implicit::SlabSampler::SlabSampler(const ImplicitProgram & program, const std::vector<float> & xs, const std::vector<float> & ys,
+                                   const std::vector<float> & zs, const std::vector<unsigned char> & blocks)
+	: mProgram(program), mXs(xs), mBlocks(blocks), mCellsX(xs.size()-1), mCellsY(ys.size()-1), mCellsZ(zs.size()-1)
+	, mStack(program.getStackSize())
+	{
+	const unsigned int slabSize = ys.size()*zs.size();
+	mSlabX.resize(slabSize);
+	mSlabY.resize(slabSize);
+	mSlabZ.resize(slabSize);
+	for (unsigned int j = 0; j <= mCellsY; j++)
+		for (unsigned int k = 0; k <= mCellsZ; k++)
+			{
+			mSlabY[j*(mCellsZ+1) + k] = ys[j];
+			mSlabZ[j*(mCellsZ+1) + k] = zs[k];
+			}
+
+	if (!mBlocks.empty())
+		{
+		mGatherY.resize(slabSize);  mGatherZ.resize(slabSize);  mGathered.resize(slabSize);
+		mGatherIndex.resize(slabSize);
+		mCells.resize(mCellsY*mCellsZ);  mPoints.resize(slabSize);
+		}
+	}
+
+
+void Implicit::SlabSampler::sample(unsigned int p, float * slab)
+	{
+	const unsigned int slabSize = mSlabX.size();
+	std::fill(mSlabX.begin(), mSlabX.end(), mXs[p]);
+	if (mBlocks.empty())
+		{
+		mProgram.getValues(&mSlabX[0], &mSlabY[0], &mSlabZ[0], slab, slabSize, &mStack[0]);
+		return;
+		}
+
+	getSurfaceCorners(mBlocks, p, mCellsX, mCellsY, mCellsZ, &mPoints[0]);
+	unsigned int count = 0;
+	for (unsigned int n = 0; n < slabSize; n++)
+		{
+		if (!mPoints[n]) continue;
+		mGatherY[count] = mSlabY[n];
+		mGatherZ[count] = mSlabZ[n];
+		mGatherIndex[count++] = n;
+		}
+	if (count > 0)
+		mProgram.getValues(&mSlabX[0], &mGatherY[0], &mGatherZ[0], &mGathered[0], count, &mStack[0]);
+	for (unsigned int n = 0; n < count; n++)
+		slab[mGatherIndex[n]] = mGathered[n];
+	}
+
+
+const unsigned char * Implicit::SlabSampler::getCells(unsigned int i)
+	{
+	if (mBlocks.empty()) return NULL;
+	getSurfaceCells(mBlocks, i, mCellsY, mCellsZ, &mCells[0]);
+	return &mCells[0];
+	}
+
+
+void Implicit::findSurfaceBlocks(const ImplicitProgram & program, const std::vector<float> & xs, const std::vector<float> & ys,
+                                 const std::vector<float> & zs, float delta, float maxGradient, std::vector<unsigned char> & blocks)
+	{
+	const unsigned int B = SKIP_BLOCK_DIM;
+	const unsigned int cellsX = xs.size()-1, cellsY = ys.size()-1, cellsZ = zs.size()-1;
+	const unsigned int blocksX = (cellsX + B-1)/B, blocksY = (cellsY + B-1)/B, blocksZ = (cellsZ + B-1)/B;
+
+	// The corners of the blocks, the last corner along an axis is that of the
+	// last cell as the last block may be smaller
+	const unsigned int cornersX = blocksX+1, cornersY = blocksY+1, cornersZ = blocksZ+1;
+	const int numCorners = cornersX*cornersY*cornersZ;
+	std::vector<float> x(numCorners), y(numCorners), z(numCorners), corners(numCorners);
+	for (int c = 0; c < numCorners; c++)
+		{
+		x[c] = xs[std::min(c / (cornersY*cornersZ) * B, cellsX)];
+		y[c] = ys[std::min(c / cornersZ % cornersY * B, cellsY)];
+		z[c] = zs[std::min(c % cornersZ * B, cellsZ)];
+		}
+	const int batch = ImplicitProgram::BATCH_SIZE;
+#pragma omp parallel
+		{
+		std::vector<float> stack(program.getStackSize());
+#pragma omp for schedule(dynamic)
+		for (int c = 0; c < numCorners; c += batch)
+			program.getValues(&x[c], &y[c], &z[c], &corners[c], std::min(batch, numCorners - c), &stack[0]);
+		}
+
+	// Every point of a block is within half the block diagonal of a corner, so
+	// the value cannot change sign in the block if all corners are further from zero
+	const float margin = maxGradient * 0.5f * std::sqrt(3.0f) * B * delta;
+	blocks.resize(blocksX*blocksY*blocksZ);
+	for (unsigned int bi = 0; bi < blocksX; bi++)
+		for (unsigned int bj = 0; bj < blocksY; bj++)
+			for (unsigned int bk = 0; bk < blocksZ; bk++)
+				{
+				float minVal = std::numeric_limits<float>::max();
+				float maxVal = -std::numeric_limits<float>::max();
+				for (unsigned int n = 0; n < 8; n++)
+					{
+					const float val = corners[((bi + (n & 1))*cornersY + bj + ((n >> 1) & 1))*cornersZ + bk + (n >> 2)];
+					minVal = std::min(minVal, val);
+					maxVal = std::max(maxVal, val);
+					}
+				blocks[(bi*blocksY + bj)*blocksZ + bk] = !(minVal > margin || maxVal < -margin);
+				}
+	}
+
+
+void Implicit::getSurfaceCells(const std::vector<unsigned char> & blocks, unsigned int i,
+                               unsigned int cellsY, unsigned int cellsZ, unsigned char * cells)
+	{
+	const unsigned int B = SKIP_BLOCK_DIM;
+	const unsigned int blocksY = (cellsY + B-1)/B, blocksZ = (cellsZ + B-1)/B;
+	const unsigned char * row = &blocks[i/B*blocksY*blocksZ];
+	for (unsigned int j = 0; j < cellsY; j++)
+		for (unsigned int k = 0; k < cellsZ; k++)
+			cells[j*cellsZ + k] = row[j/B*blocksZ + k/B];
+	}
+
+
+void Implicit::getSurfaceCorners(const std::vector<unsigned char> & blocks, unsigned int p,
+                                 unsigned int cellsX, unsigned int cellsY, unsigned int cellsZ, unsigned char * points)
+	{
+	const unsigned int B = SKIP_BLOCK_DIM;
+	const unsigned int blocksY = (cellsY + B-1)/B, blocksZ = (cellsZ + B-1)/B;
+
+	// The blocks of the slabs on both sides of the plane, merged
+	std::vector<unsigned char> row(blocksY*blocksZ, 0);
+	for (unsigned int s = p > 0 ? p-1 : 0; s <= p && s < cellsX; s++)
+		for (unsigned int b = 0; b < row.size(); b++)
+			row[b] |= blocks[s/B*blocksY*blocksZ + b];
+
+	// A corner belongs to the cells on both sides of it along y and z
+	for (unsigned int j = 0; j <= cellsY; j++)
+		{
+		const unsigned int bj0 = j > 0 ? (j-1)/B : 0, bj1 = std::min(j/B, blocksY-1);
+		for (unsigned int k = 0; k <= cellsZ; k++)
+			{
+			const unsigned int bk0 = k > 0 ? (k-1)/B : 0, bk1 = std::min(k/B, blocksZ-1);
+			points[j*(cellsZ+1) + k] = row[bj0*blocksZ + bk0] | row[bj0*blocksZ + bk1] |
+			                           row[bj1*blocksZ + bk0] | row[bj1*blocksZ + bk1];
+			}
+		}
+	}
+
+
 Bbox Implicit::getBoundingBox() const
 	{
 	// transform returns a copy
@@ -219,3 +477,33 @@ void Implicit::transformWorld2Obj(float & x, float & y, float & z) const
 	vprim = mWorld2Obj*v;
 	x = vprim[0]; y = vprim[1]; z = vprim[2];
 	}
+
+
+float Implicit::getTransformScale() const
+	{
+	// The largest singular value of the linear part is bounded by the
+	// geometric mean of its max row sum and max column sum norms
+	const Matrix4x4<float> & t = getTransform();
+	float rowNorm = 0, colNorm = 0;
+	for (unsigned int i = 0; i < 3; i++) {
+		rowNorm = std::max(rowNorm, std::abs(t(i,0)) + std::abs(t(i,1)) + std::abs(t(i,2)));
+		colNorm = std::max(colNorm, std::abs(t(0,i)) + std::abs(t(1,i)) + std::abs(t(2,i)));
+		}
+	return std::sqrt(rowNorm*colNorm);
+	}
+
+
+Vector3<float> Implicit::gradientObj2World(const Vector3<float> & gradient) const
+	{
+	// The derivative of f(M p) with respect to p is M^T times that of f
+	const Matrix4x4<float> & m = mWorld2Obj;
+	return Vector3<float>(m(0,0)*gradient[0] + m(1,0)*gradient[1] + m(2,0)*gradient[2],
+	                      m(0,1)*gradient[0] + m(1,1)*gradient[1] + m(2,1)*gradient[2],
+	                      m(0,2)*gradient[0] + m(1,2)*gradient[1] + m(2,2)*gradient[2]);
+	}
+
+
+float Implicit::getWorld2ObjRowNorm(unsigned int i) const
+	{
+	return mWorld2Obj(i,0)*mWorld2Obj(i,0) + mWorld2Obj(i,1)*mWorld2Obj(i,1) + mWorld2Obj(i,2)*mWorld2Obj(i,2);
+	}
@@ -18,6 +18,8 @@
 #include "Mesh.h"
 #include "SimpleMesh.h"
 #include "MarchingCubes.h"
+#include "SurfaceNets.h"
+#include "ImplicitProgram.h"
 
 /*!  \brief Implicit base class */
 class Implicit : public Geometry{
@@ -33,8 +35,61 @@ public:
   //! calculate the curvature of the implicit at world coordinates x y z
   virtual float getCurvature(float x, float y, float z, float delta = 1e-3) const;  // delta is the dx used for calculating the normal.
 
-  //! Creates a drawable mesh by running marching cubes over the bounding box
-  template <class MeshType> void triangulate(float sampleDensity);
+  /*!
+   * Evaluates the implicit together with its gradient and its curvature (the
+   * Laplacian, as getCurvature()) at world coordinates x y z, and returns the
+   * value. getCurvature() goes through this method. The default takes central
+   * differences of width delta from 7 evaluations, implicits with analytic
+   * derivatives override it and ignore delta. The default getGradient() only
+   * needs the 6 samples around the point, so those implicits also override
+   * getGradient() with getDerivativesGradient().
+   */
+  virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const;
+
+  /*!
+   * Returns true if the value at any point a world space distance d > 0 outside
+   * the bounding box is at least a*d*d + b*d, with a, b >= 0. Used to skip
+   * implicits that cannot affect a union, see BVHUnion. The default gives no bound.
+   */
+  virtual bool getValueBound(float & a, float & b) const { return false; }
+
+  /*!
+   * Adds the instructions that evaluate the implicit to program, see
+   * ImplicitProgram. The default evaluates it through getValue().
+   */
+  virtual void compile(ImplicitProgram & program) const;
+
+  //! The methods triangulate() can extract the surface with
+  enum Extractor { MARCHING_CUBES, SURFACE_NETS, DUAL_CONTOURING };
+
+  /*!
+   * Creates a drawable mesh by running the extractor set by setExtractor(),
+   * marching cubes by default, over the bounding box.
+   * If maxGradient is positive it must bound the length of the gradient in the
+   * bounding box, which is 1 for a signed distance function. The corners of
+   * blocks of SKIP_BLOCK_DIM^3 cells are then evaluated first, and blocks whose
+   * corner values are all further than maxGradient times half the block
+   * diagonal from zero, on the same side, are skipped without evaluating them.
+   * If normals is set every vertex gets the normalized getGradient() at its
+   * position as its normal when it is extracted, and the mesh needs no
+   * calculateVertexNormals().
+   */
+  template <class MeshType> void triangulate(float sampleDensity, float maxGradient = 0, bool normals = false);
+  /*!
+   * Sets the extractor of triangulate() for all implicits. SurfaceNets and
+   * DualContouring give about as many triangles as MarchingCubes, but better
+   * shaped ones
+   */
+  static void setExtractor(Extractor extractor) { mExtractor = extractor; }
+  static Extractor getExtractor() { return mExtractor; }
+
+  /*!
+   * Writes the marching cubes mesh of triangulate() to os in OBJ format, slab
+   * by slab, without building the mesh. Only the values and the vertex caches
+   * of the slabs being extracted are kept in memory, so meshes larger than
+   * the memory can be extracted. Returns false if writing failed.
+   */
+  virtual bool streamTriangulation(std::ostream & os, float sampleDensity, float maxGradient = 0) const;
   //! Returns the mesh for outside manipultaion. Decimation etc.
   template <class MeshType> MeshType & getMesh() { return static_cast<MeshType &>(*mMesh); }
 
@@ -54,7 +109,101 @@ public:
   virtual void setTransform(const Matrix4x4<float> & transform);
 
 protected:
+  //! The gradient from getValueAndDerivatives(), for implicits with analytic derivatives
+  Vector3<float> getDerivativesGradient(float x, float y, float z, float delta) const;
+
+  //! \name Empty space skipping in triangulate()
+  //@{
+  //! Side length of the blocks, measured in cells
+  static const unsigned int SKIP_BLOCK_DIM = 8;
+  /*!
+   * Evaluates program at the corners of the blocks of the cells with corners
+   * xs, ys and zs, and sets blocks[(bi*blocksY + bj)*blocksZ + bk] for the
+   * blocks that may contain the surface
+   */
+  static void findSurfaceBlocks(const ImplicitProgram & program, const std::vector<float> & xs, const std::vector<float> & ys,
+                                const std::vector<float> & zs, float delta, float maxGradient, std::vector<unsigned char> & blocks);
+  //! Sets cells[j*cellsZ + k] for the cells of slab i in the blocks that may contain the surface
+  static void getSurfaceCells(const std::vector<unsigned char> & blocks, unsigned int i,
+                              unsigned int cellsY, unsigned int cellsZ, unsigned char * cells);
+  //! Sets points[j*(cellsZ+1) + k] for the corners on plane p of the cells in those blocks
+  static void getSurfaceCorners(const std::vector<unsigned char> & blocks, unsigned int p,
+                                unsigned int cellsX, unsigned int cellsY, unsigned int cellsZ, unsigned char * points);
+  //! Evaluates program at the corners of the slabs of cells, one x plane at a time
+  class SlabSampler {
+  public:
+    //! The corners are xs, ys and zs, blocks as for extractSlabs()
+    SlabSampler(const ImplicitProgram & program, const std::vector<float> & xs, const std::vector<float> & ys,
+                const std::vector<float> & zs, const std::vector<unsigned char> & blocks);
+    //! Number of corners on a plane, ys.size()*zs.size()
+    unsigned int getSlabSize() const { return mSlabY.size(); }
+    /*!
+     * Sets slab[j*zs.size() + k] to the value at (xs[p], ys[j], zs[k]). When
+     * skipping empty space, only the corners of the cells kept are evaluated,
+     * the other values are left as they were
+     */
+    void sample(unsigned int p, float * slab);
+    //! Returns the cells of slab i to extract, for MarchingCubes::addSlab(), NULL for all
+    const unsigned char * getCells(unsigned int i);
+
+  protected:
+    const ImplicitProgram & mProgram;
+    const std::vector<float> & mXs;
+    const std::vector<unsigned char> & mBlocks;
+    unsigned int mCellsX, mCellsY, mCellsZ;
+    //! The y and z coordinates of a plane of corners, each plane is evaluated at once
+    std::vector<float> mSlabX, mSlabY, mSlabZ;
+    //! The coordinates and values of the corners evaluated when skipping
+    std::vector<float> mGatherY, mGatherZ, mGathered;
+    std::vector<unsigned int> mGatherIndex;
+    std::vector<unsigned char> mCells, mPoints;
+    //! The stack of mProgram, a sampler is used by one thread
+    std::vector<float> mStack;
+  };
+  //@}
+
+  //! The gradient of an implicit at x*scale + offset, for the normals of the extractors
+  class GradientField : public Function3D<Vector3<float> > {
+  public:
+    GradientField(const Implicit & implicit, float scale = 1, const Vector3<float> & offset = Vector3<float>(0,0,0))
+      : mImplicit(implicit), mScale(scale), mOffset(offset) { }
+    virtual Vector3<float> getValue(float x, float y, float z) const {
+      return mImplicit.getGradient(x*mScale + mOffset[0], y*mScale + mOffset[1], z*mScale + mOffset[2]);
+    }
+    virtual Vector3<float> getValue(int i, int j, int k) const { return getValue((float)i, (float)j, (float)k); }
+    virtual Vector3<float> getMaxValue() const { return Vector3<float>(1); }
+
+  protected:
+    const Implicit & mImplicit;
+    float mScale;
+    Vector3<float> mOffset;
+  };
+
+  //! Sets the corners of the cells of triangulate() along each axis of the bounding box
+  void getCellCorners(float delta, std::vector<float> & xs, std::vector<float> & ys, std::vector<float> & zs) const;
+
+  /*!
+   * Extracts the cells with corners xs, ys and zs of program into mesh with
+   * one SlabExtractor (MarchingCubes, SurfaceNets or DualContouring) per chunk
+   * of slabs. If blocks is not empty only the cells in the blocks that may
+   * contain the surface are extracted, see findSurfaceBlocks(). If gradients
+   * is not NULL the vertices get normals, see MarchingCubes::setGradients()
+   */
+  template <class SlabExtractor>
+  static void extractSlabs(const ImplicitProgram & program, const std::vector<float> & xs, const std::vector<float> & ys,
+                           const std::vector<float> & zs, float delta, const std::vector<unsigned char> & blocks,
+                           const Function3D<Vector3<float> > * gradients, IndexedMesh & mesh);
+
+  //! The extractor of triangulate()
+  static Extractor mExtractor;
+
   void transformWorld2Obj(float & x, float & y, float & z) const;
+  //! Returns an upper bound on how much the transform stretches distances from object to world space
+  float getTransformScale() const;
+  //! Maps a gradient with respect to object coordinates to one with respect to world coordinates
+  Vector3<float> gradientObj2World(const Vector3<float> & gradient) const;
+  //! Returns the squared norm of row i of the linear part of mWorld2Obj
+  float getWorld2ObjRowNorm(unsigned int i) const;
 
   Mesh * mMesh;
   Bbox mBox;
@@ -62,11 +211,11 @@ protected:
 };
 
 /*!
- * Marching cubes mesh extraction. Runs over the bounding box.
+ * Mesh extraction. Runs over the bounding box.
  * Must be declared in h-file since templating is used.
  */
 template <class MeshType>
-void Implicit::triangulate(float delta)
+void Implicit::triangulate(float delta, float maxGradient, bool normals)
 {
   if (mMesh != NULL) {
     delete mMesh;
@@ -75,48 +224,83 @@ void Implicit::triangulate(float delta)
 
   mMesh = new MeshType();
 
-  // Get axis aligned bounding box (in world space)
-  Bbox b = getBoundingBox();
-  Vector3<float> & pmin = b.pMin;
-  Vector3<float> & pmax = b.pMax;
+  std::vector<float> xs, ys, zs;
+  getCellCorners(delta, xs, ys, zs);
+  const ImplicitProgram program(*this);
 
-  // Prepare progress bar
-  unsigned int samplesX = static_cast<unsigned int>( (pmax.x() - pmin.x()) / delta );
-  unsigned int samplesY = static_cast<unsigned int>( (pmax.y() - pmin.y()) / delta );
-  unsigned int samplesZ = static_cast<unsigned int>( (pmax.z() - pmin.z()) / delta );
-  unsigned int totalSamples = samplesX*samplesY*samplesZ;
-  unsigned int currentSample = 0;
-  unsigned int reportFreq = totalSamples / 30;
+  // Blocks of cells that may contain the surface, when skipping empty space
+  std::vector<unsigned char> blocks;
+  if (maxGradient > 0)
+    findSurfaceBlocks(program, xs, ys, zs, delta, maxGradient, blocks);
 
-  unsigned int numTriangles(0);
-  // Loop over bounding box
+  const GradientField gradientField(*this);
+  const Function3D<Vector3<float> > * gradients = normals ? &gradientField : NULL;
+
+  IndexedMesh indexed;
   std::cerr << "Triangulating [";
-  for(float i = pmin.x(); i < pmax.x()-0.5*delta; i += delta ) {
-    for(float j = pmin.y(); j < pmax.y()-0.5*delta; j += delta ) {
-      for(float k = pmin.z(); k < pmax.z()-0.5*delta; k += delta ) {
-	      float voxelValues[8] = {
-	        getValue(i,j,k),
-	        getValue(i+delta, j, k),
-	        getValue(i+delta, j+delta, k),
-	        getValue(i, j+delta, k),
-	        getValue(i, j, k+delta),
-	        getValue(i+delta, j, k+delta),
-	        getValue(i+delta, j+delta, k+delta),
-	        getValue(i, j+delta, k+delta)
-	      };
-	      std::vector<Vector3<float> > tris = ::triangulate(voxelValues, i, j, k, delta);
-	      for(unsigned int n = 0; n < tris.size(); n+=3){
-	        mMesh->addTriangle(tris.at(n), tris.at(n+2), tris.at(n+1)); // triangulation uses clockwise orientation
-			numTriangles++;
-	      }
-
-        currentSample++;
-        if (currentSample % reportFreq == 0)
-          std::cerr << "=";
-      }
+  switch (mExtractor) {
+  case SURFACE_NETS:
+    extractSlabs<SurfaceNets>(program, xs, ys, zs, delta, blocks, gradients, indexed);
+    break;
+  case DUAL_CONTOURING:
+    extractSlabs<DualContouring>(program, xs, ys, zs, delta, blocks, gradients, indexed);
+    break;
+  default:
+    extractSlabs<MarchingCubes>(program, xs, ys, zs, delta, blocks, gradients, indexed);
+    break;
+  }
+  mMesh->buildFromIndexed(indexed.mVerts, indexed.mIndices);
+  if (normals)
+    mMesh->setVertexNormals(indexed.mNormals);
+  std::cerr << "]" << std::endl<< "done: " << indexed.mIndices.size()/3 << std::endl;
+}
+
+
+template <class SlabExtractor>
+void Implicit::extractSlabs(const ImplicitProgram & program, const std::vector<float> & xs, const std::vector<float> & ys,
+                            const std::vector<float> & zs, float delta, const std::vector<unsigned char> & blocks,
+                            const Function3D<Vector3<float> > * gradients, IndexedMesh & mesh)
+{
+  const unsigned int cellsX = xs.size()-1;
+
+  // Prepare progress bar, reported by the first chunk
+  unsigned int reportedSlabs = 0;
+
+  // The vertices are shared between the cells as they are extracted, so
+  // the mesh is built at once instead of welding every triangle. The slabs
+  // are split into one chunk per thread, merged in order afterwards
+  const int numChunks = std::max(std::min(MarchingCubes::getNumThreads(), (int)cellsX), 1);
+  std::vector<IndexedMesh> chunkMeshes(numChunks);
+  std::vector<SlabExtractor *> chunks(numChunks);
+
+  // Loop over bounding box
+#pragma omp parallel for schedule(static, 1) num_threads(numChunks)
+  for (int c = 0; c < numChunks; c++) {
+    const unsigned int first = cellsX*c/numChunks, end = cellsX*(c+1)/numChunks;
+    chunks[c] = new SlabExtractor(xs, ys, zs, delta, chunkMeshes[c]);
+    chunks[c]->setChunk(first, end);
+    chunks[c]->setGradients(gradients);
+    // The slabs before the chunk the extractor needs
+    const unsigned int start = std::max((int)first - SlabExtractor::CHUNK_OVERLAP, 0);
+
+    // The values at two x slabs of corners
+    SlabSampler sampler(program, xs, ys, zs, blocks);
+    std::vector<float> slab0(sampler.getSlabSize()), slab1(sampler.getSlabSize());
+    sampler.sample(start, &slab0[0]);
+
+    for (unsigned int i = start; i < end; i++) {
+      sampler.sample(i+1, &slab1[0]);
+      chunks[c]->addSlab(i, &slab0[0], &slab1[0], sampler.getCells(i));
+      slab0.swap(slab1);
+
+      for (; c == 0 && reportedSlabs < (i+1)*30/end; reportedSlabs++)
+        std::cerr << "=";
     }
   }
-  std::cerr << "]" << std::endl<< "done: " << numTriangles << std::endl;
+
+  SlabExtractor::merge(chunks, mesh);
+  for (int c = 0; c < numChunks; c++)
+    delete chunks[c];
 }
 
 
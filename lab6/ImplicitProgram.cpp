@@ -0,0 +1,285 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#include "ImplicitProgram.h"
+#include "Implicit.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+ImplicitProgram::ImplicitProgram(const Implicit & implicit) : mDepth(0), mMaxDepth(0)
+{
+  mFrames.push_back(Matrix4x4<float>());
+  implicit.compile(*this);
+  assert(mDepth == 1 && mFrames.size() == 1);
+}
+
+
+void ImplicitProgram::pushFrame(const Matrix4x4<float> & world2Obj)
+{
+  mFrames.push_back(world2Obj * mFrames.back());
+}
+
+
+void ImplicitProgram::popFrame()
+{
+  assert(mFrames.size() > 1);
+  mFrames.pop_back();
+}
+
+
+void ImplicitProgram::getLeafTransform(const Matrix4x4<float> & world2Obj, float * constants) const
+{
+  const Matrix4x4<float> m = world2Obj * mFrames.back();
+  for (unsigned int i = 0; i < 3; i++)
+    for (unsigned int j = 0; j < 4; j++)
+      constants[4*i + j] = m(i,j);
+}
+
+
+void ImplicitProgram::addInstruction(OpCode op, const float * constants, int numConstants, int depthChange)
+{
+  Instruction instruction;
+  instruction.mOp = op;
+  instruction.mConstants = mConstants.size();
+  instruction.mCall = -1;
+  mInstructions.push_back(instruction);
+  mConstants.insert(mConstants.end(), constants, constants + numConstants);
+
+  mDepth += depthChange;
+  mMaxDepth = std::max(mMaxDepth, mDepth);
+  assert(mDepth > 0);
+}
+
+
+void ImplicitProgram::addSphere(const Matrix4x4<float> & world2Obj, float radius2)
+{
+  float constants[13];
+  getLeafTransform(world2Obj, constants);
+  constants[12] = radius2;
+  addInstruction(SPHERE, constants, 13, 1);
+}
+
+
+void ImplicitProgram::addDistanceSphere(const Matrix4x4<float> & world2Obj, float radius)
+{
+  float constants[13];
+  getLeafTransform(world2Obj, constants);
+  constants[12] = radius;
+  addInstruction(DISTANCE_SPHERE, constants, 13, 1);
+}
+
+
+void ImplicitProgram::addQuadric(const Matrix4x4<float> & quadric)
+{
+  // p^T Q p in the frame F is (F p)^T Q (F p)
+  const Matrix4x4<float> & frame = mFrames.back();
+  const Matrix4x4<float> q = frame.transpose() * quadric * frame;
+  float constants[16];
+  for (unsigned int i = 0; i < 4; i++)
+    for (unsigned int j = 0; j < 4; j++)
+      constants[4*i + j] = q(i,j);
+  addInstruction(QUADRIC, constants, 16, 1);
+}
+
+
+void ImplicitProgram::addCyclide(const Matrix4x4<float> & world2Obj, float A, float B, float C, float D)
+{
+  float constants[16];
+  getLeafTransform(world2Obj, constants);
+  constants[12] = A;
+  constants[13] = B;
+  constants[14] = C;
+  constants[15] = D;
+  addInstruction(CYCLIDE, constants, 16, 1);
+}
+
+
+void ImplicitProgram::addCall(const Implicit * implicit)
+{
+  // The last constant tells if the points need to be transformed into the frame
+  float constants[13];
+  getLeafTransform(Matrix4x4<float>(), constants);
+  const Matrix4x4<float> & frame = mFrames.back();
+  bool identity = true;
+  for (unsigned int i = 0; i < 4; i++)
+    for (unsigned int j = 0; j < 4; j++)
+      identity = identity && frame(i,j) == (i == j ? 1.f : 0.f);
+  constants[12] = identity ? 0.f : 1.f;
+  addInstruction(CALL, constants, 13, 1);
+
+  mInstructions.back().mCall = mCalls.size();
+  mCalls.push_back(implicit);
+}
+
+
+void ImplicitProgram::addOperator(OpCode op, float p)
+{
+  assert(op >= UNION);
+  addInstruction(op, &p, 1, -1);
+}
+
+
+void ImplicitProgram::getValues(const float * x, const float * y, const float * z, float * values, int count, float * stack) const
+{
+  for (int first = 0; first < count; first += BATCH_SIZE)
+    evaluate(x + first, y + first, z + first, values + first, std::min(count - first, (int)BATCH_SIZE), stack, BATCH_SIZE);
+}
+
+
+void ImplicitProgram::getValues(const float * x, const float * y, const float * z, float * values, int count) const
+{
+  std::vector<float> stack(getStackSize());
+  getValues(x, y, z, values, count, &stack[0]);
+}
+
+
+float ImplicitProgram::getValue(float x, float y, float z) const
+{
+  // A single point needs one float per level of the stack
+  float value;
+  if (mMaxDepth <= POINT_STACK_SIZE) {
+    float stack[POINT_STACK_SIZE];
+    evaluate(&x, &y, &z, &value, 1, stack, 1);
+  }
+  else {
+    std::vector<float> stack(mMaxDepth);
+    evaluate(&x, &y, &z, &value, 1, &stack[0], 1);
+  }
+  return value;
+}
+
+
+void ImplicitProgram::evaluate(const float * x, const float * y, const float * z, float * values, int count, float * stack, int stride) const
+{
+  // Number of batches on the stack
+  int depth = 0;
+
+  const unsigned int size = mInstructions.size();
+  for (unsigned int i = 0; i < size; i++) {
+    const Instruction & instruction = mInstructions[i];
+    const float * c = &mConstants[instruction.mConstants];
+
+    // Each leaf pushes a batch of values, each operator combines the top two.
+    // The expressions follow the getValue() of the corresponding implicit
+    // operation by operation, w = 1 included, so the results are the same up
+    // to how the math library rounds in the blends
+    // The batch written, on top of the stack, and for operators b, the batch
+    // popped off the top
+    float * a;
+    const float * b;
+    if (instruction.mOp < UNION) {
+      a = stack + depth*stride;
+      b = a;
+      depth++;
+    }
+    else {
+      depth--;
+      a = stack + (depth-1)*stride;
+      b = stack + depth*stride;
+    }
+
+    switch (instruction.mOp) {
+    case SPHERE:
+      for (int n = 0; n < count; n++) {
+        const float px = x[n]*c[0] + y[n]*c[1] + z[n]*c[2]  + c[3];
+        const float py = x[n]*c[4] + y[n]*c[5] + z[n]*c[6]  + c[7];
+        const float pz = x[n]*c[8] + y[n]*c[9] + z[n]*c[10] + c[11];
+        a[n] = (px*px + py*py + pz*pz + 1.f) - 1.f - c[12];
+      }
+      break;
+
+    case DISTANCE_SPHERE:
+      for (int n = 0; n < count; n++) {
+        const float px = x[n]*c[0] + y[n]*c[1] + z[n]*c[2]  + c[3];
+        const float py = x[n]*c[4] + y[n]*c[5] + z[n]*c[6]  + c[7];
+        const float pz = x[n]*c[8] + y[n]*c[9] + z[n]*c[10] + c[11];
+        a[n] = std::sqrt((px*px + py*py + pz*pz + 1.f) - 1.f) - c[12];
+      }
+      break;
+
+    case QUADRIC:
+      for (int n = 0; n < count; n++) {
+        const float qx = x[n]*c[0]  + y[n]*c[1]  + z[n]*c[2]  + c[3];
+        const float qy = x[n]*c[4]  + y[n]*c[5]  + z[n]*c[6]  + c[7];
+        const float qz = x[n]*c[8]  + y[n]*c[9]  + z[n]*c[10] + c[11];
+        const float qw = x[n]*c[12] + y[n]*c[13] + z[n]*c[14] + c[15];
+        a[n] = x[n]*qx + y[n]*qy + z[n]*qz + qw;
+      }
+      break;
+
+    case CYCLIDE: {
+      const float A = c[12], B = c[13], C = c[14], D = c[15];
+      for (int n = 0; n < count; n++) {
+        const float px = x[n]*c[0] + y[n]*c[1] + z[n]*c[2]  + c[3];
+        const float py = x[n]*c[4] + y[n]*c[5] + z[n]*c[6]  + c[7];
+        const float pz = x[n]*c[8] + y[n]*c[9] + z[n]*c[10] + c[11];
+        const float s = px*px + py*py + pz*pz + B*B - D*D;
+        a[n] = s*s - 4.f*((A*px - C*D)*(A*px - C*D) + B*B * py*py);
+      }
+      break;
+    }
+
+    case CALL: {
+      const Implicit * implicit = mCalls[instruction.mCall];
+      if (c[12] == 0) {
+        for (int n = 0; n < count; n++)
+          a[n] = implicit->getValue(x[n], y[n], z[n]);
+      }
+      else {
+        for (int n = 0; n < count; n++)
+          a[n] = implicit->getValue(x[n]*c[0] + y[n]*c[1] + z[n]*c[2]  + c[3],
+                                    x[n]*c[4] + y[n]*c[5] + z[n]*c[6]  + c[7],
+                                    x[n]*c[8] + y[n]*c[9] + z[n]*c[10] + c[11]);
+      }
+      break;
+    }
+
+    case UNION:
+      for (int n = 0; n < count; n++)
+        a[n] = std::min(a[n], b[n]);
+      break;
+
+    case INTERSECTION:
+      for (int n = 0; n < count; n++)
+        a[n] = std::max(a[n], b[n]);
+      break;
+
+    case DIFFERENCE:
+      for (int n = 0; n < count; n++)
+        a[n] = std::max(a[n], -b[n]);
+      break;
+
+    case BLENDED_UNION: {
+      const float p = c[0];
+      for (int n = 0; n < count; n++)
+        a[n] = -std::log(std::pow(std::exp(-a[n]*p) + std::exp(-b[n]*p), 1.0f/p));
+      break;
+    }
+
+    case BLENDED_INTERSECTION: {
+      const float p = c[0];
+      for (int n = 0; n < count; n++)
+        a[n] = -std::log(std::pow(std::exp(-a[n]*-p) + std::exp(-b[n]*-p), 1.0f/-p));
+      break;
+    }
+
+    case BLENDED_DIFFERENCE: {
+      const float p = c[0];
+      for (int n = 0; n < count; n++)
+        a[n] = -std::log(std::pow(std::exp(-a[n]*-p) + std::exp(b[n]*-p), 1.0f/-p));
+      break;
+    }
+    }
+  }
+
+  std::copy(stack, stack + count, values);
+}
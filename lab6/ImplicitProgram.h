@@ -0,0 +1,140 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#ifndef __implicit_program_h__
+#define __implicit_program_h__
+
+#include "Matrix4x4.h"
+#include <vector>
+
+class Implicit;
+
+/*! \brief An Implicit tree compiled into a flat list of instructions
+ *
+ * Evaluating an Implicit tree point by point makes a virtual call per node and
+ * transforms the point again in every leaf. An ImplicitProgram walks the tree
+ * once (Implicit::compile) and turns it into the instructions of a small stack
+ * machine in postfix order, where every leaf carries the transform from world
+ * space to its own frame composed with those of its parents.
+ *
+ * getValues() runs the instructions over BATCH_SIZE points at a time. Each
+ * instruction loops over the whole batch with the points stored as structure of
+ * arrays, so the loops compile to SIMD code. The values are kept on a stack of
+ * getStackSize() floats, which callers evaluating many batches pass in, one per
+ * thread, so no memory is allocated per call.
+ *
+ * Implicits that do not implement compile() are evaluated through getValue()
+ * point by point, so any tree can be compiled. The tree is not copied, these
+ * implicits must outlive the program.
+ */
+class ImplicitProgram
+{
+public :
+
+  //! Number of points evaluated by each instruction at once
+  static const int BATCH_SIZE = 64;
+  //! Stack depth getValue() handles without allocating
+  static const int POINT_STACK_SIZE = 32;
+
+  enum OpCode {
+    //! |M p|^2 - r^2
+    SPHERE,
+    //! |M p| - r
+    DISTANCE_SPHERE,
+    //! p^T Q p
+    QUADRIC,
+    //! Dupin cyclide, see Cyclide
+    CYCLIDE,
+    //! Implicit::getValue() per point
+    CALL,
+    //! Operators combining the two values on top of the stack, see CSG.h
+    UNION, INTERSECTION, DIFFERENCE,
+    BLENDED_UNION, BLENDED_INTERSECTION, BLENDED_DIFFERENCE
+  };
+
+  //! Compiles implicit
+  ImplicitProgram(const Implicit & implicit);
+
+  //! Number of floats in the stack of getValues()
+  int getStackSize() const { return mMaxDepth * BATCH_SIZE; }
+
+  /*!
+   * Evaluates the implicit at the count world space points (x[n], y[n], z[n]).
+   * stack is getStackSize() floats of scratch space, not shared between threads
+   */
+  void getValues(const float * x, const float * y, const float * z, float * values, int count, float * stack) const;
+  //! As above with a stack of its own, for single calls
+  void getValues(const float * x, const float * y, const float * z, float * values, int count) const;
+
+  //! Evaluates the implicit at the world space point (x, y, z)
+  float getValue(float x, float y, float z) const;
+
+  //! Returns the number of instructions
+  int getNumInstructions() const { return mInstructions.size(); }
+
+  //! Returns true if no part of the tree is evaluated through Implicit::getValue()
+  bool isCompiled() const { return mCalls.empty(); }
+
+  //! \name Used by Implicit::compile() to add instructions
+  //@{
+  /*!
+   * Composes world2Obj with the current frame. The leafs added until popFrame()
+   * get their points in the new frame, for implicits made of other implicits.
+   */
+  void pushFrame(const Matrix4x4<float> & world2Obj);
+  void popFrame();
+
+  //! Adds |M p|^2 - r^2, with M = world2Obj composed with the current frame
+  void addSphere(const Matrix4x4<float> & world2Obj, float radius2);
+  //! Adds |M p| - r, with M = world2Obj composed with the current frame
+  void addDistanceSphere(const Matrix4x4<float> & world2Obj, float radius);
+  //! Adds p^T Q p, with Q = quadric in the current frame
+  void addQuadric(const Matrix4x4<float> & quadric);
+  //! Adds the cyclide with parameters A, B, C, D, see Cyclide
+  void addCyclide(const Matrix4x4<float> & world2Obj, float A, float B, float C, float D);
+  //! Adds implicit->getValue() of the point in the current frame
+  void addCall(const Implicit * implicit);
+  //! Adds a CSG operator applied to the two values on top of the stack, p is the blending exponent
+  void addOperator(OpCode op, float p = 0);
+  //@}
+
+protected :
+
+  struct Instruction {
+    OpCode mOp;
+    //! Index of the first constant in mConstants
+    int mConstants;
+    //! Index of the implicit in mCalls for CALL
+    int mCall;
+  };
+
+  //! Adds an instruction, changing the stack depth by depthChange
+  void addInstruction(OpCode op, const float * constants, int numConstants, int depthChange);
+  //! Writes the 3x4 affine part of world2Obj composed with the current frame to constants
+  void getLeafTransform(const Matrix4x4<float> & world2Obj, float * constants) const;
+  /*!
+   * Evaluates a batch of count points, at most stride. The stack holds
+   * mMaxDepth batches, stride floats apart
+   */
+  void evaluate(const float * x, const float * y, const float * z, float * values, int count, float * stack, int stride) const;
+
+  std::vector<Instruction> mInstructions;
+  std::vector<float> mConstants;
+  std::vector<const Implicit *> mCalls;
+
+  //! Frames of the leafs being added, world to frame transforms
+  std::vector<Matrix4x4<float> > mFrames;
+
+  int mDepth;
+  int mMaxDepth;
+};
+
+#endif
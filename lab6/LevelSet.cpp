@@ -12,14 +12,11 @@
 
 #include "LevelSet.h"
 #include "Util.h"
-
-static const float oneByThree(1.0f/3.0f);
-static const float oneBySix(1.0f/6.0f);
-static const float fiveBySix(5.0f/6.0f);
-static const float sevenBySix(7.0f/6.0f);
-static const float elevenBySix(11.0f/6.0f);
-static const float oneByFour(1.0f/4.0f);
-static const float thirteenByTwelve(13.0f/12.0f);
+#include "ImplicitProgram.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
 
 LevelSet::LevelSet(float dx) : mDx(dx)
 	{
@@ -33,17 +30,7 @@ LevelSet::LevelSet(float dx, const Implicit & impl) : mDx(dx)
 	Bbox b = impl.getBoundingBox();
 	setBoundingBox(b);
 
-	// Loop over volume and sample the implicit function
-	int i = 0, j = 0, k = 0;
-	for(float x = mBox.pMin.x(); x < mBox.pMax.x()+0.5*mDx; x += mDx, i++) {
-		for(float y = mBox.pMin.y(); y < mBox.pMax.y()+0.5*mDx; y += mDx, j++) {
-			for(float z = mBox.pMin.z(); z < mBox.pMax.z()+0.5*mDx; z += mDx, k++ ) {
-				mGrid.setValue(i,j,k, impl.getValue(x,y,z));
-				}
-			k = 0;
-			}
-		j = 0;
-		}
+	sample(impl);
 	}
 
 
@@ -51,17 +38,125 @@ LevelSet::LevelSet(float dx, const Implicit & impl, const Bbox & box) : mDx(dx)
 	{
 	setBoundingBox(box);
 
-	// Loop over volume and sample the implicit function
-	int i = 0, j = 0, k = 0;
-	for(float x = mBox.pMin.x(); x < mBox.pMax.x()+0.5*mDx; x += mDx, i++) {
-		for(float y = mBox.pMin.y(); y < mBox.pMax.y()+0.5*mDx; y += mDx, j++) {
-			for(float z = mBox.pMin.z(); z < mBox.pMax.z()+0.5*mDx; z += mDx, k++ ) {
-				mGrid.setValue(i,j,k, impl.getValue(x,y,z));
-				}
-			k = 0;
+	sample(impl);
+	}
+
+
+LevelSet::LevelSet(float dx, const Implicit & impl, float bandWidth, float maxGradient) : mDx(dx)
+	{
+	Bbox b = impl.getBoundingBox();
+	setBoundingBox(b);
+
+	sample(impl, bandWidth, maxGradient);
+	}
+
+
+void LevelSet::sample(const Implicit & impl, float bandWidth, float maxGradient)
+	{
+	const int dimX = mGrid.getDimX(), dimY = mGrid.getDimY(), dimZ = mGrid.getDimZ();
+	const int blocksX = mGrid.getBlocksX(), blocksY = mGrid.getBlocksY(), blocksZ = mGrid.getBlocksZ();
+	const int numBlocks = blocksX*blocksY*blocksZ;
+	const int B = LevelSetGrid::getBlockDim();
+
+	// Blocks to sample, the others are set to a constant
+	std::vector<bool> sampled(numBlocks, true);
+
+	// Evaluate impl in batches instead of point by point
+	const ImplicitProgram program(impl);
+
+	if (bandWidth > 0)
+		{
+		setNarrowBandWidth(bandWidth);
+
+		// Sample the corners of all blocks, the last corner is clamped to the grid
+		const int cornersX = blocksX+1, cornersY = blocksY+1, cornersZ = blocksZ+1;
+		const int numCorners = cornersX*cornersY*cornersZ;
+		std::vector<float> x(numCorners), y(numCorners), z(numCorners), corners(numCorners);
+		for (int c = 0; c < numCorners; c++)
+			{
+			const int i = std::min((c / (cornersY*cornersZ)) * B, dimX-1);
+			const int j = std::min((c / cornersZ % cornersY) * B, dimY-1);
+			const int k = std::min((c % cornersZ) * B, dimZ-1);
+			LevelSet::grid2World(i,j,k, x[c],y[c],z[c]);
+			}
+		const int batch = ImplicitProgram::BATCH_SIZE;
+#pragma omp parallel
+			{
+			std::vector<float> stack(program.getStackSize());
+#pragma omp for schedule(dynamic)
+			for (int c = 0; c < numCorners; c += batch)
+				program.getValues(&x[c], &y[c], &z[c], &corners[c], std::min(batch, numCorners - c), &stack[0]);
+			}
+
+		// Every grid point of a block is within half the block diagonal of a corner
+		const float margin = maxGradient * 0.5f * std::sqrt(3.0f) * B * mDx;
+		const float outside = mGrid.getOutsideConstant(), inside = mGrid.getInsideConstant();
+		for (int bi = 0; bi < blocksX; bi++)
+			for (int bj = 0; bj < blocksY; bj++)
+				for (int bk = 0; bk < blocksZ; bk++)
+					{
+					float minVal = std::numeric_limits<float>::max();
+					float maxVal = -std::numeric_limits<float>::max();
+					for (int n = 0; n < 8; n++)
+						{
+						const float val = corners[((bi + (n & 1))*cornersY + bj + ((n >> 1) & 1))*cornersZ + bk + (n >> 2)];
+						minVal = std::min(minVal, val);
+						maxVal = std::max(maxVal, val);
+						}
+					if (minVal > outside + margin)
+						mGrid.setConstantBlock(bi,bj,bk, outside);
+					else if (maxVal < inside - margin)
+						mGrid.setConstantBlock(bi,bj,bk, inside);
+					else
+						continue;
+					sampled[(bi*blocksY + bj)*blocksZ + bk] = false;
+					}
+		}
+
+	// Allocating a block may move the others, so fetch the values once all are allocated
+	std::vector<float *> blocks(numBlocks, (float *)NULL);
+	for (int b = 0; b < numBlocks; b++)
+		if (sampled[b]) mGrid.fillBlock(b / (blocksY*blocksZ), b / blocksZ % blocksY, b % blocksZ);
+	for (int b = 0; b < numBlocks; b++)
+		if (sampled[b]) blocks[b] = mGrid.fillBlock(b / (blocksY*blocksZ), b / blocksZ % blocksY, b % blocksZ);
+
+	// Sample the blocks across threads, the coordinates are computed from the
+	// grid indices so no rounding error accumulates along the axes
+#pragma omp parallel
+		{
+		std::vector<float> stack(program.getStackSize());
+#pragma omp for schedule(dynamic, 4)
+		for (int b = 0; b < numBlocks; b++)
+			{
+			float * values = blocks[b];
+			if (values == NULL) continue;
+
+			// Gather the grid points of the block inside the grid, evaluate them
+			// all at once and scatter the values into the block
+			const int i0 = b / (blocksY*blocksZ) * B, j0 = b / blocksZ % blocksY * B, k0 = b % blocksZ * B;
+			const int i1 = std::min(i0 + B, dimX), j1 = std::min(j0 + B, dimY), k1 = std::min(k0 + B, dimZ);
+			std::vector<float> x(B*B*B), y(B*B*B), z(B*B*B), sample(B*B*B);
+			std::vector<int> offset(B*B*B);
+			int count = 0;
+			for (int i = i0; i < i1; i++)
+				for (int j = j0; j < j1; j++)
+					for (int k = k0; k < k1; k++, count++)
+						{
+						LevelSet::grid2World(i,j,k, x[count],y[count],z[count]);
+						offset[count] = LevelSetGrid::getBlockOffset(i,j,k);
+						}
+
+			program.getValues(&x[0], &y[0], &z[0], &sample[0], count, &stack[0]);
+			for (int n = 0; n < count; n++)
+				values[offset[n]] = sample[n];
 			}
-		j = 0;
 		}
+
+	mGrid.collectNarrowBand();
+
+	// Clamp the sampled values to the band constants
+	if (bandWidth > 0)
+		mGrid.rebuild();
 	}
 
 
@@ -114,18 +209,34 @@ float LevelSet::getValue(int i, int j, int k) const
 
 /*!
 * Evaluates gradient at (x,y,z) through discrete finite difference scheme.
+* The central differences at the grid points around (x,y,z) are interpolated
+* like the values in getValue(), so the gradient is continuous. On a grid edge,
+* where the extracted vertices are, only the two ends of the edge contribute.
 */
 Vector3<float> LevelSet::getGradient(float x, float y, float z, float delta) const
 	{
 	transformWorld2Obj(x,y,z);
 
-	int i = (int)((x - mBox.pMin.x()) / mDx);
-	int j = (int)((y - mBox.pMin.y()) / mDx);
-	int k = (int)((z - mBox.pMin.z()) / mDx);
-
-	//printf("[%f, %f, %f]\n", diffXpm(x,y,z), diffYpm(x,y,z), diffZpm(x,y,z) );
-	return Vector3<float>( diffXpm(i,j,k), diffYpm(i,j,k), diffZpm(i,j,k) );
+	int i,j,k;
+	world2Grid(x,y,z, i,j,k);
+	i = std::max(std::min(i, mGrid.getDimX()-2), 0);
+	j = std::max(std::min(j, mGrid.getDimY()-2), 0);
+	k = std::max(std::min(k, mGrid.getDimZ()-2), 0);
+
+	const float bx = (x - mBox.pMin.x()) / mDx - i;
+	const float by = (y - mBox.pMin.y()) / mDx - j;
+	const float bz = (z - mBox.pMin.z()) / mDx - k;
+
+	Vector3<float> gradient(0,0,0);
+	for (int n = 0; n < 8; n++)
+		{
+		const int di = n & 1, dj = (n >> 1) & 1, dk = n >> 2;
+		const float weight = (di ? bx : 1-bx) * (dj ? by : 1-by) * (dk ? bz : 1-bz);
+		if (weight == 0) continue;
+		gradient += Vector3<float>( diffXpm(i+di,j+dj,k+dk), diffYpm(i+di,j+dj,k+dk), diffZpm(i+di,j+dj,k+dk) ) * weight;
+		}
 	//return Implicit::getGradient(x, y, z, delta);
+	return gradient;
 	}
 
 void LevelSet::setBoundingBox(const Bbox & b)
@@ -210,8 +321,9 @@ void LevelSet::setNarrowBandWidth(float width)
 //! \lab4
 float LevelSet::diffXm(int i, int j, int k)  const
 	{
-	float current =	 mGrid.getValue(i,j,k);
-	float previous = mGrid.getValue(i-1,j,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current =	 c.getValue();
+	float previous = c.getValue(-1,0,0);
 
 	return (current-previous) / mDx;
 	}
@@ -219,8 +331,9 @@ float LevelSet::diffXm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffXp(int i, int j, int k)  const
 	{
-	float current =	 mGrid.getValue(i,j,k);
-	float next = mGrid.getValue(i+1,j,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current =	 c.getValue();
+	float next = c.getValue(1,0,0);
 
 	return (next - current) / mDx;
 	}
@@ -228,17 +341,19 @@ float LevelSet::diffXp(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffXpm(int i, int j, int k)  const
 	{
-	float next		= mGrid.getValue(i+1,j,k);
-	float previous	= mGrid.getValue(i-1,j,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float next		= c.getValue(1,0,0);
+	float previous	= c.getValue(-1,0,0);
 
 	return (next-previous) / (2.0f*mDx);	}
 
 //! \lab4
 float LevelSet::diff2Xpm(int i, int j, int k)  const
 	{
-	float current	= mGrid.getValue(i,j,k);
-	float next		= mGrid.getValue(i+1,j,k);
-	float previous	= mGrid.getValue(i-1,j,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current	= c.getValue();
+	float next		= c.getValue(1,0,0);
+	float previous	= c.getValue(-1,0,0);
 
 	return (next-2.0f*current+previous)/(mDx*mDx);
 	}
@@ -248,8 +363,9 @@ float LevelSet::diff2Xpm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffYm(int i, int j, int k)  const
 	{
-	float current =	 mGrid.getValue(i,j,k);
-	float previous = mGrid.getValue(i,j-1,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current =	 c.getValue();
+	float previous = c.getValue(0,-1,0);
 
 	return (current-previous) / mDx;
 	}
@@ -257,8 +373,9 @@ float LevelSet::diffYm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffYp(int i, int j, int k)  const
 	{
-	float current =	 mGrid.getValue(i,j,k);
-	float next = mGrid.getValue(i,j+1,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current =	 c.getValue();
+	float next = c.getValue(0,1,0);
 
 	return (next - current) / mDx;
 	}
@@ -266,8 +383,9 @@ float LevelSet::diffYp(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffYpm(int i, int j, int k)  const
 	{
-	float next		= mGrid.getValue(i,j+1,k);
-	float previous	= mGrid.getValue(i,j-1,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float next		= c.getValue(0,1,0);
+	float previous	= c.getValue(0,-1,0);
 
 	return (next-previous) / (2.0f*mDx);	
 	}
@@ -275,9 +393,10 @@ float LevelSet::diffYpm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diff2Ypm(int i, int j, int k)  const
 	{
-	float current	= mGrid.getValue(i,j,k);
-	float next		= mGrid.getValue(i,j+1,k);
-	float previous	= mGrid.getValue(i,j-1,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current	= c.getValue();
+	float next		= c.getValue(0,1,0);
+	float previous	= c.getValue(0,-1,0);
 
 	return (next-2.0f*current+previous)/(mDx*mDx);
 	}
@@ -286,8 +405,9 @@ float LevelSet::diff2Ypm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffZm(int i, int j, int k)  const
 	{
-	float current =	 mGrid.getValue(i,j,k);
-	float previous = mGrid.getValue(i,j,k-1);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current =	 c.getValue();
+	float previous = c.getValue(0,0,-1);
 
 	return (current-previous) / mDx;
 	}
@@ -295,8 +415,9 @@ float LevelSet::diffZm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffZp(int i, int j, int k)  const
 	{
-	float current =	 mGrid.getValue(i,j,k);
-	float next = mGrid.getValue(i,j,k+1);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current =	 c.getValue();
+	float next = c.getValue(0,0,1);
 
 	return (next - current) / mDx;
 	}
@@ -304,8 +425,9 @@ float LevelSet::diffZp(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diffZpm(int i, int j, int k)  const
 	{
-	float next		= mGrid.getValue(i,j,k+1);
-	float previous	= mGrid.getValue(i,j,k-1);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float next		= c.getValue(0,0,1);
+	float previous	= c.getValue(0,0,-1);
 
 	return (next-previous) / (2.0f*mDx);	
 	}
@@ -313,9 +435,10 @@ float LevelSet::diffZpm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diff2Zpm(int i, int j, int k)  const
 	{
-	float current	= mGrid.getValue(i,j,k);
-	float next		= mGrid.getValue(i,j,k+1);
-	float previous	= mGrid.getValue(i,j,k-1);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float current	= c.getValue();
+	float next		= c.getValue(0,0,1);
+	float previous	= c.getValue(0,0,-1);
 
 	return (next-2.0f*current+previous)/(mDx*mDx);
 	}
@@ -324,10 +447,11 @@ float LevelSet::diff2Zpm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diff2XYpm(int i, int j, int k)  const
 	{
-	float nextI_nextJ = mGrid.getValue(i+1,j+1,k);
-	float nextI_prevJ = mGrid.getValue(i+1,j-1,k);
-	float prevI_prevJ = mGrid.getValue(i-1,j-1,k);
-	float prevI_nextJ = mGrid.getValue(i-1,j+1,k);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float nextI_nextJ = c.getValue(1,1,0);
+	float nextI_prevJ = c.getValue(1,-1,0);
+	float prevI_prevJ = c.getValue(-1,-1,0);
+	float prevI_nextJ = c.getValue(-1,1,0);
 
 	return (nextI_nextJ - nextI_prevJ + prevI_prevJ - prevI_nextJ )/(4.0f*mDx*mDx);
 	}
@@ -335,10 +459,11 @@ float LevelSet::diff2XYpm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diff2YZpm(int i, int j, int k)  const
 	{
-	float nextJ_nextK = mGrid.getValue(i,j+1,k+1);
-	float nextJ_prevK = mGrid.getValue(i,j+1,k-1);
-	float prevJ_prevK = mGrid.getValue(i,j-1,k-1);
-	float prevJ_nextK = mGrid.getValue(i,j-1,k+1);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float nextJ_nextK = c.getValue(0,1,1);
+	float nextJ_prevK = c.getValue(0,1,-1);
+	float prevJ_prevK = c.getValue(0,-1,-1);
+	float prevJ_nextK = c.getValue(0,-1,1);
 
 	return (nextJ_nextK - nextJ_prevK + prevJ_prevK - prevJ_nextK )/(4.0f*mDx*mDx);
 	}
@@ -346,10 +471,11 @@ float LevelSet::diff2YZpm(int i, int j, int k)  const
 //! \lab4
 float LevelSet::diff2ZXpm(int i, int j, int k)  const
 	{
-	float nextK_nextI = mGrid.getValue(i+1,j,k+1);
-	float nextK_prevI = mGrid.getValue(i-1,j,k+1);
-	float prevK_prevI = mGrid.getValue(i-1,j,k-1);
-	float prevK_nextI = mGrid.getValue(i+1,j,k-1);
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float nextK_nextI = c.getValue(1,0,1);
+	float nextK_prevI = c.getValue(-1,0,1);
+	float prevK_prevI = c.getValue(-1,0,-1);
+	float prevK_nextI = c.getValue(1,0,-1);
 
 	return (nextK_nextI - nextK_prevI + prevK_prevI - prevK_nextI )/(4.0f*mDx*mDx);
 	}
@@ -381,78 +507,114 @@ void LevelSet::grid2World( int i, int j, int k, float& x, float& y, float& z ) c
 
 float LevelSet::diffXmWENO( int i, int j, int k ) const
 	{
+	// Read the six grid values the five one sided differentials need
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float phi[6];
+	for (int n = 0; n < 6; n++)
+		phi[n] = c.getValue(n - 3, 0, 0);
+
 	//define variables for HJ ENO approximation
 	// ie. v1 = (D-)phi_i-2
-	float v1  = diffXm( i-2, j, k);
-	float v2  = diffXm( i-1, j, k);
-	float v3  = diffXm( i,   j, k);
-	float v4  = diffXm( i+1, j, k);
-	float v5  = diffXm( i+2, j, k);
+	float v1  = (phi[1] - phi[0]) / mDx;
+	float v2  = (phi[2] - phi[1]) / mDx;
+	float v3  = (phi[3] - phi[2]) / mDx;
+	float v4  = (phi[4] - phi[3]) / mDx;
+	float v5  = (phi[5] - phi[4]) / mDx;
 
 	return weno(v1, v2, v3, v4, v5);
 	}
 
 float LevelSet::diffXpWENO( int i, int j, int k ) const
 	{
+	// Read the six grid values the five one sided differentials need
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float phi[6];
+	for (int n = 0; n < 6; n++)
+		phi[n] = c.getValue(n - 2, 0, 0);
+
 	//define variables for HJ ENO approximation
-	// ie. v1 = (D-)phi_i-2
-	float v1  = diffXp( i-2, j, k);
-	float v2  = diffXp( i-1, j, k);
-	float v3  = diffXp( i,   j, k);
-	float v4  = diffXp( i+1, j, k);
-	float v5  = diffXp( i+2, j, k);
+	// ie. v1 = (D+)phi_i-2
+	float v1  = (phi[1] - phi[0]) / mDx;
+	float v2  = (phi[2] - phi[1]) / mDx;
+	float v3  = (phi[3] - phi[2]) / mDx;
+	float v4  = (phi[4] - phi[3]) / mDx;
+	float v5  = (phi[5] - phi[4]) / mDx;
 
 	return weno(v1, v2, v3, v4, v5);
 	}
 
 float LevelSet::diffYmWENO( int i, int j, int k ) const
 	{
+	// Read the six grid values the five one sided differentials need
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float phi[6];
+	for (int n = 0; n < 6; n++)
+		phi[n] = c.getValue(0, n - 3, 0);
+
 	//define variables for HJ ENO approximation
-	// ie. v1 = (D-)phi_i-2
-	float v1  = diffYm( i, j-2, k);
-	float v2  = diffYm( i, j-1, k);
-	float v3  = diffYm( i,  j,  k);
-	float v4  = diffYm( i, j+1, k);
-	float v5  = diffYm( i, j+2, k);
+	// ie. v1 = (D-)phi_j-2
+	float v1  = (phi[1] - phi[0]) / mDx;
+	float v2  = (phi[2] - phi[1]) / mDx;
+	float v3  = (phi[3] - phi[2]) / mDx;
+	float v4  = (phi[4] - phi[3]) / mDx;
+	float v5  = (phi[5] - phi[4]) / mDx;
 
 	return weno(v1, v2, v3, v4, v5);
 	}
 
 float LevelSet::diffYpWENO( int i, int j, int k ) const
 	{
+	// Read the six grid values the five one sided differentials need
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float phi[6];
+	for (int n = 0; n < 6; n++)
+		phi[n] = c.getValue(0, n - 2, 0);
+
 	//define variables for HJ ENO approximation
-	// ie. v1 = (D-)phi_i-2
-	float v1  = diffYp( i, j-2, k);
-	float v2  = diffYp( i, j-1, k);
-	float v3  = diffYp( i, j,   k);
-	float v4  = diffYp( i, j+1, k);
-	float v5  = diffYp( i, j+2, k);
+	// ie. v1 = (D+)phi_j-2
+	float v1  = (phi[1] - phi[0]) / mDx;
+	float v2  = (phi[2] - phi[1]) / mDx;
+	float v3  = (phi[3] - phi[2]) / mDx;
+	float v4  = (phi[4] - phi[3]) / mDx;
+	float v5  = (phi[5] - phi[4]) / mDx;
 
 	return weno(v1, v2, v3, v4, v5);
 	}
 
 float LevelSet::diffZmWENO( int i, int j, int k ) const
 	{
+	// Read the six grid values the five one sided differentials need
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float phi[6];
+	for (int n = 0; n < 6; n++)
+		phi[n] = c.getValue(0, 0, n - 3);
+
 	//define variables for HJ ENO approximation
-	// ie. v1 = (D-)phi_i-2
-	float v1  = diffZm( i, j, k-2);
-	float v2  = diffZm( i, j, k-1);
-	float v3  = diffZm( i, j, k  );
-	float v4  = diffZm( i, j, k+1);
-	float v5  = diffZm( i, j, k+2);
+	// ie. v1 = (D-)phi_k-2
+	float v1  = (phi[1] - phi[0]) / mDx;
+	float v2  = (phi[2] - phi[1]) / mDx;
+	float v3  = (phi[3] - phi[2]) / mDx;
+	float v4  = (phi[4] - phi[3]) / mDx;
+	float v5  = (phi[5] - phi[4]) / mDx;
 
 	return weno(v1, v2, v3, v4, v5);
 	}
 
 float LevelSet::diffZpWENO( int i, int j, int k ) const
 	{
+	// Read the six grid values the five one sided differentials need
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	float phi[6];
+	for (int n = 0; n < 6; n++)
+		phi[n] = c.getValue(0, 0, n - 2);
+
 	//define variables for HJ ENO approximation
-	// ie. v1 = (D-)phi_i-2
-	float v1  = diffZp( i, j, k-2);
-	float v2  = diffZp( i, j, k-1);
-	float v3  = diffZp( i, j, k  );
-	float v4  = diffZp( i, j, k+1);
-	float v5  = diffZp( i, j, k+2);
+	// ie. v1 = (D+)phi_k-2
+	float v1  = (phi[1] - phi[0]) / mDx;
+	float v2  = (phi[2] - phi[1]) / mDx;
+	float v3  = (phi[3] - phi[2]) / mDx;
+	float v4  = (phi[4] - phi[3]) / mDx;
+	float v5  = (phi[5] - phi[4]) / mDx;
 
 	return weno(v1, v2, v3, v4, v5);
 	}
@@ -460,43 +622,110 @@ float LevelSet::diffZpWENO( int i, int j, int k ) const
 
 
 
+void LevelSet::getDerivatives(int i, int j, int k, Derivatives & d, int flags) const
+	{
+	LevelSetGrid::Cursor c = mGrid.getCursor(i,j,k);
+	const float current = c.getValue();
+
+	if (flags & (FIRST_ORDER | SECOND_ORDER))
+		{
+		const float prevI = c.getValue(-1,0,0), nextI = c.getValue(1,0,0);
+		const float prevJ = c.getValue(0,-1,0), nextJ = c.getValue(0,1,0);
+		const float prevK = c.getValue(0,0,-1), nextK = c.getValue(0,0,1);
+
+		if (flags & FIRST_ORDER)
+			{
+			d.ddxm = (current - prevI) / mDx;
+			d.ddxp = (nextI - current) / mDx;
+			d.ddym = (current - prevJ) / mDx;
+			d.ddyp = (nextJ - current) / mDx;
+			d.ddzm = (current - prevK) / mDx;
+			d.ddzp = (nextK - current) / mDx;
+
+			d.ddxc = (nextI - prevI) / (2.0f*mDx);
+			d.ddyc = (nextJ - prevJ) / (2.0f*mDx);
+			d.ddzc = (nextK - prevK) / (2.0f*mDx);
+			}
+
+		if (flags & SECOND_ORDER)
+			{
+			d.ddx2 = (nextI - 2.0f*current + prevI) / (mDx*mDx);
+			d.ddy2 = (nextJ - 2.0f*current + prevJ) / (mDx*mDx);
+			d.ddz2 = (nextK - 2.0f*current + prevK) / (mDx*mDx);
+
+			d.ddxy = (c.getValue(1,1,0) - c.getValue(1,-1,0) + c.getValue(-1,-1,0) - c.getValue(-1,1,0)) / (4.0f*mDx*mDx);
+			d.ddyz = (c.getValue(0,1,1) - c.getValue(0,1,-1) + c.getValue(0,-1,-1) - c.getValue(0,-1,1)) / (4.0f*mDx*mDx);
+			d.ddzx = (c.getValue(1,0,1) - c.getValue(-1,0,1) + c.getValue(-1,0,-1) - c.getValue(1,0,-1)) / (4.0f*mDx*mDx);
+			}
+		}
+
+	if (flags & WENO)
+		{
+		// One sided differentials between the grid points at offsets -3..3,
+		// the negative WENO differential uses the first five, the positive the last five
+		float phi[7], v[6];
+
+		for (int n = 0; n < 7; n++)  phi[n] = c.getValue(n-3, 0, 0);
+		for (int n = 0; n < 6; n++)  v[n] = (phi[n+1] - phi[n]) / mDx;
+		d.ddxmWENO = weno(v[0], v[1], v[2], v[3], v[4]);
+		d.ddxpWENO = weno(v[1], v[2], v[3], v[4], v[5]);
+
+		for (int n = 0; n < 7; n++)  phi[n] = c.getValue(0, n-3, 0);
+		for (int n = 0; n < 6; n++)  v[n] = (phi[n+1] - phi[n]) / mDx;
+		d.ddymWENO = weno(v[0], v[1], v[2], v[3], v[4]);
+		d.ddypWENO = weno(v[1], v[2], v[3], v[4], v[5]);
+
+		for (int n = 0; n < 7; n++)  phi[n] = c.getValue(0, 0, n-3);
+		for (int n = 0; n < 6; n++)  v[n] = (phi[n+1] - phi[n]) / mDx;
+		d.ddzmWENO = weno(v[0], v[1], v[2], v[3], v[4]);
+		d.ddzpWENO = weno(v[1], v[2], v[3], v[4], v[5]);
+		}
+	}
+
+
+void LevelSet::getDerivatives(const int * i, const int * j, const int * k, int count, Derivatives * d, int flags) const
+	{
+	const int otherFlags = flags & ~WENO;
+	if (otherFlags != 0)
+		for (int n = 0; n < count; n++)
+			getDerivatives(i[n], j[n], k[n], d[n], otherFlags);
+
+	if (!(flags & WENO))
+		return;
+
+	// Gather the one sided differences along each axis for the whole batch,
+	// v[axis][m][n] is the difference between offsets m-3 and m-2 at grid point n
+	static const int axes[3][3] = { {1,0,0}, {0,1,0}, {0,0,1} };
+	float v[3][6][LevelSetKernels::BATCH_SIZE];
+	for (int n = 0; n < count; n++)
+		{
+		LevelSetGrid::Cursor c = mGrid.getCursor(i[n], j[n], k[n]);
+		for (int a = 0; a < 3; a++)
+			{
+			float phi[7];
+			for (int m = 0; m < 7; m++)  phi[m] = c.getValue((m-3)*axes[a][0], (m-3)*axes[a][1], (m-3)*axes[a][2]);
+			for (int m = 0; m < 6; m++)  v[a][m][n] = (phi[m+1] - phi[m]) / mDx;
+			}
+		}
+
+	// The negative WENO differential uses the first five differences, the positive the last five
+	float ddm[3][LevelSetKernels::BATCH_SIZE], ddp[3][LevelSetKernels::BATCH_SIZE];
+	for (int a = 0; a < 3; a++)
+		{
+		LevelSetKernels::weno(v[a][0], v[a][1], v[a][2], v[a][3], v[a][4], ddm[a], count);
+		LevelSetKernels::weno(v[a][1], v[a][2], v[a][3], v[a][4], v[a][5], ddp[a], count);
+		}
+
+	for (int n = 0; n < count; n++)
+		{
+		d[n].ddxmWENO = ddm[0][n];  d[n].ddxpWENO = ddp[0][n];
+		d[n].ddymWENO = ddm[1][n];  d[n].ddypWENO = ddp[1][n];
+		d[n].ddzmWENO = ddm[2][n];  d[n].ddzpWENO = ddp[2][n];
+		}
+	}
+
+
 float LevelSet::weno( const float& v1, const float& v2, const float& v3, const float& v4, const float& v5 ) const
 	{
-	//float maxV = std::max( std::max( std::max( std::max(v1, v2), v3 ),v4 ),v5 );
-	//float epsilon = ((1e-6)* maxV*maxV) + (1e-99); //1e-99 to avoid div by 0
-	float maxV = std::max( std::max( std::max( std::max(v1*v1, v2*v2), v3*v3 ),v4*v4 ),v5*v5 );
-	float epsilon = ((1e-6)* maxV) + (1e-99); //1e-99 to avoid div by 0
-
-	//Possible HJ ENO approximations
-	float phi1 =  oneByThree * v1 - sevenBySix * v2 + elevenBySix * v3;
-	float phi2 = -oneBySix   * v2 + fiveBySix  * v3 + oneByThree  * v4;
-	float phi3 =  oneByThree * v3 + fiveBySix  * v4 - oneBySix    * v5;
-
-	//Approximate Stencil Smoothness
-	float term1 = (v1 - 2.0f * v2 + v3 );
-	float term2 = (v1 - 4.0f * v2 + 3.0f * v3);
-	float S1 = thirteenByTwelve * (  term1*term1 ) + oneByFour * (term2 * term2); 
-	term1 = (v2 - 2.0f*v3 + v4);
-	term2 = (v2-v4);
-	float S2 = thirteenByTwelve * (  term1*term1 ) + oneByFour * (term2 * term2); 
-	term1 = (v3 - 2.0f*v4 + v5);
-	term2 = (3.0f*v3 - 4.0f*v4 +v5);
-	float S3 = thirteenByTwelve * (  term1*term1 ) + oneByFour * (term2 * term2); 
-
-	//Calculate alphas with smoothness
-	S1 += epsilon;
-	float alpha1 = 0.1f / (S1*S1);
-	S2 += epsilon;
-	float alpha2 = 0.6f / (S2*S2);
-	S3 += epsilon;
-	float alpha3 = 0.3f / (S3*S3);
-
-	//calculate weights with alphas
-	float denominator( 1.0f /(alpha1 + alpha2 + alpha3) );
-	float w1 = alpha1 * denominator;
-	float w2 = alpha2 * denominator;
-	float w3 = alpha3 * denominator;
-
-	//return the weighted ENO
-	return ( w1*phi1 + w2*phi2 + w3*phi3 );
+	return LevelSetKernels::weno(v1, v2, v3, v4, v5);
 	}
@@ -14,6 +14,8 @@
 
 #include "Implicit.h"
 #include "LevelSetGrid.h"
+#include "LevelSetKernels.h"
+#include "BlockMarchingCubes.h"
 #include <iostream>
 
 class LevelSet : public Implicit
@@ -29,11 +31,31 @@ class LevelSet : public Implicit
 		float beta;
 		float gamma;
 
+		//! Triangles of the interface per block, see triangulateIncremental()
+		BlockMarchingCubes mBlockMesh;
+
+		/*!
+		 * Samples impl at every grid point, block by block across threads, with
+		 * impl compiled into an ImplicitProgram that evaluates a block at once. If
+		 * bandWidth is positive the narrow band width is set first and impl is
+		 * sampled at the block corners. Blocks whose corners are all further than
+		 * the band constants plus maxGradient times half the block diagonal from the
+		 * interface are set to the inside or outside constant without sampling them.
+		 */
+		void sample(const Implicit & impl, float bandWidth = 0, float maxGradient = 1);
+
 	public :
 		LevelSet(float dx);
 		LevelSet(float dx, const Implicit & impl);
 		LevelSet(float dx, const Implicit & impl, const Bbox & box);
 
+		/*!
+		 * Samples impl only in the blocks near the interface and sets the narrow band
+		 * width, blocks far away are filled with the band constants. This needs a
+		 * bound on the gradient of impl, which is 1 for a signed distance function.
+		 */
+		LevelSet(float dx, const Implicit & impl, float bandWidth, float maxGradient = 1);
+
 		virtual ~LevelSet() { }
 
 		virtual void draw();
@@ -53,6 +75,18 @@ class LevelSet : public Implicit
 
 		virtual void setNarrowBandWidth(float width);
 
+		/*!
+		 * Triangulates the zero level set with one marching cubes cell per grid
+		 * cell. The triangles are kept per block of the grid, and each call only
+		 * re-extracts the blocks next to a block whose values changed since the
+		 * previous call, see BlockMarchingCubes, so after a step of an operator
+		 * the cost follows the part of the interface that moved. If normals is
+		 * set the vertices get the normalized gradient as their normals. The
+		 * other extractors of setExtractor() need the cells around every block,
+		 * so with those this is triangulate().
+		 */
+		template <class MeshType> void triangulateIncremental(bool normals = false);
+
 		inline const float getDx() const { return mDx; }
 
 		//! First order negative differential in x
@@ -106,6 +140,47 @@ class LevelSet : public Implicit
 
 		inline float weno(const float& v1, const float& v2, const float& v3, const float& v4, const float& v5 ) const;
 
+		//! Differentials at a grid point, filled in by getDerivatives()
+		struct Derivatives
+			{
+			//! First order one sided differentials
+			float ddxm, ddxp, ddym, ddyp, ddzm, ddzp;
+			//! Second order central differentials
+			float ddxc, ddyc, ddzc;
+			//! Second order second differentials
+			float ddx2, ddy2, ddz2;
+			//! Mixed differentials in x,y  y,z and z,x
+			float ddxy, ddyz, ddzx;
+			//! WENO one sided differentials
+			float ddxmWENO, ddxpWENO, ddymWENO, ddypWENO, ddzmWENO, ddzpWENO;
+			};
+
+		//! Selects the differentials computed by getDerivatives()
+		enum DerivativeFlags
+			{
+			//! One sided and central differentials, 7 point stencil
+			FIRST_ORDER = 1,
+			//! Second and mixed differentials, 19 point stencil
+			SECOND_ORDER = 2,
+			//! WENO differentials, three grid points in each direction
+			WENO = 4
+			};
+
+		/*!
+		 * Computes the differentials selected by flags at grid point (i,j,k). The
+		 * stencil is read once, so this is much cheaper than calling the diff
+		 * functions one by one. The results are identical to the diff functions.
+		 */
+		void getDerivatives(int i, int j, int k, Derivatives & d, int flags = FIRST_ORDER) const;
+
+		/*!
+		 * Computes the differentials selected by flags at count grid points, at most
+		 * LevelSetKernels::BATCH_SIZE. The WENO differentials of all grid points are
+		 * computed together by the SIMD kernels, the results are identical to the
+		 * single grid point version.
+		 */
+		void getDerivatives(const int * i, const int * j, const int * k, int count, Derivatives * d, int flags = FIRST_ORDER) const;
+
 		friend std::ostream& operator << (std::ostream &os, const LevelSet &LS)
 			{
 			os << "Level set bounding box: " << LS.mBox.pMin << " -> " << LS.mBox.pMax << std::endl;
@@ -117,4 +192,33 @@ class LevelSet : public Implicit
 	};
 
 
+template <class MeshType>
+void LevelSet::triangulateIncremental(bool normals)
+	{
+	if (getExtractor() != MARCHING_CUBES)
+		{
+		triangulate<MeshType>(mDx, 0, normals);
+		return;
+		}
+
+	// From grid to world coordinates, like VolumeLevelSet::triangulate()
+	const Bbox b = getBoundingBox();
+	const GradientField gradientField(*this, mDx, b.pMin);
+
+	const int extracted = mBlockMesh.update(mGrid, normals ? &gradientField : NULL);
+	std::cerr << "Triangulating (incremental) [" << extracted << "/" << mBlockMesh.getNumBlocks() << " blocks]";
+
+	IndexedMesh indexed;
+	mBlockMesh.getMesh(indexed);
+	for (unsigned int n = 0; n < indexed.mVerts.size(); n++)
+		indexed.mVerts[n] = indexed.mVerts[n]*mDx + b.pMin;
+
+	delete mMesh;
+	mMesh = new MeshType();
+	mMesh->buildFromIndexed(indexed.mVerts, indexed.mIndices);
+	if (normals)
+		mMesh->setVertexNormals(indexed.mNormals);
+	std::cerr << " done: " << indexed.mIndices.size()/3 << std::endl;
+	}
+
 #endif
@@ -20,6 +20,24 @@ bool LoopSubdivisionMesh::subdivide()
 	HalfEdgeMesh subDivMesh;
 	subDivMesh.setTransform(getTransform());
 
+	// The new vertices are indexed directly, instead of being welded by their
+	// positions: the old vertices keep their indices, and each edge gets one
+	// vertex, shared by its two half-edges
+	std::vector<Vector3<float> > verts;
+	std::vector<unsigned int> edgeVerts(mEdgeSize, UNINITIALIZED);
+	std::vector<unsigned int> indices;
+	verts.reserve(mVertSize + mEdgeSize/2);
+	indices.reserve(12*mFaceSize);
+
+	// Compute positions of the old vertices
+	for (int v = 0; v < mVertSize; v++)
+		{
+		if (mVerts[v].edge == UNINITIALIZED)
+			verts.push_back(mVertPositions[v]);
+		else
+			verts.push_back(computeVertex(mVerts[v].edge));
+		}
+
 	std::vector<HalfEdgeMesh::Face>::const_iterator it = mFaces.begin();
 	std::vector<HalfEdgeMesh::Face>::const_iterator iend = mFaces.end();
 
@@ -28,29 +46,31 @@ bool LoopSubdivisionMesh::subdivide()
 		{
 
 		// get the inner halfedges
-		unsigned int e0, e1, e2;
-		e0 = (*it).edge;
-		e1 = mEdges[(*it).edge].next;
-		e2 = mEdges[(*it).edge].prev;
-
-		// Compute positions of the old vertices
-		Vector3<float> pn0 = computeVertex(e0);
-		Vector3<float> pn1 = computeVertex(e1);
-		Vector3<float> pn2 = computeVertex(e2);
-
-		// Compute positions of the new vertices on the edge
-		Vector3<float> pn3 = computeEdgeVertex(e0);
-		Vector3<float> pn4 = computeEdgeVertex(e1);
-		Vector3<float> pn5 = computeEdgeVertex(e2);
+		unsigned int e[3];
+		e[0] = (*it).edge;
+		e[1] = mEdges[(*it).edge].next;
+		e[2] = prev((*it).edge);
+
+		// Compute positions of the new vertices on the edge, once per edge
+		for (int i = 0; i < 3; i++)
+			{
+			if (edgeVerts[e[i]] == UNINITIALIZED)
+				{
+				edgeVerts[e[i]] = edgeVerts[pair(e[i])] = verts.size();
+				verts.push_back(computeEdgeVertex(e[i]));
+				}
+			}
+
+		const unsigned int pn0 = mEdges[e[0]].vert, pn1 = mEdges[e[1]].vert, pn2 = mEdges[e[2]].vert;
+		const unsigned int pn3 = edgeVerts[e[0]], pn4 = edgeVerts[e[1]], pn5 = edgeVerts[e[2]];
 
 		// add the four new triangles to new mesh
-		subDivMesh.addTriangle(pn0, pn3, pn5);
-		subDivMesh.addTriangle(pn3, pn4, pn5);
-		subDivMesh.addTriangle(pn3, pn1, pn4);
-		subDivMesh.addTriangle(pn5, pn4, pn2);
+		const unsigned int triangles[12] = { pn0, pn3, pn5,  pn3, pn4, pn5,  pn3, pn1, pn4,  pn5, pn4, pn2 };
+		indices.insert(indices.end(), triangles, triangles + 12);
 
 		++it;
 		}
+	subDivMesh.buildFromIndexed(verts, indices);
 	// Assigns the new mesh
 	*this = LoopSubdivisionMesh(subDivMesh, ++mNumSubDivs);
 
@@ -73,11 +93,11 @@ Vector3<float> LoopSubdivisionMesh::computeVertex(unsigned int edgeIndex)
 	Vector3<float> newVertex;
 	for(int i=0; i<k; i++)
 		{
-		newVertex += (mVerts[ foundVerts[i] ].vec * b);
+		newVertex += (mVertPositions[ foundVerts[i] ] * b);
 		}
 	
 	// Get the current vertex
-	Vector3<float> v = mVerts.at( vertIndex ).vec;
+	Vector3<float> v = mVertPositions.at( vertIndex );
 	newVertex += ( v * (1.0f-k*b) );
 
 	return newVertex;
@@ -90,21 +110,21 @@ Vector3<float> LoopSubdivisionMesh::computeEdgeVertex(unsigned int edgeIndex)
 	{
 	//connecting edge
 	HalfEdge& e0 = mEdges[edgeIndex];
-	HalfEdge& e1 = mEdges[e0.pair];
+	HalfEdge& e1 = mEdges[pair(edgeIndex)];
 
 	//Opposite vertices' edges
-	HalfEdge& e2 = mEdges[e0.prev];
-	HalfEdge& e3 = mEdges[e1.prev];
+	HalfEdge& e2 = mEdges[prev(edgeIndex)];
+	HalfEdge& e3 = mEdges[prev(pair(edgeIndex))];
 
 	//Scale the effects of the vertices
 	static const float threeByEight = 3.0f/8.0f;
 	static const float oneByEight   = 1.0f/8.0f;
 
-	Vector3<float> v_connecting0 = mVerts.at(e0.vert).vec;
-	Vector3<float> v_connecting1 = mVerts.at(e1.vert).vec;
+	Vector3<float> v_connecting0 = mVertPositions.at(e0.vert);
+	Vector3<float> v_connecting1 = mVertPositions.at(e1.vert);
 
-	Vector3<float> v_opposite0 = mVerts.at(e2.vert).vec;
-	Vector3<float> v_opposite1 = mVerts.at(e3.vert).vec;
+	Vector3<float> v_opposite0 = mVertPositions.at(e2.vert);
+	Vector3<float> v_opposite1 = mVertPositions.at(e3.vert);
 
 	//NOTE: better to do multiplication here, to prevent _weird_ rounding errors :)
 	return ( (v_connecting0 +v_connecting1)*threeByEight + (v_opposite0 + v_opposite1)*oneByEight );
@@ -122,16 +142,16 @@ bool LoopSubdivisionMesh::findNeighbourVerts(const unsigned int vertexIndex, std
 
 	//go to the previous so we can always proceed in the same way in the loop
 
-	unsigned int prev;
-	unsigned int pair = edge;
+	unsigned int incoming;
+	unsigned int outgoing = edge;
 	
 	do
 		{
-		prev = mEdges[pair].prev;
-		foundVerts.push_back( mEdges[prev].vert );
-		pair = mEdges[prev].pair;
+		incoming = prev(outgoing);
+		foundVerts.push_back( mEdges[incoming].vert );
+		outgoing = pair(incoming);
 		} 
-		while ( pair != edge );	
+		while ( outgoing != edge );	
 
 	return !(foundVerts.size() == 0);
 	}
@@ -19,6 +19,12 @@ float Mesh::triArea(const Vector3<float> & v1, const Vector3<float> & v2, const
   return .5*(cross(e1, e2).length());
 }
 
+void Mesh::buildFromIndexed(const std::vector<Vector3<float> > & verts, const std::vector<unsigned int> & indices)
+{
+  for (unsigned int n = 0; n + 2 < indices.size(); n += 3)
+    addTriangle(verts[indices[n]], verts[indices[n+1]], verts[indices[n+2]]);
+}
+
 float Mesh::area() const
 {
 	std::cerr << "Error: area() not implemented for this Mesh" << std::endl;
@@ -47,6 +53,11 @@ void Mesh::calculateVertexNormals()
 	std::cerr << "Error: calculateVertexNormals() not implemented for this Mesh" << std::endl;
 }
 
+void Mesh::setVertexNormals(const std::vector<Vector3<float> > & normals)
+{
+	std::cerr << "Error: setVertexNormals() not implemented for this Mesh" << std::endl;
+}
+
 void Mesh::setShadingFlag(Mesh::SHADING s)
 {
   mShadingFlag = s;
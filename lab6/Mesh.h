@@ -36,6 +36,15 @@ public:
   //! Adds a triangle to the mesh. \sa addTriangle
   virtual bool addTriangle(const Vector3<float> &v1, const Vector3<float> &v2, const Vector3<float> & v3) = 0;
 
+  /*!
+   * Builds an empty mesh from the triangles indices[3n], indices[3n+1],
+   * indices[3n+2] into verts, counter clockwise, see MarchingCubes. The
+   * default adds them through addTriangle(). SimpleMesh and HalfEdgeMesh take
+   * the indices as they are, without looking up the positions, so the vertices
+   * must be unique and are not welded with those of later addTriangle() calls.
+   */
+  virtual void buildFromIndexed(const std::vector<Vector3<float> > & verts, const std::vector<unsigned int> & indices);
+
   //! Compute area of mesh
   virtual float area() const;
   //! Compute volume of mesh
@@ -51,6 +60,11 @@ public:
   //! Methods for calculating normals
   virtual void calculateFaceNormals();
   virtual void calculateVertexNormals();
+  /*!
+   * Sets the normals of the vertices, in the order of the verts given to
+   * buildFromIndexed(), instead of calculating them from the triangles
+   */
+  virtual void setVertexNormals(const std::vector<Vector3<float> > & normals);
 
   //! Draw call
   virtual void draw() = 0;
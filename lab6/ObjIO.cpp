@@ -15,6 +15,7 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <limits>
 
 bool ObjIO::load(Mesh *mesh, std::istream & is){
 	// std::cerr << "Reading obj file.\nOutputting any skipped line(s) for reference.\n";
@@ -24,17 +25,40 @@ bool ObjIO::load(Mesh *mesh, std::istream & is){
 	success = readData(is);
 	if(!success) { return false; }
 
-	// Build mesh
+	// Vertices at the same position are welded, as adding the triangles one
+	// by one would. Sorting them finds the duplicates without a lookup per corner
+	const unsigned int numVerts = loadData.verts.size();
+	std::vector<unsigned int> order(numVerts);
+	for (unsigned int v = 0; v < numVerts; v++)
+		order[v] = v;
+	std::sort(order.begin(), order.end(), VertexLess(loadData.verts));
+
+	std::vector<unsigned int> welded(numVerts);
+	for (unsigned int n = 0; n < numVerts; n++){
+		const bool duplicate = n > 0 && !(loadData.verts[order[n-1]] < loadData.verts[order[n]]);
+		welded[order[n]] = duplicate ? welded[order[n-1]] : order[n];
+	}
+
+	// Build mesh, with the vertices in the order of first use
 	const unsigned int numTris = loadData.tris.size();
+	const unsigned int unused = std::numeric_limits<unsigned int>::max();
+	std::vector<unsigned int> remap(numVerts, unused);
+	std::vector<Vector3<float> > verts;
+	std::vector<unsigned int> indices;
+	indices.reserve(3*numTris);
 	for (unsigned int t = 0; t < numTris; t++){
 		Vector3<unsigned int>& triangle = loadData.tris[t];
-
-		Vector3<float>& v0 = loadData.verts[triangle[0]];
-		Vector3<float>& v1 = loadData.verts[triangle[1]];
-		Vector3<float>& v2 = loadData.verts[triangle[2]];
-
-		mesh->addTriangle(v0,v1,v2);
+		for (unsigned int c = 0; c < 3; c++){
+			const unsigned int v = welded[triangle[c]];
+			if (remap[v] == unused){
+				remap[v] = verts.size();
+				verts.push_back(loadData.verts[triangle[c]]);
+			}
+			indices.push_back(remap[v]);
+		}
 	}
+
+	mesh->buildFromIndexed(verts, indices);
 	return true;
 }
 
@@ -143,3 +167,20 @@ void ObjIO::splitQuad(std::istream &is, Vector3<unsigned int>& tri1, Vector3<uns
 }
 
 
+bool ObjIO::saveIndexed(IndexedMesh & mesh, std::ostream & os){
+	// Enough digits that the vertices read back are the ones written
+	std::streamsize precision = os.precision(9);
+	for (unsigned int v = 0; v < mesh.mVerts.size(); v++)
+		os << "v " << mesh.mVerts[v][0] << " " << mesh.mVerts[v][1] << " " << mesh.mVerts[v][2] << "\n";
+
+	// obj file format is 1-based, the triangles may use vertices written earlier
+	for (unsigned int n = 0; n < mesh.mIndices.size(); n += 3)
+		os << "f " << mesh.mIndices[n]+1 << " " << mesh.mIndices[n+1]+1 << " " << mesh.mIndices[n+2]+1 << "\n";
+
+	mesh.mFirstVert += mesh.mVerts.size();
+	mesh.mVerts.clear();
+	mesh.mIndices.clear();
+	mesh.mNormals.clear();
+	os.precision(precision);
+	return os.good();
+}
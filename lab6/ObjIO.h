@@ -13,6 +13,7 @@
 #define __obj_io_h__
 
 #include "Mesh.h"
+#include "MarchingCubes.h"
 #include "Vector3.h"
 #include <string>
 #include <iostream>
@@ -26,6 +27,15 @@ public:
   bool load(Mesh *, std::istream & is); // false return on error
   bool save(Mesh *, std::ostream & os); // false return on error
 
+  /*!
+   * Appends the vertices and triangles of mesh to os and removes them from
+   * mesh, advancing mesh.mFirstVert so the vertices added later keep their
+   * numbering. Called after every slab of a marching cubes extraction the
+   * file is written without the whole mesh in memory, see
+   * Implicit::streamTriangulation(). False return on error.
+   */
+  bool saveIndexed(IndexedMesh & mesh, std::ostream & os);
+
 protected:
   bool readHeader(std::istream &is);
   bool readData(std::istream &is);
@@ -33,6 +43,13 @@ protected:
   static Vector3<unsigned int> readTri(std::istream &is);
   static void splitQuad(std::istream &is, Vector3<unsigned int>& tri1, Vector3<unsigned int>& tri2);
 
+  //! Orders the indices of vertices by the positions of the vertices
+  struct VertexLess{
+    VertexLess(const std::vector<Vector3<float> > & verts) : verts(verts) {}
+    bool operator()(unsigned int v1, unsigned int v2) const { return verts[v1] < verts[v2]; }
+    const std::vector<Vector3<float> > & verts;
+  };
+
   struct LoadData{
     std::vector<Vector3<float> > verts;
     std::vector<Vector3<unsigned int> > tris;
@@ -30,9 +30,36 @@ class OperatorAdvect : public LevelSetOperator
 	protected :
 		Function3D<Vector3<float> > * mVectorField;
 
+		//! Computes dphi/dt = -V . grad phi over the narrow band, with upwind differentials
+		virtual void computeRate(std::vector<float> & rate)
+			{
+			// Iterate over the narrow band in batches, each thread fills its own contiguous slice of rate
+			const int numBatches = getNumBatches();
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+			for (int b = 0; b < numBatches; b++) 
+				{
+				int i[BATCH_SIZE], j[BATCH_SIZE], k[BATCH_SIZE];
+				const int count = getNarrowBandBatch(b, i, j, k);
+
+				// The WENO differentials of the whole batch are computed by the SIMD kernels
+				LevelSet::Derivatives d[BATCH_SIZE];
+				mLS->getDerivatives(i, j, k, count, d, mUseWENO ? LevelSet::WENO : LevelSet::FIRST_ORDER);
+
+				for (int n = 0; n < count; n++)
+					{
+					// Get vector for grid point (i,j,k) from vector field
+					// Remember to translate (i,j,k) into world coordinates (x,y,z)
+					//float x,y,z;
+					//this->mLS->grid2World(i,j,k, x,y,z);
+					Vector3<float> v = mVectorField->getValue( i[n],j[n],k[n] );
+
+					rate[b*BATCH_SIZE + n] = - gradient(v, d[n], mUseWENO) * v;
+					}
+				}
+			}
+
 	private :
 		bool mUseWENO;
-		bool mUseRungeKutta;
 
 	public :
 
@@ -40,35 +67,32 @@ class OperatorAdvect : public LevelSetOperator
 			: LevelSetOperator(LS)
 			, mVectorField(vf) 
 			, mUseWENO(false)
-			, mUseRungeKutta(false)
 			{ }
 
 		OperatorAdvect(LevelSet * LS, Function3D<Vector3<float> > * vf, bool aUseWENO) 
 			: LevelSetOperator(LS)
 			, mVectorField(vf) 
 			, mUseWENO(aUseWENO)
-			, mUseRungeKutta(false)
 			{ }
 
+		//! aRungeKutta selects the TVD-RK3 integrator, see also setIntegrator()
 		OperatorAdvect(LevelSet * LS, Function3D<Vector3<float> > * vf, bool aUseWENO, bool aRungeKutta) 
 			: LevelSetOperator(LS)
 			, mVectorField(vf) 
 			, mUseWENO(aUseWENO)
-			, mUseRungeKutta(aRungeKutta)
-			{ }
+			{
+			if (aRungeKutta)
+				setIntegrator(TVD_RK3);
+			}
 
 		virtual void propagate(float time)
 			{
-			// Create buffer used to store intermediate results
-			std::vector<float> buffer;
-
-			// Determine timestep for stability
+			// Determine timestep for stability, the TVD integrators share the limit of forward Euler
 			Vector3<float> v = mVectorField->getMaxValue();
 			float delta = mLS->getDx();
 			float x = delta / abs( v.x() ); 
 			float y = delta / abs( v.y() );
 			float z = delta / abs( v.z() );
-			float alpha = 0.9f;
 			float dt =  std::min( x, std::min( y, z ) );
 
 			// Propagate level set with stable timestep dt
@@ -79,127 +103,11 @@ class OperatorAdvect : public LevelSetOperator
 					dt = time-elapsed;
 				elapsed += dt;
 
-				//////////////////////////////////////////////////////////////////////////
-				// EULER (first order)
-				//////////////////////////////////////////////////////////////////////////
-				if(!mUseRungeKutta)
-					{
-					nextPhiEuler(dt, buffer );
-					updateGridValues( buffer.begin() );
-					buffer.clear();
-					}
-
-				//////////////////////////////////////////////////////////////////////////
-				// RUNGE KUTTA
-				//////////////////////////////////////////////////////////////////////////
-				else
-					{
-					printf("RungeKutta");
-					//store PHI N
-					std::vector<float> bufferPhiN;
-					LevelSetGrid::Iterator iter = getGrid().beginNarrowBand();
-					LevelSetGrid::Iterator iend = getGrid().endNarrowBand();
-					while (iter != iend) 
-						{
-						unsigned int i = iter.getI();
-						unsigned int j = iter.getJ();
-						unsigned int k = iter.getK();
-
-						//store phiN
-						bufferPhiN.push_back( getGrid().getValue( i,j,k ) );
-						iter++;
-						}
-
-					printf(".");
-					//PHI N+1
-					//-----------
-					nextPhiEuler(dt, buffer );
-					updateGridValues( buffer.begin() );
-					buffer.clear();
-
-					printf(".");
-					//PHI N+2
-					//-----------
-					nextPhiEuler(dt, buffer );
-
-					printf(".");
-					//PHI N+(1/2)
-					//-----------
-					for( int i=0, endI=buffer.size(); i<endI; i++ )
-						{
-						buffer[i] = ( 0.75f * bufferPhiN[i] + 0.25f * buffer[i] );
-						}
-					updateGridValues( buffer.begin() );
-					buffer.clear();
-
-					printf(".");
-					//PHI N+(3/2)
-					//-----------
-					nextPhiEuler(dt, buffer );
-
-					printf(".");
-					//FINAL: PHI N+1
-					//-----------
-					for( int i=0, endI=buffer.size(); i<endI; i++ )
-						{
-						buffer[i] = ( (1.0f/3.0f) * bufferPhiN[i] + (2.0f/3.0f) * buffer[i] );
-						}
-					updateGridValues( buffer.begin() );
-					buffer.clear();
-					printf("\n");
-					}
+				integrate(dt);
 
 				std::cerr << elapsed << std::endl;
 				}
 			}
-
-		void nextPhiEuler( float dt, std::vector<float>& buffer  )
-			{
-			Vector3<float> v;
-
-			// Iterate over grid and compute the grid values for the next timestep
-			LevelSetGrid::Iterator iter = getGrid().beginNarrowBand();
-			LevelSetGrid::Iterator iend = getGrid().endNarrowBand();
-
-			while (iter != iend) 
-				{
-				int i = iter.getI();
-				int j = iter.getJ();
-				int k = iter.getK();
-
-				// Get vector for grid point (i,j,k) from vector field
-				// Remember to translate (i,j,k) into world coordinates (x,y,z)
-				//float x,y,z;
-				//this->mLS->grid2World(i,j,k, x,y,z);
-				v = mVectorField->getValue( i,j,k );
-
-				//getGrid().getValue(i, j, k);
-				float velocity = - gradient(v, i,j,k, mUseWENO) * v;
-				float phiNext  = forwardEuler( i,j,k, velocity, dt );
-
-				// assign new value and store it in the buffer
-				buffer.push_back( phiNext );
-				iter++;
-				}
-			}
-
-		void updateGridValues(std::vector<float>::iterator bufferStart )
-			{
-			// Copy new values from buffer to grid
-			LevelSetGrid::Iterator iter = getGrid().beginNarrowBand();
-			LevelSetGrid::Iterator iend = getGrid().endNarrowBand();
-
-			while (iter != iend) 
-				{
-				unsigned int i = iter.getI();
-				unsigned int j = iter.getJ();
-				unsigned int k = iter.getK();
-
-				getGrid().setValue(i,j,k, (*bufferStart));
-				iter++;
-				bufferStart++;
-				}
-			}
 	};
 
 #endif
@@ -0,0 +1,187 @@
+/*************************************************************************************************
+*
+* Modeling and animation (TNM079) 2007
+* Code base for lab assignments. Copyright:
+*   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+*   Ken Museth (ken.museth@itn.liu.se)
+*   Michael Bang Nielsen (bang@daimi.au.dk)
+*   Ola Nilsson (ola.nilsson@itn.liu.se)
+*   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+*
+*************************************************************************************************/
+#ifndef __operatoradvectsemilagrangian_h__
+#define __operatoradvectsemilagrangian_h__
+
+#include "LevelSetOperator.h"
+#include "Function3D.h"
+#include <cmath>
+#include <algorithm>
+
+
+/*! \brief A level set operator that does external advection with a semi-Lagrangian scheme
+*
+* Instead of discretizing
+*
+*  \f$
+*  \dfrac{\partial \phi}{\partial t} + \mathbf{V}(\mathbf{x})\cdot \nabla \phi = 0
+*  \f$
+*
+* with upwind differences, as OperatorAdvect does, the value at each grid point
+* is taken from the point it came from: the grid point is traced backwards through
+* the vector field with a second order (midpoint) step, and phi is interpolated at
+* the departure point, trilinearly or with a monotone tricubic.
+*
+* The scheme is stable for any time step, so the CFL number, the number of grid
+* cells the interface may move per step, can be set well above 1. The narrow band
+* is dilated before each step so the interface stays inside it.
+*/
+class OperatorAdvectSemiLagrangian : public LevelSetOperator
+	{
+	protected :
+		Function3D<Vector3<float> > * mVectorField;
+
+		//! Number of grid cells the interface may move in one step
+		float mCFL;
+		bool mUseTricubic;
+
+		//! Catmull-Rom interpolation between p1 and p2
+		static inline float cubic(float p0, float p1, float p2, float p3, float t)
+			{
+			return p1 + 0.5f*t*( (p2 - p0) + t*( (2*p0 - 5*p1 + 4*p2 - p3) + t*(3*(p1 - p2) + p3 - p0) ) );
+			}
+
+		//! Trilinear interpolation of phi at grid coordinates (x,y,z)
+		float sampleTrilinear(float x, float y, float z) const
+			{
+			const LevelSetGrid & grid = getGrid();
+			int i = (int)std::floor(x);
+			int j = (int)std::floor(y);
+			int k = (int)std::floor(z);
+
+			float bx = x - i;
+			float by = y - j;
+			float bz = z - k;
+
+			return (grid.getValue(i,   j,   k  ) * (1-bx) * (1-by) * (1-bz) +
+				grid.getValue(i+1, j,   k  ) *  bx    * (1-by) * (1-bz) +
+				grid.getValue(i+1, j+1, k  ) *  bx    *  by    * (1-bz) +
+				grid.getValue(i,   j+1, k  ) * (1-bx) *  by    * (1-bz) +
+				grid.getValue(i,   j,   k+1) * (1-bx) * (1-by) *  bz    +
+				grid.getValue(i+1, j,   k+1) *  bx    * (1-by) *  bz    +
+				grid.getValue(i+1, j+1, k+1) *  bx    *  by    *  bz    +
+				grid.getValue(i,   j+1, k+1) * (1-bx) *  by    *  bz);
+			}
+
+		/*!
+		 * Tricubic interpolation of phi at grid coordinates (x,y,z). The result is
+		 * clamped to the values of the enclosing grid cell, which keeps the scheme
+		 * monotone so no new extrema appear near the interface.
+		 */
+		float sampleTricubic(float x, float y, float z) const
+			{
+			const LevelSetGrid & grid = getGrid();
+			int i = (int)std::floor(x);
+			int j = (int)std::floor(y);
+			int k = (int)std::floor(z);
+
+			float bx = x - i;
+			float by = y - j;
+			float bz = z - k;
+
+			float zs[4];
+			for (int c = 0; c < 4; c++)
+				{
+				float ys[4];
+				for (int b = 0; b < 4; b++)
+					{
+					ys[b] = cubic(grid.getValue(i-1, j-1+b, k-1+c), grid.getValue(i, j-1+b, k-1+c),
+						grid.getValue(i+1, j-1+b, k-1+c), grid.getValue(i+2, j-1+b, k-1+c), bx);
+					}
+				zs[c] = cubic(ys[0], ys[1], ys[2], ys[3], by);
+				}
+			float val = cubic(zs[0], zs[1], zs[2], zs[3], bz);
+
+			float minVal = std::numeric_limits<float>::max();
+			float maxVal = -std::numeric_limits<float>::max();
+			for (int n = 0; n < 8; n++)
+				{
+				float corner = grid.getValue(i + (n & 1), j + ((n >> 1) & 1), k + (n >> 2));
+				minVal = std::min(minVal, corner);
+				maxVal = std::max(maxVal, corner);
+				}
+			return clamp(val, minVal, maxVal);
+			}
+
+	public :
+
+		OperatorAdvectSemiLagrangian(LevelSet * LS, Function3D<Vector3<float> > * vf, float cfl = 5.0f, bool useTricubic = false)
+			: LevelSetOperator(LS)
+			, mVectorField(vf)
+			, mCFL(cfl)
+			, mUseTricubic(useTricubic)
+			{ }
+
+		virtual void propagate(float time)
+			{
+			// Create buffer used to store intermediate results
+			std::vector<float> buffer;
+
+			// Determine timestep from the requested CFL number
+			Vector3<float> v = mVectorField->getMaxValue();
+			float dx = mLS->getDx();
+			float maxV = std::max( std::abs( v.x() ), std::max( std::abs( v.y() ), std::abs( v.z() ) ) );
+			float dt = maxV > 0 ? mCFL * dx / maxV : time;
+
+			// Propagate level set with timestep dt
+			// until requested time is reached
+			for (float elapsed = 0; elapsed < time;)
+				{
+				if (dt > time-elapsed)
+					dt = time-elapsed;
+				elapsed += dt;
+
+				// Dilation is 6-connected, so grow the band by the
+				// largest distance moved per step in the 1-norm
+				const int dilations = (int)std::ceil( dt * (std::abs( v.x() ) + std::abs( v.y() ) + std::abs( v.z() )) / dx );
+				for (int d = 0; d < dilations; d++)
+					getGrid().dilate();
+
+				// Trace each grid point in the narrow band backwards and sample phi
+				// at the departure point, each thread fills its own slice of the buffer
+				const int size = (int)getGrid().getNarrowBandSize();
+				buffer.resize(size);
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+				for (int n = 0; n < size; n++)
+					{
+					int i, j, k;
+					getGrid().getNarrowBandPoint(n, i, j, k);
+
+					// Midpoint step backwards through the field, in world coordinates
+					float x, y, z;
+					mLS->grid2World(i, j, k, x, y, z);
+					Vector3<float> v0 = mVectorField->getValue(i, j, k);
+					Vector3<float> vm = mVectorField->getValue(x - 0.5f*dt*v0.x(), y - 0.5f*dt*v0.y(), z - 0.5f*dt*v0.z());
+
+					// Departure point in grid coordinates
+					float px = i - dt*vm.x()/dx;
+					float py = j - dt*vm.y()/dx;
+					float pz = k - dt*vm.z()/dx;
+
+					buffer[n] = mUseTricubic ? sampleTricubic(px, py, pz) : sampleTrilinear(px, py, pz);
+					}
+
+				// Copy new values from buffer to grid
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+				for (int n = 0; n < size; n++)
+					getGrid().setNarrowBandValue(n, buffer[n]);
+
+				// Remove the grid points the interface did not reach. Far from
+				// the interface the samples are exactly the inside or outside
+				// constant, so those are culled too, or the band would keep
+				// every layer dilated above
+				getGrid().rebuild(true);
+				}
+			}
+	};
+
+#endif
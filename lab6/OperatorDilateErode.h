@@ -29,16 +29,39 @@ class OperatorDilateErode : public LevelSetOperator
 protected :
   float mA;
 
+  //! Computes dphi/dt = -F |grad phi| over the narrow band, with Godunov's upwind gradient
+  virtual void computeRate(std::vector<float> & rate)
+  {
+    // Iterate over the narrow band in batches, each thread fills its own contiguous slice of rate
+    const int numBatches = getNumBatches();
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+    for (int b = 0; b < numBatches; b++) {
+      int i[BATCH_SIZE], j[BATCH_SIZE], k[BATCH_SIZE];
+      const int count = getNarrowBandBatch(b, i, j, k);
+
+      LevelSet::Derivatives d[BATCH_SIZE];
+      mLS->getDerivatives(i, j, k, count, d, LevelSet::FIRST_ORDER);
+
+      float a[BATCH_SIZE], ddx2[BATCH_SIZE], ddy2[BATCH_SIZE], ddz2[BATCH_SIZE];
+      for (int n = 0; n < count; n++)
+        a[n] = mA;
+
+	  godunov(d, a, count, ddx2, ddy2, ddz2 );
+
+      for (int n = 0; n < count; n++) {
+		float gradientNorm = sqrt( ddx2[n] + ddy2[n] + ddz2[n] );
+		rate[b*BATCH_SIZE + n] = -mA * gradientNorm;
+      }
+    }
+  }
+
 public :
 
   OperatorDilateErode(LevelSet * LS, float a) : LevelSetOperator(LS), mA(a) { }
 
   virtual void propagate(float time)
   {
-    // Create buffer used to store intermediate results
-    std::vector<float> buffer;
-
-    // Determine timestep for stability
+    // Determine timestep for stability, the TVD integrators share the limit of forward Euler
 	float alpha = 0.9f;
     float dt = alpha * ( mLS->getDx() / abs( mA ) );
 
@@ -54,47 +77,8 @@ public :
         dt = time - elapsed;
       elapsed += dt;
 
-      // Iterate over grid and compute the grid values for the next timestep
-      LevelSetGrid::Iterator iter = getGrid().beginNarrowBand();
-      LevelSetGrid::Iterator iend = getGrid().endNarrowBand();
-      while (iter != iend) {
-        unsigned int i = iter.getI();
-        unsigned int j = iter.getJ();
-        unsigned int k = iter.getK();
-
-        float ddx2, ddy2, ddz2;
-
-        // Compute the new value and store it in the buffer
-		godunov(i, j, k, mA, ddx2, ddy2, ddz2 );
-
-		float gradientNorm = sqrt( ddx2 + ddy2 + ddz2 );
-		float dPhiDt = -mA * gradientNorm;
-
-		float x,y,z;
-
-		//EULER
-		float phiCurrent	= getGrid().getValue(i, j, k);
-		float phiNext		= phiCurrent + dPhiDt * dt;
-
-        buffer.push_back( phiNext );
-
-        iter++;
-      }
+      integrate(dt);
 	  printf("\n");
-
-      // Copy new values from buffer to grid
-      iter = getGrid().beginNarrowBand();
-      std::vector<float>::iterator iterBuffer = buffer.begin();
-      while (iter != iend) {
-        unsigned int i = iter.getI();
-        unsigned int j = iter.getJ();
-        unsigned int k = iter.getK();
-
-        getGrid().setValue(i,j,k, (*iterBuffer));
-        iter++;
-        iterBuffer++;
-      }
-      buffer.clear();
     }
   }
 
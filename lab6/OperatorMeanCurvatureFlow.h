@@ -29,6 +29,56 @@ class OperatorMeanCurvatureFlow : public LevelSetOperator
 	protected:
 		//! Scaling parameter, affects time step constraint
 		float mAlpha;
+
+		//! Computes dphi/dt = alpha kappa |grad phi| over the narrow band
+		virtual void computeRate(std::vector<float> & rate)
+			{
+			// Iterate over the narrow band, each thread fills its own contiguous slice of rate
+			const int size = (int)getGrid().getNarrowBandSize();
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+			for (int n = 0; n < size; n++) 
+				{
+				int i, j, k;
+				getGrid().getNarrowBandPoint(n, i, j, k);
+
+				// All differentials from one read of the 19 point stencil
+				LevelSet::Derivatives d;
+				mLS->getDerivatives(i, j, k, d, LevelSet::FIRST_ORDER | LevelSet::SECOND_ORDER);
+
+				/* *** calculate curvature *** */
+
+				// second order derivatives
+				float ddx2 = d.ddx2;
+				float ddy2 = d.ddy2;
+				float ddz2 = d.ddz2;
+
+				// first order derivatives
+				float ddx = d.ddxc;
+				float ddy = d.ddyc;
+				float ddz = d.ddzc;
+
+				// mixed derivatives
+				float dydz = d.ddyz;
+				float dxdz = d.ddzx;
+				float dxdy = d.ddxy;
+
+				// squares of the first derivatives
+				float ddxSqr = ddx * ddx;
+				float ddySqr = ddy * ddy;
+				float ddzSqr = ddz * ddz;
+
+				float denominator = 2.0f * pow(ddxSqr + ddySqr + ddzSqr, 3.0f/2.0f);
+				float curvatureK =	(ddxSqr * (ddy2 + ddz2) - 2.0f*ddy*ddz*dydz) / denominator + 
+					(ddySqr * (ddx2 + ddz2) - 2.0f*ddx*ddz*dxdz) / denominator +
+					(ddzSqr * (ddx2 + ddy2) - 2.0f*ddx*ddy*dxdy) / denominator;
+
+				/* *** the gradient uses the same central differentials *** */
+				/* *** compute time differential as product *** */
+				float gradientNorm = sqrt(ddx*ddx + ddy*ddy + ddz*ddz);
+				rate[n] = mAlpha * curvatureK * gradientNorm;
+				}
+			}
+
 	public :
 
 		OperatorMeanCurvatureFlow(LevelSet * LS, float alpha=.9f)
@@ -38,13 +88,10 @@ class OperatorMeanCurvatureFlow : public LevelSetOperator
 			{
 			std::cout << "applying mean curvature flow operator " << std::endl;
 
-			// Create buffer used to store intermediate results
-			std::vector<float> buffer;
-
-			// calculate stable timestep dt
+			// calculate stable timestep dt, the diffusion limit grows with the integrator order
 			float bound = 0.9f;
 			float dX = mLS->getDx();
-			float dt = bound * (dX * dX) / (6 * mAlpha );
+			float dt = bound * getDiffusiveStabilityFactor(mIntegrator) * (dX * dX) / (6 * mAlpha );
 
 			// Propagate level set with stable timestep dt
 			// until requested time is reached
@@ -54,82 +101,7 @@ class OperatorMeanCurvatureFlow : public LevelSetOperator
 					dt = time-elapsed;
 				elapsed += dt;
 
-				LevelSetGrid::Iterator iter = getGrid().beginNarrowBand();
-				LevelSetGrid::Iterator iend = getGrid().endNarrowBand();
-
-				int counter = 0;
-				while (iter != iend) 
-					{
-
-					//		  if ( (counter++ % 100) == 0)
-					//		  {
-					//			  std::cout << ".";
-					//		  }
-
-					unsigned int i = iter.getI();
-					unsigned int j = iter.getJ();
-					unsigned int k = iter.getK();
-
-					/* *** calculate curvature *** */
-
-					// second order derivatives
-					float ddx2 = mLS->diff2Xpm(i, j, k);
-					float ddy2 = mLS->diff2Ypm(i, j, k);
-					float ddz2 = mLS->diff2Zpm(i, j, k);
-
-					// first order derivatives
-					float ddx = mLS->diffXpm(i, j, k);
-					float ddy = mLS->diffYpm(i, j, k);
-					float ddz = mLS->diffZpm(i, j, k);
-
-					// mixed derivatives
-					float dydz = mLS->diff2YZpm(i, j, k);
-					float dxdz = mLS->diff2ZXpm(i, j, k);
-					float dxdy = mLS->diff2XYpm(i, j, k);
-
-					// squares of the first derivatives
-					float ddxSqr = ddx * ddx;
-					float ddySqr = ddy * ddy;
-					float ddzSqr = ddz * ddz;
-
-					float denominator = 2.0f * pow(ddxSqr + ddySqr + ddzSqr, 3.0f/2.0f);
-					float curvatureK =	(ddxSqr * (ddy2 + ddz2) - 2.0f*ddy*ddz*dydz) / denominator + 
-						(ddySqr * (ddx2 + ddz2) - 2.0f*ddx*ddz*dxdz) / denominator +
-						(ddzSqr * (ddx2 + ddy2) - 2.0f*ddx*ddy*dxdy) / denominator;
-
-					/* *** calculate gradient using central differentials *** */
-					ddx = mLS->diffXpm(i, j, k);
-					ddy = mLS->diffYpm(i, j, k);
-					ddz = mLS->diffZpm(i, j, k);
-
-					/* *** compute time differential as product *** */
-					float gradientNorm = sqrt(ddx*ddx + ddy*ddy + ddz*ddz);
-					float changeRate = mAlpha * curvatureK * gradientNorm;
-
-					/* *** update phi using first order forward Euler time integration *** */
-					float currentPhi	= getGrid().getValue(i, j, k);
-					float nextPhi		=  currentPhi + changeRate * dt;
-
-					// assign new value and store it in the buffer
-					buffer.push_back( nextPhi );
-
-					iter++;
-					}
-
-				// Copy new values from buffer to grid
-				iter = getGrid().beginNarrowBand();
-				std::vector<float>::iterator iterBuffer = buffer.begin();
-				while (iter != iend) 
-					{
-					unsigned int i = iter.getI();
-					unsigned int j = iter.getJ();
-					unsigned int k = iter.getK();
-
-					getGrid().setValue(i,j,k, (*iterBuffer));
-					iter++;
-					iterBuffer++;
-					}
-				buffer.clear();
+				integrate(dt);
 				}
 			}
 
@@ -26,19 +26,86 @@
  */
 class OperatorReinitialize : public LevelSetOperator
 {
+protected :
+
+  //! Returns the maximum norm of the central difference gradient in the narrow band
+  float getMaxGradient()
+  {
+    const int size = (int)getGrid().getNarrowBandSize();
+    float maxGrad = -std::numeric_limits<float>::max();
+
+    // Each thread finds the maximum of its chunk, then the chunks are merged
+#pragma omp parallel num_threads(getNumThreads())
+    {
+      float threadMax = -std::numeric_limits<float>::max();
+#pragma omp for schedule(static)
+      for (int n = 0; n < size; n++) {
+        int i, j, k;
+        getGrid().getNarrowBandPoint(n, i, j, k);
+
+        LevelSet::Derivatives d;
+        mLS->getDerivatives(i,j,k, d, LevelSet::FIRST_ORDER);
+        float normgrad2 = d.ddxc*d.ddxc + d.ddyc*d.ddyc + d.ddzc*d.ddzc;
+        if (threadMax < normgrad2) threadMax = normgrad2;
+      }
+#pragma omp critical
+      if (maxGrad < threadMax) maxGrad = threadMax;
+    }
+
+    return std::sqrt(maxGrad);
+  }
+
+  //! Keeps the grid points closest to the interface fixed, so the interface does not move
+  bool mFreezeInterface;
+
+  //! Computes dphi/dt = S(phi) (1 - |grad phi|) over the narrow band
+  virtual void computeRate(std::vector<float> & rate)
+  {
+    const float dx = mLS->getDx();
+
+    // Iterate over the narrow band in batches, each thread fills its own contiguous slice of rate
+    const int numBatches = getNumBatches();
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+    for (int b = 0; b < numBatches; b++) {
+      int i[BATCH_SIZE], j[BATCH_SIZE], k[BATCH_SIZE];
+      const int count = getNarrowBandBatch(b, i, j, k);
+
+      // All differentials from one read of the 7 point stencil
+      LevelSet::Derivatives d[BATCH_SIZE];
+      mLS->getDerivatives(i, j, k, count, d, LevelSet::FIRST_ORDER);
+
+      // Compute the sign function (from central differencing?)
+      float sign[BATCH_SIZE];
+      for (int n = 0; n < count; n++) {
+        float normgrad2 = d[n].ddxc*d[n].ddxc + d[n].ddyc*d[n].ddyc + d[n].ddzc*d[n].ddzc;
+        float val = getGrid().getValue(i[n],j[n],k[n]);
+        sign[n] = val / std::sqrt(val*val + normgrad2*dx*dx);
+      }
+
+      float ddx2[BATCH_SIZE], ddy2[BATCH_SIZE], ddz2[BATCH_SIZE];
+      godunov(d, sign, count, ddx2, ddy2, ddz2);
+
+      for (int n = 0; n < count; n++) {
+        if (mFreezeInterface && fabs(getGrid().getValue(i[n],j[n],k[n])) < 0.5*dx)
+          rate[b*BATCH_SIZE + n] = 0;
+        else
+          rate[b*BATCH_SIZE + n] = sign[n] * (1 - std::sqrt(ddx2[n] + ddy2[n] + ddz2[n]));
+      }
+    }
+  }
+
 public :
 
-  OperatorReinitialize(LevelSet * LS) : LevelSetOperator(LS) { }
+  OperatorReinitialize(LevelSet * LS) : LevelSetOperator(LS), mFreezeInterface(false) { }
 
   virtual void propagate(float time)
   {
-    // Create buffer used to store intermediate results
-    std::vector<float> buffer;
-
     // Determine timestep for stability
     float dx = mLS->getDx();
     float dt = 0.5 * dx;
 
+    // Grid points within half a cell of the interface keep their values
+    mFreezeInterface = true;
 
     // Propagate level set with stable timestep dt
     // until requested time is reached
@@ -50,68 +117,10 @@ public :
         dt = time-elapsed;
       elapsed += dt;
 
-      // Iterate over grid and compute the grid values for the next timestep
-      LevelSetGrid::Iterator iter = getGrid().beginNarrowBand();
-      LevelSetGrid::Iterator iend = getGrid().endNarrowBand();
-      while (iter != iend) {
-        unsigned int i = iter.getI();
-        unsigned int j = iter.getJ();
-        unsigned int k = iter.getK();
-
-        // Compute the sign function (from central differencing?)
-        float ddxc = mLS->diffXpm(i,j,k);
-        float ddyc = mLS->diffYpm(i,j,k);
-        float ddzc = mLS->diffZpm(i,j,k);
-        float normgrad2 = ddxc*ddxc + ddyc*ddyc + ddzc*ddzc;
-        float val = getGrid().getValue(i,j,k);
-        float sign = val / std::sqrt(val*val + normgrad2*dx*dx);
-
-        float ddx2, ddy2, ddz2;
-        godunov(i,j,k, sign, ddx2, ddy2, ddz2);
-
-        // Compute the new value and store it in the buffer
-        float ddt = sign * (1 - std::sqrt(ddx2 + ddy2 + ddz2));
-        val = getGrid().getValue(i,j,k) + ddt*dt;
-        buffer.push_back(val);
-
-        iter++;
-      }
-
-      // Copy new values from buffer to grid
-      iter = getGrid().beginNarrowBand();
-      std::vector<float>::iterator iterBuffer = buffer.begin();
-      while (iter != iend) {
-        unsigned int i = iter.getI();
-        unsigned int j = iter.getJ();
-        unsigned int k = iter.getK();
-
-        if (fabs(getGrid().getValue(i,j,k)) >= 0.5*dx)
-        {
-          getGrid().setValue(i,j,k, (*iterBuffer));
-        }
-        iter++;
-        iterBuffer++;
-      }
-      buffer.clear();
+      integrate(dt);
 
       // Read maximum norm of gradient
-      float maxGrad = -std::numeric_limits<float>::max();
-      iter = getGrid().beginNarrowBand();
-      while (iter != iend) {
-        unsigned int i = iter.getI();
-        unsigned int j = iter.getJ();
-        unsigned int k = iter.getK();
-
-
-        float ddxc = mLS->diffXpm(i,j,k);
-        float ddyc = mLS->diffYpm(i,j,k);
-        float ddzc = mLS->diffZpm(i,j,k);
-        float normgrad2 = ddxc*ddxc + ddyc*ddyc + ddzc*ddzc;
-        if (maxGrad < normgrad2) maxGrad = normgrad2;
-
-        iter++;
-      }
-      maxGrad = std::sqrt(maxGrad);
+      float maxGrad = getMaxGradient();
       std::cerr << "Maximum gradient: " << maxGrad << std::endl;
 
       getGrid().rebuild();
@@ -121,13 +130,12 @@ public :
 
   virtual void propagateTo( float delta )
 	  {
-	  // Create buffer used to store intermediate results
-	  std::vector<float> buffer;
-
 	  // Determine timestep for stability
 	  float dx = mLS->getDx();
 	  float dt = 0.5 * dx;
 
+	  mFreezeInterface = false;
+
 	  // Read maximum norm of gradient
 	  float maxGrad = std::numeric_limits<float>::max();
 
@@ -145,65 +153,10 @@ public :
 			  dt = time-elapsed;
 		  elapsed += dt;
 
-		  // Iterate over grid and compute the grid values for the next timestep
-		  LevelSetGrid::Iterator iter = getGrid().beginNarrowBand();
-		  LevelSetGrid::Iterator iend = getGrid().endNarrowBand();
-		  while (iter != iend) {
-			  unsigned int i = iter.getI();
-			  unsigned int j = iter.getJ();
-			  unsigned int k = iter.getK();
-
-			  // Compute the sign function (from central differencing?)
-			  float ddxc = mLS->diffXpm(i,j,k);
-			  float ddyc = mLS->diffYpm(i,j,k);
-			  float ddzc = mLS->diffZpm(i,j,k);
-			  float normgrad2 = ddxc*ddxc + ddyc*ddyc + ddzc*ddzc;
-			  float val = getGrid().getValue(i,j,k);
-			  float sign = val / std::sqrt(val*val + normgrad2*dx*dx);
-
-			  float ddx2, ddy2, ddz2;
-			  godunov(i,j,k, sign, ddx2, ddy2, ddz2);
-
-			  // Compute the new value and store it in the buffer
-			  float ddt = sign * (1 - std::sqrt(ddx2 + ddy2 + ddz2));
-			  val = getGrid().getValue(i,j,k) + ddt*dt;
-			  buffer.push_back(val);
-
-			  iter++;
-			  }
-
-		  // Copy new values from buffer to grid
-		  iter = getGrid().beginNarrowBand();
-		  std::vector<float>::iterator iterBuffer = buffer.begin();
-		  while (iter != iend) {
-			  unsigned int i = iter.getI();
-			  unsigned int j = iter.getJ();
-			  unsigned int k = iter.getK();
-
-			  getGrid().setValue(i,j,k, (*iterBuffer));
-			  iter++;
-			  iterBuffer++;
-			  }
-		  buffer.clear();
+		  integrate(dt);
 
 		  // Read maximum norm of gradient
-		  maxGrad = -std::numeric_limits<float>::max();
-		  iter = getGrid().beginNarrowBand();
-		  while (iter != iend) {
-			  unsigned int i = iter.getI();
-			  unsigned int j = iter.getJ();
-			  unsigned int k = iter.getK();
-
-
-			  float ddxc = mLS->diffXpm(i,j,k);
-			  float ddyc = mLS->diffYpm(i,j,k);
-			  float ddzc = mLS->diffZpm(i,j,k);
-			  float normgrad2 = ddxc*ddxc + ddyc*ddyc + ddzc*ddzc;
-			  if (maxGrad < normgrad2) maxGrad = normgrad2;
-
-			  iter++;
-			  }
-		  maxGrad = std::sqrt(maxGrad);
+		  maxGrad = getMaxGradient();
 		  std::cerr << "Maximum gradient: " << maxGrad << std::endl;
 
 		  getGrid().rebuild();
@@ -0,0 +1,237 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#ifndef __operatorreinitializefastmarching_h__
+#define __operatorreinitializefastmarching_h__
+
+#include "LevelSetOperator.h"
+#include "SparseVolume.h"
+#include "Heap.h"
+#include <deque>
+#include <algorithm>
+
+/*! \brief A level set operator that does reinitialization with the fast marching method
+ *
+ * Instead of solving the reinitialization PDE in pseudo time, as OperatorReinitialize
+ * does, this operator solves the Eikonal equation
+ *
+ *  \f$
+ *  |\nabla \phi| = 1
+ *  \f$
+ *
+ * directly. Grid points next to the interface get their distance from a linear
+ * interpolation of the zero crossings along the grid axes. From there the
+ * distances are marched outwards in order of increasing distance, solving the
+ * first order upwind discretization once per grid point, until the narrow band
+ * constants are reached. The whole narrow band is rebuilt in one O(n log n) pass.
+ */
+class OperatorReinitializeFastMarching : public LevelSetOperator
+{
+protected :
+
+  //! A grid point visited by the marching front, the cost is the unsigned distance
+  struct MarchNode : public Heap::Heapable
+  {
+    MarchNode(int i, int j, int k, float sign) : i(i), j(j), k(k), sign(sign), accepted(false) { }
+
+    int i, j, k;
+    float sign;
+    bool accepted;
+  };
+
+  //! Visited grid points, a deque keeps the addresses stable for the heap
+  std::deque<MarchNode> mNodes;
+  //! Index into mNodes for every visited grid point, -1 if not visited
+  SparseVolume<int> mNodeIndex;
+
+  inline bool isInside(int i, int j, int k) const {
+    return i >= 0 && i < getGrid().getDimX() &&
+           j >= 0 && j < getGrid().getDimY() &&
+           k >= 0 && k < getGrid().getDimZ();
+  }
+
+  //! Returns the node of grid point (i,j,k) or NULL if it has not been visited
+  MarchNode * getNode(int i, int j, int k) {
+    if (!isInside(i,j,k)) return NULL;
+    const int index = mNodeIndex.getValue(i,j,k);
+    return index < 0 ? NULL : &mNodes[index];
+  }
+
+  MarchNode * addNode(int i, int j, int k) {
+    const float phi = getGrid().getValue(i,j,k);
+    mNodeIndex.setValue(i,j,k, mNodes.size());
+    mNodes.push_back(MarchNode(i,j,k, phi < 0 ? -1.0f : 1.0f));
+    return &mNodes.back();
+  }
+
+  /*!
+   * Returns the distance to the interface for grid point (i,j,k) estimated from
+   * the zero crossings to its 6-neighbours, or a negative value if there is no
+   * zero crossing next to (i,j,k).
+   */
+  float interfaceDistance(int i, int j, int k) const
+  {
+    static const int offsets[3][3] = { {1,0,0}, {0,1,0}, {0,0,1} };
+    const float dx = mLS->getDx();
+    const float phi = getGrid().getValue(i,j,k);
+    if (phi == 0) return 0;
+
+    bool crossing = false;
+    float invDist2 = 0;
+    for (int a = 0; a < 3; a++) {
+      float dist = std::numeric_limits<float>::max();
+      for (int s = -1; s <= 1; s += 2) {
+        const int ni = i + s*offsets[a][0], nj = j + s*offsets[a][1], nk = k + s*offsets[a][2];
+        if (!isInside(ni,nj,nk)) continue;
+        const float phiN = getGrid().getValue(ni,nj,nk);
+        if ((phi < 0) == (phiN < 0)) continue;
+        dist = std::min(dist, dx * phi / (phi - phiN));
+      }
+      if (dist == std::numeric_limits<float>::max()) continue;
+      if (dist == 0) return 0;
+      invDist2 += 1.0f / (dist*dist);
+      crossing = true;
+    }
+    return crossing ? 1.0f / std::sqrt(invDist2) : -1.0f;
+  }
+
+  /*!
+   * Solves the upwind discretization of |grad phi| = 1 at grid point (i,j,k)
+   * using the accepted neighbours along each axis.
+   */
+  float solveEikonal(int i, int j, int k)
+  {
+    static const int offsets[3][3] = { {1,0,0}, {0,1,0}, {0,0,1} };
+    const float dx = mLS->getDx();
+
+    // The smallest accepted distance along each axis
+    float a[3];
+    int numAxes = 0;
+    for (int ax = 0; ax < 3; ax++) {
+      float dist = std::numeric_limits<float>::max();
+      for (int s = -1; s <= 1; s += 2) {
+        const MarchNode * node = getNode(i + s*offsets[ax][0], j + s*offsets[ax][1], k + s*offsets[ax][2]);
+        if (node != NULL && node->accepted) dist = std::min(dist, node->cost);
+      }
+      if (dist != std::numeric_limits<float>::max()) a[numAxes++] = dist;
+    }
+    // Sort the axes, a[0] smallest
+    if (numAxes > 1 && a[1] < a[0]) std::swap(a[0], a[1]);
+    if (numAxes > 2) {
+      if (a[2] < a[1]) std::swap(a[1], a[2]);
+      if (a[1] < a[0]) std::swap(a[0], a[1]);
+    }
+
+    // Add one axis at a time, as long as the solution is upwind of it
+    float u = a[0] + dx;
+    if (numAxes > 1 && u > a[1]) {
+      const float diff = a[0] - a[1];
+      u = 0.5f * (a[0] + a[1] + std::sqrt(2*dx*dx - diff*diff));
+      if (numAxes > 2 && u > a[2]) {
+        const float sum = a[0] + a[1] + a[2];
+        const float sum2 = a[0]*a[0] + a[1]*a[1] + a[2]*a[2];
+        u = (sum + std::sqrt(std::max(sum*sum - 3*(sum2 - dx*dx), 0.0f))) / 3.0f;
+      }
+    }
+    return u;
+  }
+
+  //! Adds (i,j,k) to the front or lowers its tentative distance
+  void updateNeighbour(Heap & heap, int i, int j, int k)
+  {
+    if (!isInside(i,j,k)) return;
+    MarchNode * node = getNode(i,j,k);
+    if (node == NULL) {
+      node = addNode(i,j,k);
+      node->cost = solveEikonal(i,j,k);
+      heap.push(node);
+    }
+    else if (!node->accepted) {
+      const float cost = solveEikonal(i,j,k);
+      if (cost < node->cost) {
+        node->cost = cost;
+        heap.update(node);
+      }
+    }
+  }
+
+public :
+
+  OperatorReinitializeFastMarching(LevelSet * LS) : LevelSetOperator(LS) { }
+
+  //! Rebuilds the narrow band as a signed distance function, time is not used
+  //! since the whole band is recomputed in one pass
+  virtual void propagate(float time)
+  {
+    LevelSetGrid & grid = getGrid();
+    mNodes.clear();
+    mNodeIndex = SparseVolume<int>(grid.getDimX(), grid.getDimY(), grid.getDimZ(), -1);
+    Heap heap;
+
+    // Freeze the grid points next to the interface
+    const int size = (int)grid.getNarrowBandSize();
+    for (int n = 0; n < size; n++) {
+      int i, j, k;
+      grid.getNarrowBandPoint(n, i, j, k);
+      const float dist = interfaceDistance(i,j,k);
+      if (dist < 0) continue;
+      MarchNode * node = addNode(i,j,k);
+      node->cost = dist;
+      node->accepted = true;
+    }
+
+    // Start the front at the neighbours of the frozen grid points
+    const int numFrozen = mNodes.size();
+    for (int n = 0; n < numFrozen; n++) {
+      const int i = mNodes[n].i, j = mNodes[n].j, k = mNodes[n].k;
+      updateNeighbour(heap, i+1,j,k);  updateNeighbour(heap, i-1,j,k);
+      updateNeighbour(heap, i,j+1,k);  updateNeighbour(heap, i,j-1,k);
+      updateNeighbour(heap, i,j,k+1);  updateNeighbour(heap, i,j,k-1);
+    }
+
+    // March outwards in order of increasing distance until the band constants are reached
+    const float limit = std::max(grid.getOutsideConstant(), -grid.getInsideConstant());
+    while (!heap.isEmpty()) {
+      MarchNode * node = static_cast<MarchNode *>(heap.pop());
+      node->accepted = true;
+      if (node->cost > limit) break;
+
+      const int i = node->i, j = node->j, k = node->k;
+      updateNeighbour(heap, i+1,j,k);  updateNeighbour(heap, i-1,j,k);
+      updateNeighbour(heap, i,j+1,k);  updateNeighbour(heap, i,j-1,k);
+      updateNeighbour(heap, i,j,k+1);  updateNeighbour(heap, i,j,k-1);
+    }
+
+    // Grid points the front never reached are further away than the band constants
+    for (int n = 0; n < size; n++) {
+      int i, j, k;
+      grid.getNarrowBandPoint(n, i, j, k);
+      const MarchNode * node = getNode(i,j,k);
+      if (node == NULL || !node->accepted)
+        grid.setNarrowBandValue(n, grid.getValue(i,j,k) < 0 ? -std::numeric_limits<float>::max() : std::numeric_limits<float>::max());
+    }
+
+    // Copy the distances to the grid, this adds the new grid points to the band
+    for (unsigned int n = 0; n < mNodes.size(); n++) {
+      const MarchNode & node = mNodes[n];
+      if (node.accepted) grid.setValue(node.i, node.j, node.k, node.sign * node.cost);
+    }
+
+    // Clamp grid points beyond the band constants and remove them from the band
+    grid.rebuild();
+
+    mNodes.clear();
+    mNodeIndex = SparseVolume<int>();
+  }
+
+};
+
+#endif
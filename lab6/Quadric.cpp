@@ -10,6 +10,7 @@
 *
 *************************************************************************************************/
 #include "Quadric.h"
+#include "ImplicitProgram.h"
 
 Quadric::Quadric(const Matrix4x4<float> & q)
 	{
@@ -32,18 +33,23 @@ float Quadric::getValue(float x, float y, float z) const
 	}
 
 /*!
-* Use the quadric matrix to evaluate the gradient.
+* Use the transformed quadric matrix to evaluate the gradient and the
+* curvature. p^T Q p has gradient (Q + Q^T) p and constant Hessian Q + Q^T,
+* which does not assume a symmetric Q (the planes of Cube are not).
 */
-Vector3<float> Quadric::getGradient(float x, float y, float z, float delta) const
+float Quadric::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const
 	{
-	Vector4<float> p(x, y, z, 1.f);	
-	p = mQuadric * ( mWorld2Obj * p);
-	return 2.0f *( Vector3<float> ( p[0],p[1],p[2] ) );
+	Vector4<float> p(x, y, z, 1.f);
+	Vector4<float> qp = mQuadricPrime * p;
+	Vector4<float> pq = mQuadricPrime.transpose() * p;
+	gradient = Vector3<float>(qp[0] + pq[0], qp[1] + pq[1], qp[2] + pq[2]);
+	curvature = 2.0f * (mQuadricPrime(0,0) + mQuadricPrime(1,1) + mQuadricPrime(2,2));
+	return p * qp;
 	}
 
-float Quadric::getCurvature(float x, float y, float z) const
+void Quadric::compile(ImplicitProgram & program) const
 	{
-	return Implicit::getCurvature(x, y, z);
+	program.addQuadric(mQuadricPrime);
 	}
 
 void Quadric::setTransform( const Matrix4x4<float> & transform )
@@ -22,10 +22,10 @@ public:
   virtual ~Quadric();
   //! evaluate the quadric at world coordinates x y z
   virtual float getValue(float x, float y, float z) const;
-  //! calculate the gradient at world coordinates x y z
-  virtual Vector3<float> getGradient(float x, float y, float z, float delta = 1e-3) const;
-  //! calculate the curvature at world coordinates x y z
-  virtual float getCurvature(float x, float y, float z) const;
+  //! evaluate the quadric with its analytic gradient and curvature at world coordinates x y z
+  virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const;
+  virtual Vector3<float> getGradient(float x, float y, float z, float delta = 1e-3) const { return getDerivativesGradient(x, y, z, delta); }
+  virtual void compile(ImplicitProgram & program) const;
 
   //! Set transformation for the Q
   virtual void setTransform(const Matrix4x4<float> & transform);
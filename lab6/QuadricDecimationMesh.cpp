@@ -24,7 +24,7 @@ void QuadricDecimationMesh::initialize()
 
     // Calculate initial error, should be numerically close to 0
 
-    Vector3<float> v0 = mVerts[i].vec;
+    Vector3<float> v0 = mVertPositions[i];
     Vector4<float> v(v0.x(),v0.y(),v0.z(),1);
     Matrix4x4<float> m = mQuadrics.back();
 
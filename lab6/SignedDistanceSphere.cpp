@@ -10,6 +10,7 @@
  *
  *************************************************************************************************/
 #include "SignedDistanceSphere.h"
+#include "ImplicitProgram.h"
 
 SignedDistanceSphere::SignedDistanceSphere(float r)
 {
@@ -26,3 +27,27 @@ float SignedDistanceSphere::getValue(float x, float y, float z) const
   return std::sqrt(vprim*vprim - 1.f) - radius;
 }
 
+float SignedDistanceSphere::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const
+{
+  // |q| with q = M p has gradient M^T q/|q| and Laplacian (trace(M^T M) - |M^T q|^2/|q|^2)/|q|
+  Vector4<float> vprim, v = Vector4<float>(x, y, z, 1.f);
+  vprim = mWorld2Obj*v;
+  const float length = std::sqrt(vprim*vprim - 1.f);
+  gradient = gradientObj2World(Vector3<float>(vprim[0], vprim[1], vprim[2]) / length);
+  curvature = (getWorld2ObjRowNorm(0) + getWorld2ObjRowNorm(1) + getWorld2ObjRowNorm(2) - gradient.norm()) / length;
+  return length - radius;
+}
+
+void SignedDistanceSphere::compile(ImplicitProgram & program) const
+{
+  program.addDistanceSphere(mWorld2Obj, radius);
+}
+
+bool SignedDistanceSphere::getValueBound(float & a, float & b) const
+{
+  // A point d outside the box is at least d/scale from the sphere in object space
+  a = 0;
+  b = 1.f / getTransformScale();
+  return true;
+}
+
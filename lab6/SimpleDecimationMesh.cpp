@@ -19,8 +19,8 @@ void SimpleDecimationMesh::computeCollapse(EdgeCollapse * collapse)
   // position halfway along the edge. The cost is computed as
   // the vertex-to-vertex distance between the new vertex
   // and the old vertices at the edge's endpoints
-  const Vector3<float>& v0 = mVerts[ mEdges[collapse->halfEdge].vert ].vec;
-  const Vector3<float>& v1 = mVerts[ mEdges[mEdges[collapse->halfEdge].pair].vert ].vec;
+  const Vector3<float>& v0 = mVertPositions[ mEdges[collapse->halfEdge].vert ];
+  const Vector3<float>& v1 = mVertPositions[ mEdges[pair(collapse->halfEdge)].vert ];
   collapse->position = (v0 + v1)*0.5;
   collapse->cost = (collapse->position - v0).length();
 }
@@ -15,7 +15,7 @@
 using namespace std;
 
 //-----------------------------------------------------------------------------
-SimpleMesh::SimpleMesh()
+SimpleMesh::SimpleMesh() : mAdjacencyValid(false)
 {
 }
 
@@ -37,10 +37,26 @@ bool SimpleMesh::addTriangle(const Vector3<float> &v1, const Vector3<float> &v2,
   face.v2 = ind2;
   face.v3 = ind3;
   mFaces.push_back(face);
+  mAdjacencyValid = false;
 
   return true;
 }
 
+//-----------------------------------------------------------------------------
+void SimpleMesh::buildFromIndexed(const std::vector<Vector3<float> > & verts, const std::vector<unsigned int> & indices)
+{
+  assert(mVerts.empty() && mFaces.empty());
+  mVerts = verts;
+
+  mFaces.resize(indices.size() / 3);
+  for (unsigned int n = 0; n < mFaces.size(); n++) {
+    mFaces[n].v1 = indices[3*n];
+    mFaces[n].v2 = indices[3*n+1];
+    mFaces[n].v3 = indices[3*n+2];
+  }
+  mAdjacencyValid = false;
+}
+
 //-----------------------------------------------------------------------------
 bool SimpleMesh::addVertex(const Vector3<float> & v, unsigned int &indx){
   std::map<Vector3<float>,unsigned int>::iterator it = mUniqueVerts.find(v);
@@ -56,27 +72,77 @@ bool SimpleMesh::addVertex(const Vector3<float> & v, unsigned int &indx){
 }
 
 //-----------------------------------------------------------------------------
-bool SimpleMesh::findNeighbourTriangles(const unsigned int vertexIndex, std::vector<unsigned int>& foundTriangles) const
+void SimpleMesh::buildAdjacency() const
 {
-  foundTriangles.clear();
-
-  // Find other triangles that include this vertex
-  std::vector<Face>::const_iterator iter = mFaces.begin();
-  std::vector<Face>::const_iterator iend = mFaces.end();
-  while (iter != iend) {
-    if ((*iter).v1 == vertexIndex ||
-      (*iter).v2 == vertexIndex ||
-      (*iter).v3 == vertexIndex)
-      {
-        foundTriangles.push_back( iter - mFaces.begin());
-      }
+  const unsigned int numVerts = mVerts.size();
+  const unsigned int numFaces = mFaces.size();
+
+  // Count the faces of each vertex, a degenerate face only once per vertex,
+  // and turn the counts into the start of each vertex' range
+  mVertexFaceStart.assign(numVerts + 1, 0);
+  for (unsigned int f = 0; f < numFaces; f++){
+    const Face& face = mFaces[f];
+    mVertexFaceStart[face.v1 + 1]++;
+    if (face.v2 != face.v1) mVertexFaceStart[face.v2 + 1]++;
+    if (face.v3 != face.v1 && face.v3 != face.v2) mVertexFaceStart[face.v3 + 1]++;
+  }
+  for (unsigned int v = 0; v < numVerts; v++)
+    mVertexFaceStart[v + 1] += mVertexFaceStart[v];
+
+  // Going through the faces in order leaves each range sorted
+  mVertexFaces.resize(mVertexFaceStart[numVerts]);
+  std::vector<unsigned int> next(mVertexFaceStart.begin(), mVertexFaceStart.end() - 1);
+  for (unsigned int f = 0; f < numFaces; f++){
+    const Face& face = mFaces[f];
+    mVertexFaces[next[face.v1]++] = f;
+    if (face.v2 != face.v1) mVertexFaces[next[face.v2]++] = f;
+    if (face.v3 != face.v1 && face.v3 != face.v2) mVertexFaces[next[face.v3]++] = f;
+  }
 
-    iter++;
+  // The neighbour vertices are the other corners of the faces of a vertex,
+  // each shared by two of the faces around an interior vertex
+  mVertexVertexStart.resize(numVerts + 1);
+  mVertexVertices.clear();
+  mVertexVertices.reserve(mVertexFaces.size());
+  mVertexVertexStart[0] = 0;
+  for (unsigned int v = 0; v < numVerts; v++){
+    const unsigned int first = mVertexVertices.size();
+    for (unsigned int n = mVertexFaceStart[v]; n < mVertexFaceStart[v + 1]; n++){
+      const Face& face = mFaces[mVertexFaces[n]];
+      if (face.v1 != v) mVertexVertices.push_back(face.v1);
+      if (face.v2 != v) mVertexVertices.push_back(face.v2);
+      if (face.v3 != v) mVertexVertices.push_back(face.v3);
+    }
+    std::sort(mVertexVertices.begin() + first, mVertexVertices.end());
+    mVertexVertices.erase(std::unique(mVertexVertices.begin() + first, mVertexVertices.end()), mVertexVertices.end());
+    mVertexVertexStart[v + 1] = mVertexVertices.size();
   }
 
+  mAdjacencyValid = true;
+}
+
+//-----------------------------------------------------------------------------
+bool SimpleMesh::findNeighbourTriangles(const unsigned int vertexIndex, std::vector<unsigned int>& foundTriangles) const
+{
+  if (!mAdjacencyValid) buildAdjacency();
+
+  foundTriangles.assign(mVertexFaces.begin() + mVertexFaceStart[vertexIndex],
+                        mVertexFaces.begin() + mVertexFaceStart[vertexIndex + 1]);
+
   return !(foundTriangles.size() == 0);
 }
 
+//-----------------------------------------------------------------------------
+bool SimpleMesh::findNeighbourVertices(const unsigned int vertexIndex, std::vector<unsigned int>& foundVertices) const
+{
+  if (!mAdjacencyValid) buildAdjacency();
+
+  foundVertices.assign(mVertexVertices.begin() + mVertexVertexStart[vertexIndex],
+                       mVertexVertices.begin() + mVertexVertexStart[vertexIndex + 1]);
+
+  return !(foundVertices.size() == 0);
+}
+
 
 
 //-----------------------------------------------------------------------------
@@ -242,9 +308,10 @@ float SimpleMesh::curvature(const unsigned int vertexIndex, const Vector3<float>
   float curvature = 0;
 
   std::vector<unsigned int> neighbourTriangles;
-  std::map<Vector3<float>, unsigned int> localVertexList;
+  std::vector<unsigned int> localVertexList;
 
   findNeighbourTriangles(vertexIndex, neighbourTriangles);
+  findNeighbourVertices(vertexIndex, localVertexList);
   assert(neighbourTriangles.size() != 0);
 
   // calculate area
@@ -255,89 +322,63 @@ float SimpleMesh::curvature(const unsigned int vertexIndex, const Vector3<float>
     Vector3<float>& v1 = mVerts[tri.v2];
     Vector3<float>& v2 = mVerts[tri.v3];
     A += triArea(v0,v1,v2);
-
-    // Add vertices to localList
-    std::map<Vector3<float>,unsigned int>::iterator it = localVertexList.find(v0);
-    if (it == localVertexList.end()){
-      localVertexList[v0] = 1;
-    }
-    it = localVertexList.find(v1);
-    if (it == localVertexList.end()){
-      localVertexList[v1] = 1;
-    }
-    it = localVertexList.find(v2);
-    if (it == localVertexList.end()){
-      localVertexList[v2] = 1;
-    }
   }
-  assert(localVertexList.size() == neighbourTriangles.size()+1);
+  assert(localVertexList.size() == neighbourTriangles.size());
 
   // Calculate curvature vector
   Vector3<float> curv(0,0,0);
 
-  std::map<Vector3<float>,unsigned int>::iterator iter, iend;
-  iter = localVertexList.begin();
-  iend = localVertexList.end();
-
   float Avor = 0;
-  while (iter != iend){
-    // If not this vertex
-    const Vector3<float>& localV = (*iter).first;
-
-    if (localV != v){
-      // Find the two triangles that contain localV
-      std::vector<Vector3<float> > neighbourVertices;
-      for (unsigned int i = 0; i < neighbourTriangles.size(); i++){
-        const Face& f = mFaces[neighbourTriangles[i]];
-        const Vector3<unsigned int> t(f.v1, f.v2, f.v3);
-
-        bool vFound = false;
-        bool localVFound = false;
-        Vector3<float> otherVertex;
-        for (int j = 0; j < 3; j++){
-          if (mVerts[t[j]] == v){
-            vFound = true;
-          }
-          else if (mVerts[t[j]] == localV){
-            localVFound = true;
-          }
-          else{
-            otherVertex = mVerts[t[j]];
-          }
+  for (unsigned int l = 0; l < localVertexList.size(); l++){
+    const unsigned int localIndex = localVertexList[l];
+    const Vector3<float>& localV = mVerts[localIndex];
+
+    // Find the two triangles that contain localV
+    std::vector<Vector3<float> > neighbourVertices;
+    for (unsigned int i = 0; i < neighbourTriangles.size(); i++){
+      const Face& f = mFaces[neighbourTriangles[i]];
+      const Vector3<unsigned int> t(f.v1, f.v2, f.v3);
+
+      bool localVFound = false;
+      Vector3<float> otherVertex;
+      for (int j = 0; j < 3; j++){
+        if (t[j] == localIndex){
+          localVFound = true;
         }
-
-        if (vFound && localVFound){
-          neighbourVertices.push_back(otherVertex);
+        else if (t[j] != vertexIndex){
+          otherVertex = mVerts[t[j]];
         }
       }
 
-      assert(neighbourVertices.size() == 2);
-      assert(neighbourVertices[0] != neighbourVertices[1]);
-      assert(neighbourVertices[0] != v);
-      assert(neighbourVertices[0] != localV);
-      assert(neighbourVertices[1] != v);
-      assert(neighbourVertices[1] != localV);
-
-      // Calculate angles:
-      float angle[2];
-      for (int i = 0; i < 2; i++){
-        Vector3<float> v1 = (v -  neighbourVertices[i]);
-        Vector3<float> v2 = (localV - neighbourVertices[i]);
-        v1.normalize();
-        v2.normalize();
-        angle[i] = acos(v1*v2);
-
-        assert(angle[i] >= 0.0);
-        assert(angle[i] <= M_PI);
+      if (localVFound){
+        neighbourVertices.push_back(otherVertex);
       }
-      Vector3<float> resVec = v - localV;
-      //std::cerr << "Angles: " << angle[0] << ", " << angle[1] << ", l: " << resVec.length() << "\n";
-      curv += resVec*(1.0/tan(angle[0]) + 1.0/tan(angle[1]));
+    }
 
-      Avor += 1.0/8.0*(1.0/tan(angle[0]) + 1.0/tan(angle[1]))*resVec.length()*resVec.length();
+    assert(neighbourVertices.size() == 2);
+    assert(neighbourVertices[0] != neighbourVertices[1]);
+    assert(neighbourVertices[0] != v);
+    assert(neighbourVertices[0] != localV);
+    assert(neighbourVertices[1] != v);
+    assert(neighbourVertices[1] != localV);
+
+    // Calculate angles:
+    float angle[2];
+    for (int i = 0; i < 2; i++){
+      Vector3<float> v1 = (v -  neighbourVertices[i]);
+      Vector3<float> v2 = (localV - neighbourVertices[i]);
+      v1.normalize();
+      v2.normalize();
+      angle[i] = acos(v1*v2);
+
+      assert(angle[i] >= 0.0);
+      assert(angle[i] <= M_PI);
     }
+    Vector3<float> resVec = v - localV;
+    //std::cerr << "Angles: " << angle[0] << ", " << angle[1] << ", l: " << resVec.length() << "\n";
+    curv += resVec*(1.0/tan(angle[0]) + 1.0/tan(angle[1]));
 
-    iter++;
+    Avor += 1.0/8.0*(1.0/tan(angle[0]) + 1.0/tan(angle[1]))*resVec.length()*resVec.length();
   }
   //  std::cerr << "Area: " << A << ", voronoi area: " << Avor << "\n";
 
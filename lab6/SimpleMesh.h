@@ -58,11 +58,28 @@ protected:
 
   std::map<Vector3<float>, unsigned int> mUniqueVerts;
 
+  /*!
+   * Vertex to face and vertex to vertex adjacency in compressed form: the faces
+   * of vertex v are mVertexFaces[mVertexFaceStart[v]] up to, but not including,
+   * mVertexFaces[mVertexFaceStart[v+1]], in increasing order, and likewise for
+   * the vertices sharing an edge with v. Built on the first neighbourhood query
+   * after the faces changed, see buildAdjacency().
+   */
+  mutable std::vector<unsigned int> mVertexFaceStart, mVertexFaces;
+  mutable std::vector<unsigned int> mVertexVertexStart, mVertexVertices;
+  //! False when the faces changed since the adjacency was built
+  mutable bool mAdjacencyValid;
+
+  //! Builds the adjacency of all vertices, in time linear in the size of the mesh
+  void buildAdjacency() const;
+
   //! Adds a vertex to the mesh
   virtual bool addVertex(const Vector3<float>& v, unsigned int &indx);
 
   // Given a vertex, find all triangles that includes this vertex
   virtual bool findNeighbourTriangles(const unsigned int vertexIndex, std::vector<unsigned int>& foundTriangles) const;
+  //! Given a vertex, find all vertices sharing an edge with it
+  bool findNeighbourVertices(const unsigned int vertexIndex, std::vector<unsigned int>& foundVertices) const;
 
 public:
   SimpleMesh();
@@ -70,6 +87,8 @@ public:
 
   //! Adds a triangle to the mesh. \sa addTriangle
   virtual bool addTriangle(const Vector3<float> &v1, const Vector3<float> &v2, const Vector3<float> & v3);
+  //! Builds the mesh from indexed triangles. \sa Mesh::buildFromIndexed
+  virtual void buildFromIndexed(const std::vector<Vector3<float> > & verts, const std::vector<unsigned int> & indices);
 
   //! Access to internal vertex data
   const std::vector<Vector3<float> >& getVerts() const { return mVerts; }
@@ -80,6 +99,7 @@ public:
   // Methods for calculating normals
   virtual void calculateFaceNormals();
   virtual void calculateVertexNormals();
+  virtual void setVertexNormals(const std::vector<Vector3<float> > & normals) { mNormals = normals; }
 
   // Draw call
   virtual void draw();
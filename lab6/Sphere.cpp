@@ -10,6 +10,7 @@
  *
  *************************************************************************************************/
 #include "Sphere.h"
+#include "ImplicitProgram.h"
 
 Sphere::Sphere(float r, bool euclideanDistance) : mEuclideanDistance(euclideanDistance)
 {
@@ -36,3 +37,49 @@ float Sphere::getValue(float x, float y, float z) const
   return value;
 }
 
+float Sphere::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const
+{
+  // With q = M p in object space, |q|^2 has gradient 2q and Hessian 2I, and
+  // |q| has gradient q/|q| and Hessian (I - q q^T/|q|^2)/|q|. The Laplacian in
+  // world space of a Hessian H in object space is trace(M^T H M)
+  Vector4<float> vprim, v = Vector4<float>(x, y, z, 1.f);
+  vprim = mWorld2Obj*v;
+  const Vector3<float> q(vprim[0], vprim[1], vprim[2]);
+  const float scale = getWorld2ObjRowNorm(0) + getWorld2ObjRowNorm(1) + getWorld2ObjRowNorm(2);
+
+  if (mEuclideanDistance){
+    const float length = q.length();
+    gradient = gradientObj2World(q / length);
+    curvature = (scale - gradient.norm()) / length;
+    return sqrt(vprim[0]*vprim[0] + vprim[1]*vprim[1] + vprim[2]*vprim[2]) - sqrt(radius2);
+  }
+
+  gradient = gradientObj2World(q * 2.f);
+  curvature = 2.f*scale;
+  return (vprim*vprim - 1.f - radius2);
+}
+
+void Sphere::compile(ImplicitProgram & program) const
+{
+  if (mEuclideanDistance)
+    program.addDistanceSphere(mWorld2Obj, sqrt(radius2));
+  else
+    program.addSphere(mWorld2Obj, radius2);
+}
+
+bool Sphere::getValueBound(float & a, float & b) const
+{
+  // A point d outside the box is at least d/scale from the sphere in object space
+  const float s = 1.f / getTransformScale();
+  if (mEuclideanDistance) {
+    a = 0;
+    b = s;
+  }
+  else {
+    // (r + d*s)^2 - r^2
+    a = s*s;
+    b = 2*sqrt(radius2)*s;
+  }
+  return true;
+}
+
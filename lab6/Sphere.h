@@ -20,6 +20,10 @@ public:
   Sphere(float r, bool euclideanDistance = false);
   virtual ~Sphere();
   virtual float getValue(float x, float y, float z) const;
+  virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const;
+  virtual Vector3<float> getGradient(float x, float y, float z, float delta = 1e-3) const { return getDerivativesGradient(x, y, z, delta); }
+  virtual bool getValueBound(float & a, float & b) const;
+  virtual void compile(ImplicitProgram & program) const;
 
 protected:
   float radius2;
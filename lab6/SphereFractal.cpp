@@ -64,6 +64,7 @@ SphereFractal::SphereFractal(int level)
 
 	// Building fractal
 	mFractal = buildFractal();
+	mBVH = new BVHUnion(mFractal);
 
 	// Setting bounding box for sphere fractal object
 	Bbox box = mFractal->getBoundingBox();
@@ -80,6 +81,7 @@ SphereFractal::SphereFractal(int level)
 
 SphereFractal::~SphereFractal()
 	{
+	delete mBVH;
 	for (unsigned int i = 0; i < mSpheres.size(); i++){
 		delete mSpheres[i];
 		}
@@ -98,6 +100,11 @@ Implicit*  SphereFractal::buildFractal()
 
 float SphereFractal::getValue(float x, float y, float z) const
 	{
-	return mFractal->getValue(x,y,z);
+	return mBVH->getValue(x,y,z);
+	}
+
+float SphereFractal::getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta) const
+	{
+	return mBVH->getValueAndDerivatives(x,y,z, gradient, curvature, delta);
 	}
 
@@ -6,6 +6,7 @@
 #include "Matrix4x4.h"
 #include "Sphere.h"
 #include "CSG.h"
+#include "BVHUnion.h"
 #include "Bbox.h"
 #include "Geometry.h"
 
@@ -19,6 +20,8 @@ class SphereFractal : public Implicit {
     ~SphereFractal();
 
     virtual float getValue(float x, float y, float z) const;
+    virtual float getValueAndDerivatives(float x, float y, float z, Vector3<float> & gradient, float & curvature, float delta = 1e-3) const;
+    virtual Vector3<float> getGradient(float x, float y, float z, float delta = 1e-3) const { return getDerivativesGradient(x, y, z, delta); }
 
     //! Builds the fractal. Returns a pointer to an implicit geometry object.
     Implicit* buildFractal();
@@ -26,6 +29,8 @@ class SphereFractal : public Implicit {
   private:
     std::vector<Implicit*> mSpheres;
     Implicit* mFractal;
+    //! Evaluates mFractal, skipping the spheres too far away to contribute
+    BVHUnion* mBVH;
 
 	float p;
 
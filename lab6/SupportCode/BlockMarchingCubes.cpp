@@ -0,0 +1,171 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#include "BlockMarchingCubes.h"
+#include "Hashtable.h"
+#include <algorithm>
+#include <cmath>
+
+int BlockMarchingCubes::update(LevelSetGrid & grid, const Function3D<Vector3<float> > * gradients)
+{
+  // A grid of another size has other blocks, start over
+  bool all = false;
+  if (grid.getDimX() != mDimX || grid.getDimY() != mDimY || grid.getDimZ() != mDimZ) {
+    mDimX = grid.getDimX();  mDimY = grid.getDimY();  mDimZ = grid.getDimZ();
+    mBlocksX = grid.getBlocksX();  mBlocksY = grid.getBlocksY();  mBlocksZ = grid.getBlocksZ();
+    mBlocks.assign(mBlocksX*mBlocksY*mBlocksZ, IndexedMesh());
+    all = true;
+  }
+  // All blocks have normals, or none
+  if ((gradients != NULL) != mNormals) {
+    mNormals = gradients != NULL;
+    all = true;
+  }
+
+  std::vector<int> blocks;
+  for (int b = 0; b < (int)mBlocks.size(); b++)
+    if (all || usesDirtyBlock(grid, b / (mBlocksY*mBlocksZ), b / mBlocksZ % mBlocksY, b % mBlocksZ))
+      blocks.push_back(b);
+
+  // Each block has its own mesh, so the blocks can be extracted from different threads
+  const int count = blocks.size();
+#pragma omp parallel for schedule(dynamic) num_threads(MarchingCubes::getNumThreads())
+  for (int n = 0; n < count; n++) {
+    const int b = blocks[n];
+    extract(grid, b / (mBlocksY*mBlocksZ), b / mBlocksZ % mBlocksY, b % mBlocksZ, gradients, mBlocks[b]);
+  }
+
+  grid.clearDirtyBlocks();
+  return count;
+}
+
+
+bool BlockMarchingCubes::usesDirtyBlock(const LevelSetGrid & grid, int bi, int bj, int bk)
+{
+  // The central differentials at the corners of the cells reach one grid point
+  // into the previous block
+  const int ei = std::min(bi+1, grid.getBlocksX()-1);
+  const int ej = std::min(bj+1, grid.getBlocksY()-1);
+  const int ek = std::min(bk+1, grid.getBlocksZ()-1);
+  for (int i = std::max(bi-1, 0); i <= ei; i++)
+    for (int j = std::max(bj-1, 0); j <= ej; j++)
+      for (int k = std::max(bk-1, 0); k <= ek; k++)
+        if (grid.isDirtyBlock(i,j,k)) return true;
+  return false;
+}
+
+
+void BlockMarchingCubes::extract(const LevelSetGrid & grid, int bi, int bj, int bk,
+                                 const Function3D<Vector3<float> > * gradients, IndexedMesh & mesh)
+{
+  mesh.mVerts.clear();
+  mesh.mIndices.clear();
+  mesh.mNormals.clear();
+
+  // Cells whose corners are all in constant blocks on the same side of the
+  // interface have no triangles, which is most blocks away from the interface
+  const int ei = std::min(bi+1, grid.getBlocksX()-1);
+  const int ej = std::min(bj+1, grid.getBlocksY()-1);
+  const int ek = std::min(bk+1, grid.getBlocksZ()-1);
+  int inside = 0, outside = 0;
+  for (int i = bi; i <= ei; i++)
+    for (int j = bj; j <= ej; j++)
+      for (int k = bk; k <= ek; k++) {
+        float value;
+        if (!grid.isConstantBlock(i,j,k, value)) inside = outside = 1;
+        else if (value < 0.f) inside = 1;
+        else outside = 1;
+      }
+  if (!inside || !outside) return;
+
+  // The cells of the block, the last block along an axis has one cell less
+  // than grid points
+  const int B = LevelSetGrid::getBlockDim();
+  const int i0 = bi*B, j0 = bj*B, k0 = bk*B;
+  const int i1 = std::min(i0 + B, grid.getDimX()-1);
+  const int j1 = std::min(j0 + B, grid.getDimY()-1);
+  const int k1 = std::min(k0 + B, grid.getDimZ()-1);
+  if (i1 <= i0 || j1 <= j0 || k1 <= k0) return;
+
+  std::vector<float> xs, ys, zs;
+  for (int i = i0; i <= i1; i++) xs.push_back(i);
+  for (int j = j0; j <= j1; j++) ys.push_back(j);
+  for (int k = k0; k <= k1; k++) zs.push_back(k);
+  MarchingCubes marchingCubes(xs, ys, zs, 1.f, mesh);
+  marchingCubes.setGradients(gradients);
+
+  // The values at two x slabs of corners
+  const int sizeY = ys.size(), sizeZ = zs.size();
+  std::vector<float> slab0(sizeY*sizeZ), slab1(sizeY*sizeZ);
+  for (int j = 0; j < sizeY; j++)
+    for (int k = 0; k < sizeZ; k++)
+      slab0[j*sizeZ + k] = grid.getValue(i0, j0+j, k0+k);
+
+  for (int i = i0; i < i1; i++) {
+    for (int j = 0; j < sizeY; j++)
+      for (int k = 0; k < sizeZ; k++)
+        slab1[j*sizeZ + k] = grid.getValue(i+1, j0+j, k0+k);
+    marchingCubes.addSlab(i - i0, &slab0[0], &slab1[0]);
+    slab0.swap(slab1);
+  }
+}
+
+
+void BlockMarchingCubes::getMesh(IndexedMesh & mesh) const
+{
+  mesh.mVerts.clear();
+  mesh.mIndices.clear();
+  mesh.mNormals.clear();
+
+  // The vertices on the planes between blocks, by the grid edge they are on,
+  // or the grid corner. Their coordinates are whole numbers except along the
+  // edge, so the edge is the corner below the vertex and the axis it is not
+  // whole along, with axis 3 for a corner
+  const int B = LevelSetGrid::getBlockDim();
+  EdgeHashTable shared;
+  std::vector<unsigned int> remap;
+
+  for (unsigned int b = 0; b < mBlocks.size(); b++) {
+    const IndexedMesh & block = mBlocks[b];
+    remap.resize(block.mVerts.size());
+
+    for (unsigned int v = 0; v < block.mVerts.size(); v++) {
+      const Vector3<float> & p = block.mVerts[v];
+      remap[v] = mesh.mVerts.size();
+
+      bool onFace = false;
+      unsigned long long axis = 3;
+      int corner[3];
+      for (unsigned int a = 0; a < 3; a++) {
+        corner[a] = (int)std::floor(p[a]);
+        if (p[a] != corner[a]) axis = a;
+        else if (corner[a] % B == 0) onFace = true;
+      }
+
+      if (onFace) {
+        const unsigned long long key =
+          ((((unsigned long long)corner[0]*mDimY + corner[1])*mDimZ + corner[2]) << 2) | axis;
+        EdgeHashTable::iterator found = shared.find(key);
+        if (found != shared.end()) {
+          remap[v] = found->second;
+          continue;
+        }
+        shared[key] = remap[v];
+      }
+      mesh.mVerts.push_back(p);
+      if (!block.mNormals.empty())
+        mesh.mNormals.push_back(block.mNormals[v]);
+    }
+
+    for (unsigned int n = 0; n < block.mIndices.size(); n++)
+      mesh.mIndices.push_back(remap[block.mIndices[n]]);
+  }
+}
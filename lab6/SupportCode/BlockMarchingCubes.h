@@ -0,0 +1,72 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#ifndef __block_marching_cubes_h__
+#define __block_marching_cubes_h__
+
+#include "MarchingCubes.h"
+#include "LevelSetGrid.h"
+#include "Function3D.h"
+#include <vector>
+
+/*! \brief Marching cubes mesh of a LevelSetGrid, kept block by block
+ *
+ * The cells of the grid, one per grid cell, are split into the blocks of the
+ * grid, and the triangles of each block are kept in their own IndexedMesh. The
+ * cells of a block have their corners in the block and in the next block along
+ * each axis, and the differentials for the normals at their vertices also read
+ * the previous block. update() re-extracts a block only if one of those grid
+ * blocks is dirty (LevelSetGrid::isDirtyBlock). The cost of an update then
+ * follows the part of the interface that moved instead of the whole surface.
+ *
+ * The vertices are in grid coordinates. A vertex on the face between two
+ * blocks is on the same grid edge, or at the same grid corner, in both, so
+ * getMesh() welds them by the index of that edge.
+ */
+class BlockMarchingCubes
+{
+public :
+  BlockMarchingCubes() : mDimX(0), mDimY(0), mDimZ(0), mBlocksX(0), mBlocksY(0), mBlocksZ(0), mNormals(false) { }
+
+  /*!
+   * Re-extracts the blocks that use a dirty block of grid, or all of them if
+   * the grid changed size or gradients changed between NULL and not, and
+   * clears the dirty flags of grid. Returns the number of blocks extracted.
+   * The blocks are extracted in parallel, with the threads of
+   * MarchingCubes::getNumThreads(). If gradients is not NULL the vertices get
+   * normals, see MarchingCubes::setGradients(), with gradients taking grid
+   * coordinates.
+   */
+  int update(LevelSetGrid & grid, const Function3D<Vector3<float> > * gradients = NULL);
+
+  //! Joins the triangles and normals of all blocks into mesh, in grid coordinates
+  void getMesh(IndexedMesh & mesh) const;
+
+  //! Number of blocks, extracted or not
+  int getNumBlocks() const { return mBlocks.size(); }
+
+protected :
+  //! Extracts the cells of block (bi,bj,bk) of grid into mesh
+  static void extract(const LevelSetGrid & grid, int bi, int bj, int bk,
+                      const Function3D<Vector3<float> > * gradients, IndexedMesh & mesh);
+  //! Returns true if the cells of block (bi,bj,bk) use a dirty block of grid
+  static bool usesDirtyBlock(const LevelSetGrid & grid, int bi, int bj, int bk);
+
+  //! The triangles of each block, in the order of the blocks of the grid
+  std::vector<IndexedMesh> mBlocks;
+  //! Number of grid points along each axis, and of blocks
+  int mDimX, mDimY, mDimZ;
+  int mBlocksX, mBlocksY, mBlocksZ;
+  //! True if the blocks were extracted with normals
+  bool mNormals;
+};
+
+#endif
@@ -85,19 +85,23 @@ bool DecimationMesh::decimate()
   if (mFaces.size() - mNumCollapsedFaces == 2) return false;
 
   unsigned int e1 = collapse->halfEdge;
-  unsigned int e2 = mEdges[e1].pair;
+  unsigned int e2 = pair(e1);
+
+  // The other half-edges of the two faces, which are moved around below
+  unsigned int n1 = mEdges[e1].next, p1 = prev(e1);
+  unsigned int n2 = mEdges[e2].next, p2 = prev(e2);
 
   unsigned int v1 = mEdges[e1].vert;
   unsigned int v2 = mEdges[e2].vert;
-  unsigned int v3 = mEdges[mEdges[e1].prev].vert;
-  unsigned int v4 = mEdges[mEdges[e2].prev].vert;
+  unsigned int v3 = mEdges[p1].vert;
+  unsigned int v4 = mEdges[p2].vert;
 
   unsigned int f1 = mEdges[e1].face;
   unsigned int f2 = mEdges[e2].face;
 
   std::cout << "Collapsing faces " << f1 << " and " << f2 << std::endl;
-  std::cout << "Collapsing edges " << e1 << ", " << mEdges[e1].next << ", " << mEdges[e1].prev;
-  std::cout << ", " << e2 << ", " << mEdges[e2].next << " and " << mEdges[e2].prev << std::endl;
+  std::cout << "Collapsing edges " << e1 << ", " << n1 << ", " << p1;
+  std::cout << ", " << e2 << ", " << n2 << " and " << p2 << std::endl;
   std::cout << "Collapsing vertex " << v1 << std::endl;
 
 
@@ -115,46 +119,43 @@ bool DecimationMesh::decimate()
   unsigned int edge = mVerts[v1].edge;
   do {
     mEdges[edge].vert = v2;
-    edge = mEdges[mEdges[edge].pair].next;
+    edge = mEdges[pair(edge)].next;
   } while (edge != mVerts[v1].edge);
 
   // Make sure v2 points to a valid edge
   while (mEdges[mVerts[v2].edge].face == f1 || mEdges[mVerts[v2].edge].face == f2)
-    mVerts[v2].edge = mEdges[mEdges[ mVerts[v2].edge ].pair].next;
+    mVerts[v2].edge = mEdges[pair(mVerts[v2].edge)].next;
 
   // Make sure v3 points to a valid edge
   while (mEdges[mVerts[v3].edge].face == f1)
-    mVerts[v3].edge = mEdges[mEdges[ mVerts[v3].edge ].pair].next;
+    mVerts[v3].edge = mEdges[pair(mVerts[v3].edge)].next;
 
   // Make sure v4 points to a valid edge
   while (mEdges[mVerts[v4].edge].face == f2)
-    mVerts[v4].edge = mEdges[mEdges[ mVerts[v4].edge ].pair].next;
-
-  // Redirect pair pointers
-  mEdges[mEdges[mEdges[e1].next].pair].pair = mEdges[mEdges[e1].prev].pair;
-  mEdges[mEdges[mEdges[e1].prev].pair].pair = mEdges[mEdges[e1].next].pair;
+    mVerts[v4].edge = mEdges[pair(mVerts[v4].edge)].next;
 
-  mEdges[mEdges[mEdges[e2].next].pair].pair = mEdges[mEdges[e2].prev].pair;
-  mEdges[mEdges[mEdges[e2].prev].pair].pair = mEdges[mEdges[e2].next].pair;
+  // Pair up the outer half-edges of the collapsed faces. The pairs are
+  // implicit, so the pair of p1 takes the place of n1, next to the pair of
+  // n1, and the pair of n2 takes the place of p2
+  const unsigned int b = pair(p1), c = pair(n2);
+  moveHalfEdge(b, n1);
+  moveHalfEdge(c, p2);
 
   // Move v2 to its new position
-  mVerts[v2].vec = collapse->position;
+  mVertPositions[v2] = collapse->position;
 
   // One edge collapse further removes 2 additional collapse
   // candidates from the heap
-  if (mHalfEdge2EdgeCollapse[mEdges[e1].prev] != NULL)
-    delete mHeap.remove(mHalfEdge2EdgeCollapse[mEdges[e1].prev]);
-  mHalfEdge2EdgeCollapse[mEdges[mEdges[e1].prev].pair] = mHalfEdge2EdgeCollapse[mEdges[e1].next];
-
-  if (mHalfEdge2EdgeCollapse[mEdges[e2].next] != NULL)
-    delete mHeap.remove(mHalfEdge2EdgeCollapse[mEdges[e2].next]);
-  mHalfEdge2EdgeCollapse[mEdges[mEdges[e2].next].pair] = mHalfEdge2EdgeCollapse[mEdges[e2].prev];
+  if (mHalfEdge2EdgeCollapse[p1] != NULL)
+    delete mHeap.remove(mHalfEdge2EdgeCollapse[p1]);
+  if (mHalfEdge2EdgeCollapse[n2] != NULL)
+    delete mHeap.remove(mHalfEdge2EdgeCollapse[n2]);
 
   // Make sure the edge collapses point to valid edges
-  if (mHalfEdge2EdgeCollapse[mEdges[e1].next] != NULL)
-    mHalfEdge2EdgeCollapse[mEdges[e1].next]->halfEdge = mEdges[mEdges[e1].prev].pair;
-  if (mHalfEdge2EdgeCollapse[mEdges[e2].prev] != NULL)
-    mHalfEdge2EdgeCollapse[mEdges[e2].prev]->halfEdge = mEdges[mEdges[e2].next].pair;
+  if (mHalfEdge2EdgeCollapse[n1] != NULL)
+    mHalfEdge2EdgeCollapse[n1]->halfEdge = n1;
+  if (mHalfEdge2EdgeCollapse[p2] != NULL)
+    mHalfEdge2EdgeCollapse[p2]->halfEdge = p2;
 
   delete collapse;
 
@@ -163,12 +164,12 @@ bool DecimationMesh::decimate()
   collapseFace(f2);
 
   collapseEdge(e1);
-  collapseEdge(mEdges[e1].next);
-  collapseEdge(mEdges[e1].prev);
+  collapseEdge(p1);
+  collapseEdge(b);
 
   collapseEdge(e2);
-  collapseEdge(mEdges[e2].next);
-  collapseEdge(mEdges[e2].prev);
+  collapseEdge(n2);
+  collapseEdge(c);
 
   collapseVertex(v1);
 
@@ -178,7 +179,7 @@ bool DecimationMesh::decimate()
   edge = mVerts[v2].edge;
   do {
     unsigned int face = mEdges[edge].face;
-    unsigned int vert = mEdges[mEdges[edge].pair].vert;
+    unsigned int vert = mEdges[pair(edge)].vert;
     if (!isFaceCollapsed(face))    updateFaceProperties(face);
     if (!isVertexCollapsed(vert))  updateVertexProperties(vert);
 
@@ -187,7 +188,7 @@ bool DecimationMesh::decimate()
       if (!isValidCollapse(collapse)) {
         delete mHeap.remove(collapse);
         mHalfEdge2EdgeCollapse[edge] = NULL;
-        mHalfEdge2EdgeCollapse[mEdges[edge].pair] = NULL;
+        mHalfEdge2EdgeCollapse[pair(edge)] = NULL;
         std::cout << "Removed one invalid edge collapse" << std::endl;
       }
       else {
@@ -196,7 +197,7 @@ bool DecimationMesh::decimate()
       }
     }
 
-    edge = mEdges[mEdges[edge].pair].next;
+    edge = mEdges[pair(edge)].next;
   } while (edge != mVerts[v2].edge);
 
 
@@ -221,13 +222,13 @@ void DecimationMesh::updateVertexProperties(unsigned int ind)
     // Calculate face normal
     HalfEdge* edge = &mEdges[triangle.edge];
 
-    Vector3<float>& p0 = mVerts[edge->vert].vec;
+    Vector3<float>& p0 = mVertPositions[edge->vert];
     edge = &mEdges[edge->next];
 
-    Vector3<float>& p1 = mVerts[edge->vert].vec;
+    Vector3<float>& p1 = mVertPositions[edge->vert];
     edge = &mEdges[edge->next];
 
-    Vector3<float>& p2 = mVerts[edge->vert].vec;
+    Vector3<float>& p2 = mVertPositions[edge->vert];
 
     Vector3<float> v1 = p1-p0;
     Vector3<float> v2 = p2-p0;
@@ -238,7 +239,7 @@ void DecimationMesh::updateVertexProperties(unsigned int ind)
   }
 
   n.normalize();
-  mVerts[ind].normal = n;
+  mVertNormals[ind] = n;
 }
 
 
@@ -246,13 +247,13 @@ void DecimationMesh::updateFaceProperties(unsigned int ind)
 {
   HalfEdge* edge = &mEdges[mFaces[ind].edge];
 
-  Vector3<float>& p0 = mVerts[edge->vert].vec;
+  Vector3<float>& p0 = mVertPositions[edge->vert];
   edge = &mEdges[edge->next];
 
-  Vector3<float>& p1 = mVerts[edge->vert].vec;
+  Vector3<float>& p1 = mVertPositions[edge->vert];
   edge = &mEdges[edge->next];
 
-  Vector3<float>& p2 = mVerts[edge->vert].vec;
+  Vector3<float>& p2 = mVertPositions[edge->vert];
 
   // Calculate face normal
   Vector3<float> v1 = p1-p0;
@@ -260,19 +261,19 @@ void DecimationMesh::updateFaceProperties(unsigned int ind)
   Vector3<float> n = cross(v1,v2);
   n.normalize();
 
-  mFaces[ind].normal = n;
+  mFaceNormals[ind] = n;
 }
 
 
 bool DecimationMesh::isValidCollapse(EdgeCollapse * collapse)
 {
   unsigned int e1 = collapse->halfEdge;
-  unsigned int e2 = mEdges[e1].pair;
+  unsigned int e2 = pair(e1);
 
   unsigned int v1 = mEdges[e1].vert;
   unsigned int v2 = mEdges[e2].vert;
-  unsigned int v3 = mEdges[mEdges[e1].prev].vert;
-  unsigned int v4 = mEdges[mEdges[e2].prev].vert;
+  unsigned int v3 = mEdges[prev(e1)].vert;
+  unsigned int v4 = mEdges[prev(e2)].vert;
 
   // Do a dummy check
   if (isEdgeCollapsed(e1) || isEdgeCollapsed(e1) || isVertexCollapsed(v1) || isVertexCollapsed(v2)) return false;
@@ -280,25 +281,38 @@ bool DecimationMesh::isValidCollapse(EdgeCollapse * collapse)
   unsigned int edge = mVerts[v2].edge;
   std::vector<unsigned int> neighbors;
   do {
-    unsigned int ind = mEdges[mEdges[edge].pair].vert;
+    unsigned int ind = mEdges[pair(edge)].vert;
     if (ind != v3 && ind != v4)
       neighbors.push_back(ind);
-    edge = mEdges[mEdges[edge].pair].next;
+    edge = mEdges[pair(edge)].next;
   } while (edge != mVerts[v2].edge);
 
   edge = mVerts[v1].edge;
   do {
-    unsigned int ind = mEdges[mEdges[edge].pair].vert;
+    unsigned int ind = mEdges[pair(edge)].vert;
     if (find(neighbors.begin(), neighbors.end(), ind) != neighbors.end())
       return false;
 
-    edge = mEdges[mEdges[edge].pair].next;
+    edge = mEdges[pair(edge)].next;
   } while (edge != mVerts[v1].edge);
 
   return true;
 }
 
 
+void DecimationMesh::moveHalfEdge(unsigned int from, unsigned int to)
+{
+  const unsigned int before = prev(from);
+  mEdges[to] = mEdges[from];
+  mEdges[before].next = to;
+
+  if (mFaces[mEdges[to].face].edge == from)
+    mFaces[mEdges[to].face].edge = to;
+  if (mVerts[mEdges[to].vert].edge == from)
+    mVerts[mEdges[to].vert].edge = to;
+}
+
+
 
 
 //-----------------------------------------------------------------------------
@@ -326,11 +340,11 @@ void DecimationMesh::draw()
 
     // Render without notations
     HalfEdge* edge = &mEdges[mFaces[i].edge];
-    Vector3<float>& p0 = mVerts[edge->vert].vec;
+    Vector3<float>& p0 = mVertPositions[edge->vert];
     edge = &mEdges[edge->next];
-    Vector3<float>& p1 = mVerts[edge->vert].vec;
+    Vector3<float>& p1 = mVertPositions[edge->vert];
     edge = &mEdges[edge->next];
-    Vector3<float>& p2 = mVerts[edge->vert].vec;
+    Vector3<float>& p2 = mVertPositions[edge->vert];
 
 
     // Render with notations
@@ -342,18 +356,18 @@ void DecimationMesh::draw()
 
 	// draw face
 	sprintf(buffer, "f%i\n", i);
-	Vector3<float> vec = (mVerts[edge->vert].vec + mVerts[mEdges[edge->pair].vert].vec)*0.5;
-	vec += 0.5 * (mVerts[mEdges[edge->prev].vert].vec - vec);
+	Vector3<float> vec = (mVertPositions[edge->vert] + mVertPositions[mEdges[pair(edge - &mEdges[0])].vert])*0.5;
+	vec += 0.5 * (mVertPositions[mEdges[prev(edge - &mEdges[0])].vert] - vec);
 	GUI::drawText(vec, buffer);
 
 	// draw e1
 	sprintf(buffer, "e%i\n", mFaces[i].edge);
-	vec = (mVerts[edge->vert].vec + mVerts[mEdges[edge->pair].vert].vec)*0.5;
-	vec += 0.1 * (mVerts[mEdges[edge->prev].vert].vec - vec);
+	vec = (mVertPositions[edge->vert] + mVertPositions[mEdges[pair(edge - &mEdges[0])].vert])*0.5;
+	vec += 0.1 * (mVertPositions[mEdges[prev(edge - &mEdges[0])].vert] - vec);
 	GUI::drawText(vec, buffer);
 
 	// draw v1
-	Vector3<float>& p0 = mVerts[edge->vert].vec;
+	Vector3<float>& p0 = mVertPositions[edge->vert];
 	sprintf(buffer, "v%i\n", edge->vert);
 	GUI::drawText(vec, buffer);
 
@@ -361,12 +375,12 @@ void DecimationMesh::draw()
 	edge = &mEdges[edge->next];
 
 	// draw e2
-	vec = (mVerts[edge->vert].vec + mVerts[mEdges[edge->pair].vert].vec)*0.5;
-	vec += 0.1 * (mVerts[mEdges[edge->prev].vert].vec - vec);
+	vec = (mVertPositions[edge->vert] + mVertPositions[mEdges[pair(edge - &mEdges[0])].vert])*0.5;
+	vec += 0.1 * (mVertPositions[mEdges[prev(edge - &mEdges[0])].vert] - vec);
 	GUI::drawText(vec, buffer);
 
 	// draw v2
-	Vector3<float>& p1 = mVerts[edge->vert].vec;
+	Vector3<float>& p1 = mVertPositions[edge->vert];
 	sprintf(buffer, "v%i\n", edge->vert);
 	GUI::drawText(vec, buffer);
 
@@ -374,12 +388,12 @@ void DecimationMesh::draw()
 	edge = &mEdges[edge->next];
 
 	// draw e3
-	vec = (mVerts[edge->vert].vec + mVerts[mEdges[edge->pair].vert].vec)*0.5;
-	vec += 0.1 * (mVerts[mEdges[edge->prev].vert].vec - vec);
+	vec = (mVertPositions[edge->vert] + mVertPositions[mEdges[pair(edge - &mEdges[0])].vert])*0.5;
+	vec += 0.1 * (mVertPositions[mEdges[prev(edge - &mEdges[0])].vert] - vec);
 	GUI::drawText(vec, buffer);
 
 	// draw v3
-	Vector3<float>& p2 = mVerts[edge->vert].vec;
+	Vector3<float>& p2 = mVertPositions[edge->vert];
 	sprintf(buffer, "v%i\n", edge->vert);
 	GUI::drawText(vec, buffer);
     */
@@ -387,7 +401,7 @@ void DecimationMesh::draw()
 
     glBegin(GL_TRIANGLES);
     if (getShadingFlag() == FLAT_SHADING){
-      Vector3<float>& n = mFaces[i].normal;
+      Vector3<float>& n = mFaceNormals[i];
       Vector3<float> color = colorMap.map(n, -1, 1);
 
       glColor3f(color[0],color[1], color[2]);
@@ -405,13 +419,13 @@ void DecimationMesh::draw()
 
       edge = &mEdges[mFaces[i].edge];
 
-      n0 = mVerts[edge->vert].normal;
+      n0 = mVertNormals[edge->vert];
       edge = &mEdges[edge->next];
 
-      n1 = mVerts[edge->vert].normal;
+      n1 = mVertNormals[edge->vert];
       edge = &mEdges[edge->next];
 
-      n2 = mVerts[edge->vert].normal;
+      n2 = mVertNormals[edge->vert];
 
       // Color mapping, maps the normal components to R,G,B. From [-1, 1] to [0,1] respectively
       Vector3<float> color0 = colorMap.map(n0, -1, 1);
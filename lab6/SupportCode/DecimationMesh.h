@@ -47,6 +47,13 @@ protected :
 
   bool isValidCollapse(EdgeCollapse * collapse);
 
+  /*!
+   * Moves half-edge from to the unused slot to, so that it pairs with the
+   * half-edge next to that slot, and points its face, vertex and previous
+   * half-edge to the new slot
+   */
+  void moveHalfEdge(unsigned int from, unsigned int to);
+
   inline bool isVertexCollapsed(unsigned int ind) { return mCollapsedVerts[ind]; }
   inline bool isEdgeCollapsed(unsigned int ind) { return mCollapsedEdges[ind]; }
   inline bool isFaceCollapsed(unsigned int ind) { return mCollapsedFaces[ind]; }
@@ -22,6 +22,13 @@ public:
 	virtual T getValue(float x, float y, float z) const = 0;
 	virtual T getValue(int i, int j, int k) const = 0;
 
+	//! Evaluate the function at the count points (x[n], y[n], z[n])
+	virtual void getValues(const float * x, const float * y, const float * z, T * values, int count) const
+		{
+		for (int n = 0; n < count; n++)
+			values[n] = getValue(x[n], y[n], z[n]);
+		}
+
 	//! Return a bound on the maximum value of the function
 	virtual T getMaxValue() const = 0;
 	virtual ~Function3D() {}
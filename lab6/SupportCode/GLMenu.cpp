@@ -3,6 +3,7 @@
 #include "GL/glut.h"
 
 #include "Vector3.h"
+#include <cstring>
 
 
 #define DEFAULT_WINDOW_HEIGHT 768
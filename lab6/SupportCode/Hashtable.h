@@ -1,693 +1,166 @@
-#pragma once
-
-#include <hash_map>
-
-#include <stdio.h>      /* defines printf for tests */
-#include "stdint.h"     /* defines uint32_t etc */
-
-//
-//hash_map::begin
-//hash_map::clear
-//hash_map::count
-//hash_map::empty
-//hash_map::end
-//hash_map::equal_range
-//hash_map::erase
-//hash_map::find
-//hash_map::get_allocator
-//hash_map::hash_map
-//hash_map::insert
-//hash_map::key_compare
-//hash_map::lower_bound
-//hash_map::max_size
-//hash_map::rbegin
-//hash_map::rend
-//hash_map::size
-//hash_map::swap
-//hash_map::upper_bound
-//hash_map::value_comp
-
-/*
-//EXAMPLE USAGE:
-//-------------------------
-THashTable hash;
-
-TSquare key1={1,1,1};
-float value1=0.5f;
-pair<TSquare, float> item = make_pair( key1, value1);
-hash.insert( item );
-
-TSquare key2={5,4,3};
-float value2=123.56f;
-pair<TSquare, float> item2 = make_pair( key2, value2);
-hash.insert( item2 );
-
-TSquare key3={10,15,21};
-float value3=8.12878784132;
-pair<TSquare, float> item3 = make_pair( key3, value3);
-hash.insert( item3 );
-
-TSquare x={10,15,21};
-THashTable::iterator it = hash.find( x );
-
-if ( it == hash.end( ) )
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#ifndef __hashtable_h__
+#define __hashtable_h__
+
+#include <vector>
+#include <cstring>
+#include "Vector3.h"
+
+/*! \brief Hash map with open addressing and linear probing
+ *
+ * The entries are kept in a single array of slots. A key is looked for from
+ * the slot its hash selects and on through the following slots, up to the
+ * first empty one, so a lookup mostly reads one cache line instead of
+ * following the nodes of a bucket list. The number of slots is a power of two,
+ * at least twice the number of entries. Entries can't be erased.
+ *
+ * Hasher returns the hash of a key from operator(). The keys are compared with
+ * operator==, and the low bits of the hash select the slot, so they must be
+ * well mixed.
+ */
+template <class Key, class Value, class Hasher>
+class OpenHashTable
 {
-cout << "The hash_map doesn't have an element ";
-}
-else
+public :
+  struct Entry {
+    Entry() : first(), second(), used(false) { }
+    Key first;
+    Value second;
+    bool used;
+  };
+
+  //! Iterates over the used slots
+  class iterator
+  {
+  public :
+    iterator(Entry * entry, Entry * end) : mEntry(entry), mEnd(end) { skip(); }
+
+    Entry & operator*() const { return *mEntry; }
+    Entry * operator->() const { return mEntry; }
+    iterator & operator++() { mEntry++; skip(); return *this; }
+    bool operator==(const iterator & it) const { return mEntry == it.mEntry; }
+    bool operator!=(const iterator & it) const { return mEntry != it.mEntry; }
+
+  protected :
+    void skip() { while (mEntry != mEnd && !mEntry->used) mEntry++; }
+    Entry * mEntry, * mEnd;
+  };
+
+  OpenHashTable() : mSize(0) { }
+
+  iterator begin() { return iterator(data(), data() + mEntries.size()); }
+  iterator end() { return iterator(data() + mEntries.size(), data() + mEntries.size()); }
+
+  //! Returns the entry of key, or end()
+  iterator find(const Key & key) {
+    if (mEntries.empty()) return end();
+    Entry & entry = mEntries[slot(key)];
+    return entry.used ? iterator(&entry, data() + mEntries.size()) : end();
+  }
+
+  //! Returns the value of key, adding it with a default value if it's not there
+  Value & operator[](const Key & key) {
+    // reserve() doubles the slots when they get half full
+    if (2*(mSize + 1) > mEntries.size())
+      reserve(mSize + 1);
+    Entry & entry = mEntries[slot(key)];
+    if (!entry.used) {
+      entry.first = key;
+      entry.used = true;
+      mSize++;
+    }
+    return entry.second;
+  }
+
+  //! Makes room for count entries without rehashing
+  void reserve(unsigned int count) {
+    unsigned int slots = MIN_SLOTS;
+    while (slots < 2*count) slots *= 2;
+    if (slots > mEntries.size()) rehash(slots);
+  }
+
+  unsigned int size() const { return mSize; }
+  bool empty() const { return mSize == 0; }
+  void clear() { mEntries.clear(); mSize = 0; }
+
+protected :
+  static const unsigned int MIN_SLOTS = 16;
+
+  Entry * data() { return mEntries.empty() ? NULL : &mEntries[0]; }
+
+  //! Returns the slot of key, or the empty slot it would go in
+  unsigned int slot(const Key & key) const {
+    const unsigned int mask = mEntries.size() - 1;
+    unsigned int n = (unsigned int)mHasher(key) & mask;
+    while (mEntries[n].used && !(mEntries[n].first == key))
+      n = (n + 1) & mask;
+    return n;
+  }
+
+  //! Moves the entries to an array of slots slots
+  void rehash(unsigned int slots) {
+    std::vector<Entry> entries(slots);
+    entries.swap(mEntries);
+    for (unsigned int n = 0; n < entries.size(); n++)
+      if (entries[n].used)
+        mEntries[slot(entries[n].first)] = entries[n];
+  }
+
+  std::vector<Entry> mEntries;
+  unsigned int mSize;
+  Hasher mHasher;
+};
+
+
+//! Mixes the bits of h, so every bit of the result depends on every bit of h
+inline unsigned long long hashMix(unsigned long long h)
 {
-float c = (*it).second;
-TSquare d = (*it).first;
-std::cout << "[" << d.l << d.x << d.y << "] = " << c << std::endl;
+  // The finalizer of MurmurHash3
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
 }
-//-------------------------
-*/
-
-
-
-#define HASH_LITTLE_ENDIAN 1
-#define HASH_BIG_ENDIAN 0
-
-
-#define hashsize(n) ((uint32_t)1<<(n))
-#define hashmask(n) (hashsize(n)-1)
-#define rot(x,k) (((x)<<(k)) | ((x)>>(32-(k))))
-
-class VertexHasher : public stdext::hash_compare <Vector3<float>>
-	{
-	public:
-
-		//hash operator
-		size_t operator() (const Vector3<float>& s) const
-			{
-			return hashlittle( (void*)&s, sizeof(Vector3<float>), 0x12345678 );
-			}
-
-		//compare hash
-		bool operator() (const Vector3<float>& s1, const Vector3<float>& s2) const
-			{
-			return (s1 > s2);
-			}
-
-		//------------------------------------------------------------
-		// The following Extracted from 
-		// lookup3.c, by Bob Jenkins, May 2006, Public Domain.
-		//------------------------------------------------------------
-		/*
-		-------------------------------------------------------------------------------
-		mix -- mix 3 32-bit values reversibly.
-
-		This is reversible, so any information in (a,b,c) before mix() is
-		still in (a,b,c) after mix().
-
-		If four pairs of (a,b,c) inputs are run through mix(), or through
-		mix() in reverse, there are at least 32 bits of the output that
-		are sometimes the same for one pair and different for another pair.
-		This was tested for:
-		* pairs that differed by one bit, by two bits, in any combination
-		of top bits of (a,b,c), or in any combination of bottom bits of
-		(a,b,c).
-		* "differ" is defined as +, -, ^, or ~^.  For + and -, I transformed
-		the output delta to a Gray code (a^(a>>1)) so a string of 1's (as
-		is commonly produced by subtraction) look like a single 1-bit
-		difference.
-		* the base values were pseudorandom, all zero but one bit set, or 
-		all zero plus a counter that starts at zero.
-
-		Some k values for my "a-=c; a^=rot(c,k); c+=b;" arrangement that
-		satisfy this are
-		4  6  8 16 19  4
-		9 15  3 18 27 15
-		14  9  3  7 17  3
-		Well, "9 15 3 18 27 15" didn't quite get 32 bits diffing
-		for "differ" defined as + with a one-bit base and a two-bit delta.  I
-		used http://burtleburtle.net/bob/hash/avalanche.html to choose 
-		the operations, constants, and arrangements of the variables.
-
-		This does not achieve avalanche.  There are input bits of (a,b,c)
-		that fail to affect some output bits of (a,b,c), especially of a.  The
-		most thoroughly mixed value is c, but it doesn't really even achieve
-		avalanche in c.
-
-		This allows some parallelism.  Read-after-writes are good at doubling
-		the number of bits affected, so the goal of mixing pulls in the opposite
-		direction as the goal of parallelism.  I did what I could.  Rotates
-		seem to cost as much as shifts on every machine I could lay my hands
-		on, and rotates are much kinder to the top and bottom bits, so I used
-		rotates.
-		-------------------------------------------------------------------------------
-		*/
-#define mix(a,b,c) \
-			{ \
-			a -= c;  a ^= rot(c, 4);  c += b; \
-			b -= a;  b ^= rot(a, 6);  a += c; \
-			c -= b;  c ^= rot(b, 8);  b += a; \
-			a -= c;  a ^= rot(c,16);  c += b; \
-			b -= a;  b ^= rot(a,19);  a += c; \
-			c -= b;  c ^= rot(b, 4);  b += a; \
-				}
-
-		/*
-		-------------------------------------------------------------------------------
-		final -- final mixing of 3 32-bit values (a,b,c) into c
-
-		Pairs of (a,b,c) values differing in only a few bits will usually
-		produce values of c that look totally different.  This was tested for
-		* pairs that differed by one bit, by two bits, in any combination
-		of top bits of (a,b,c), or in any combination of bottom bits of
-		(a,b,c).
-		* "differ" is defined as +, -, ^, or ~^.  For + and -, I transformed
-		the output delta to a Gray code (a^(a>>1)) so a string of 1's (as
-		is commonly produced by subtraction) look like a single 1-bit
-		difference.
-		* the base values were pseudorandom, all zero but one bit set, or 
-		all zero plus a counter that starts at zero.
-
-		These constants passed:
-		14 11 25 16 4 14 24
-		12 14 25 16 4 14 24
-		and these came close:
-		4  8 15 26 3 22 24
-		10  8 15 26 3 22 24
-		11  8 15 26 3 22 24
-		-------------------------------------------------------------------------------
-		*/
-#define final(a,b,c) \
-			{ \
-			c ^= b; c -= rot(b,14); \
-			a ^= c; a -= rot(c,11); \
-			b ^= a; b -= rot(a,25); \
-			c ^= b; c -= rot(b,16); \
-			a ^= c; a -= rot(c,4);  \
-			b ^= a; b -= rot(a,14); \
-			c ^= b; c -= rot(b,24); \
-				}
-
-		/*
-		-------------------------------------------------------------------------------
-		hashlittle() -- hash a variable-length key into a 32-bit value
-		k       : the key (the unaligned variable-length array of bytes)
-		length  : the length of the key, counting by bytes
-		initval : can be any 4-byte value
-		Returns a 32-bit value.  Every bit of the key affects every bit of
-		the return value.  Two keys differing by one or two bits will have
-		totally different hash values.
-
-		The best hash table sizes are powers of 2.  There is no need to do
-		mod a prime (mod is sooo slow!).  If you need less than 32 bits,
-		use a bitmask.  For example, if you need only 10 bits, do
-		h = (h & hashmask(10));
-		In which case, the hash table should have hashsize(10) elements.
-
-		If you are hashing n strings (uint8_t **)k, do it like this:
-		for (i=0, h=0; i<n; ++i) h = hashlittle( k[i], len[i], h);
-
-		By Bob Jenkins, 2006.  bob_jenkins@burtleburtle.net.  You may use this
-		code any way you wish, private, educational, or commercial.  It's free.
-
-		Use for hash table lookup, or anything where one collision in 2^^32 is
-		acceptable.  Do NOT use for cryptographic purposes.
-		-------------------------------------------------------------------------------
-		*/
-
-		uint32_t hashlittle( const void *key, size_t length, uint32_t initval) const
-			{
-			uint32_t a,b,c;                                          /* internal state */
-			union { const void *ptr; size_t i; } u;     /* needed for Mac Powerbook G4 */
-
-			/* Set up the internal state */
-			a = b = c = 0xdeadbeef + ((uint32_t)length) + initval;
-
-			u.ptr = key;
-			if (HASH_LITTLE_ENDIAN && ((u.i & 0x3) == 0)) {
-				const uint32_t *k = (const uint32_t *)key;         /* read 32-bit chunks */
-				const uint8_t  *k8;
-
-				/*------ all but last block: aligned reads and affect 32 bits of (a,b,c) */
-				while (length > 12)
-					{
-					a += k[0];
-					b += k[1];
-					c += k[2];
-					mix(a,b,c);
-					length -= 12;
-					k += 3;
-					}
-
-				/*----------------------------- handle the last (probably partial) block */
-				/* 
-				* "k[2]&0xffffff" actually reads beyond the end of the string, but
-				* then masks off the part it's not allowed to read.  Because the
-				* string is aligned, the masked-off tail is in the same word as the
-				* rest of the string.  Every machine with memory protection I've seen
-				* does it on word boundaries, so is OK with this.  But VALGRIND will
-				* still catch it and complain.  The masking trick does make the hash
-				* noticably faster for short strings (like English words).
-				*/
-#ifndef VALGRIND
-
-				switch(length)
-					{
-					case 12: c+=k[2]; b+=k[1]; a+=k[0]; break;
-					case 11: c+=k[2]&0xffffff; b+=k[1]; a+=k[0]; break;
-					case 10: c+=k[2]&0xffff; b+=k[1]; a+=k[0]; break;
-					case 9 : c+=k[2]&0xff; b+=k[1]; a+=k[0]; break;
-					case 8 : b+=k[1]; a+=k[0]; break;
-					case 7 : b+=k[1]&0xffffff; a+=k[0]; break;
-					case 6 : b+=k[1]&0xffff; a+=k[0]; break;
-					case 5 : b+=k[1]&0xff; a+=k[0]; break;
-					case 4 : a+=k[0]; break;
-					case 3 : a+=k[0]&0xffffff; break;
-					case 2 : a+=k[0]&0xffff; break;
-					case 1 : a+=k[0]&0xff; break;
-					case 0 : return c;              /* zero length strings require no mixing */
-					}
-
-#else /* make valgrind happy */
-
-				k8 = (const uint8_t *)k;
-				switch(length)
-					{
-					case 12: c+=k[2]; b+=k[1]; a+=k[0]; break;
-					case 11: c+=((uint32_t)k8[10])<<16;  /* fall through */
-					case 10: c+=((uint32_t)k8[9])<<8;    /* fall through */
-					case 9 : c+=k8[8];                   /* fall through */
-					case 8 : b+=k[1]; a+=k[0]; break;
-					case 7 : b+=((uint32_t)k8[6])<<16;   /* fall through */
-					case 6 : b+=((uint32_t)k8[5])<<8;    /* fall through */
-					case 5 : b+=k8[4];                   /* fall through */
-					case 4 : a+=k[0]; break;
-					case 3 : a+=((uint32_t)k8[2])<<16;   /* fall through */
-					case 2 : a+=((uint32_t)k8[1])<<8;    /* fall through */
-					case 1 : a+=k8[0]; break;
-					case 0 : return c;
-					}
-
-#endif /* !valgrind */
 
-				} else if (HASH_LITTLE_ENDIAN && ((u.i & 0x1) == 0)) {
-					const uint16_t *k = (const uint16_t *)key;         /* read 16-bit chunks */
-					const uint8_t  *k8;
-
-					/*--------------- all but last block: aligned reads and different mixing */
-					while (length > 12)
-						{
-						a += k[0] + (((uint32_t)k[1])<<16);
-						b += k[2] + (((uint32_t)k[3])<<16);
-						c += k[4] + (((uint32_t)k[5])<<16);
-						mix(a,b,c);
-						length -= 12;
-						k += 6;
-						}
-
-					/*----------------------------- handle the last (probably partial) block */
-					k8 = (const uint8_t *)k;
-					switch(length)
-						{
-						case 12: c+=k[4]+(((uint32_t)k[5])<<16);
-							b+=k[2]+(((uint32_t)k[3])<<16);
-							a+=k[0]+(((uint32_t)k[1])<<16);
-							break;
-						case 11: c+=((uint32_t)k8[10])<<16;     /* fall through */
-						case 10: c+=k[4];
-							b+=k[2]+(((uint32_t)k[3])<<16);
-							a+=k[0]+(((uint32_t)k[1])<<16);
-							break;
-						case 9 : c+=k8[8];                      /* fall through */
-						case 8 : b+=k[2]+(((uint32_t)k[3])<<16);
-							a+=k[0]+(((uint32_t)k[1])<<16);
-							break;
-						case 7 : b+=((uint32_t)k8[6])<<16;      /* fall through */
-						case 6 : b+=k[2];
-							a+=k[0]+(((uint32_t)k[1])<<16);
-							break;
-						case 5 : b+=k8[4];                      /* fall through */
-						case 4 : a+=k[0]+(((uint32_t)k[1])<<16);
-							break;
-						case 3 : a+=((uint32_t)k8[2])<<16;      /* fall through */
-						case 2 : a+=k[0];
-							break;
-						case 1 : a+=k8[0];
-							break;
-						case 0 : return c;                     /* zero length requires no mixing */
-						}
-
-				} else {                        /* need to read the key one byte at a time */
-					const uint8_t *k = (const uint8_t *)key;
-
-					/*--------------- all but the last block: affect some 32 bits of (a,b,c) */
-					while (length > 12)
-						{
-						a += k[0];
-						a += ((uint32_t)k[1])<<8;
-						a += ((uint32_t)k[2])<<16;
-						a += ((uint32_t)k[3])<<24;
-						b += k[4];
-						b += ((uint32_t)k[5])<<8;
-						b += ((uint32_t)k[6])<<16;
-						b += ((uint32_t)k[7])<<24;
-						c += k[8];
-						c += ((uint32_t)k[9])<<8;
-						c += ((uint32_t)k[10])<<16;
-						c += ((uint32_t)k[11])<<24;
-						mix(a,b,c);
-						length -= 12;
-						k += 12;
-						}
-
-					/*-------------------------------- last block: affect all 32 bits of (c) */
-					switch(length)                   /* all the case statements fall through */
-						{
-						case 12: c+=((uint32_t)k[11])<<24;
-						case 11: c+=((uint32_t)k[10])<<16;
-						case 10: c+=((uint32_t)k[9])<<8;
-						case 9 : c+=k[8];
-						case 8 : b+=((uint32_t)k[7])<<24;
-						case 7 : b+=((uint32_t)k[6])<<16;
-						case 6 : b+=((uint32_t)k[5])<<8;
-						case 5 : b+=k[4];
-						case 4 : a+=((uint32_t)k[3])<<24;
-						case 3 : a+=((uint32_t)k[2])<<16;
-						case 2 : a+=((uint32_t)k[1])<<8;
-						case 1 : a+=k[0];
-							break;
-						case 0 : return c;
-						}
-					}
-
-				final(a,b,c);
-				return c;
-			}
-	};
-
-
-
-	class EdgeHasher : public stdext::hash_compare <std::pair<unsigned int, unsigned int>>
-		{
-		public:
-
-			//hash operator
-			size_t operator() (const std::pair<unsigned int, unsigned int>& s) const
-				{
-				return hashlittle( (void*)&s, sizeof(std::pair<unsigned int, unsigned int>), 0x12345678 );
-				}
-
-			//compare hash
-			bool operator() (const std::pair<unsigned int, unsigned int>& s1, const std::pair<unsigned int, unsigned int>& s2) const
-				{
-				return (s1.first > s2.first) || (s1.second > s2.second);
-				}
-
-			//------------------------------------------------------------
-			// The following Extracted from 
-			// lookup3.c, by Bob Jenkins, May 2006, Public Domain.
-			//------------------------------------------------------------
-			/*
-			-------------------------------------------------------------------------------
-			mix -- mix 3 32-bit values reversibly.
-
-			This is reversible, so any information in (a,b,c) before mix() is
-			still in (a,b,c) after mix().
-
-			If four pairs of (a,b,c) inputs are run through mix(), or through
-			mix() in reverse, there are at least 32 bits of the output that
-			are sometimes the same for one pair and different for another pair.
-			This was tested for:
-			* pairs that differed by one bit, by two bits, in any combination
-			of top bits of (a,b,c), or in any combination of bottom bits of
-			(a,b,c).
-			* "differ" is defined as +, -, ^, or ~^.  For + and -, I transformed
-			the output delta to a Gray code (a^(a>>1)) so a string of 1's (as
-			is commonly produced by subtraction) look like a single 1-bit
-			difference.
-			* the base values were pseudorandom, all zero but one bit set, or 
-			all zero plus a counter that starts at zero.
-
-			Some k values for my "a-=c; a^=rot(c,k); c+=b;" arrangement that
-			satisfy this are
-			4  6  8 16 19  4
-			9 15  3 18 27 15
-			14  9  3  7 17  3
-			Well, "9 15 3 18 27 15" didn't quite get 32 bits diffing
-			for "differ" defined as + with a one-bit base and a two-bit delta.  I
-			used http://burtleburtle.net/bob/hash/avalanche.html to choose 
-			the operations, constants, and arrangements of the variables.
-
-			This does not achieve avalanche.  There are input bits of (a,b,c)
-			that fail to affect some output bits of (a,b,c), especially of a.  The
-			most thoroughly mixed value is c, but it doesn't really even achieve
-			avalanche in c.
-
-			This allows some parallelism.  Read-after-writes are good at doubling
-			the number of bits affected, so the goal of mixing pulls in the opposite
-			direction as the goal of parallelism.  I did what I could.  Rotates
-			seem to cost as much as shifts on every machine I could lay my hands
-			on, and rotates are much kinder to the top and bottom bits, so I used
-			rotates.
-			-------------------------------------------------------------------------------
-			*/
-#define mix(a,b,c) \
-				{ \
-				a -= c;  a ^= rot(c, 4);  c += b; \
-				b -= a;  b ^= rot(a, 6);  a += c; \
-				c -= b;  c ^= rot(b, 8);  b += a; \
-				a -= c;  a ^= rot(c,16);  c += b; \
-				b -= a;  b ^= rot(a,19);  a += c; \
-				c -= b;  c ^= rot(b, 4);  b += a; \
-					}
-
-			/*
-			-------------------------------------------------------------------------------
-			final -- final mixing of 3 32-bit values (a,b,c) into c
-
-			Pairs of (a,b,c) values differing in only a few bits will usually
-			produce values of c that look totally different.  This was tested for
-			* pairs that differed by one bit, by two bits, in any combination
-			of top bits of (a,b,c), or in any combination of bottom bits of
-			(a,b,c).
-			* "differ" is defined as +, -, ^, or ~^.  For + and -, I transformed
-			the output delta to a Gray code (a^(a>>1)) so a string of 1's (as
-			is commonly produced by subtraction) look like a single 1-bit
-			difference.
-			* the base values were pseudorandom, all zero but one bit set, or 
-			all zero plus a counter that starts at zero.
-
-			These constants passed:
-			14 11 25 16 4 14 24
-			12 14 25 16 4 14 24
-			and these came close:
-			4  8 15 26 3 22 24
-			10  8 15 26 3 22 24
-			11  8 15 26 3 22 24
-			-------------------------------------------------------------------------------
-			*/
-#define final(a,b,c) \
-				{ \
-				c ^= b; c -= rot(b,14); \
-				a ^= c; a -= rot(c,11); \
-				b ^= a; b -= rot(a,25); \
-				c ^= b; c -= rot(b,16); \
-				a ^= c; a -= rot(c,4);  \
-				b ^= a; b -= rot(a,14); \
-				c ^= b; c -= rot(b,24); \
-					}
-
-			/*
-			-------------------------------------------------------------------------------
-			hashlittle() -- hash a variable-length key into a 32-bit value
-			k       : the key (the unaligned variable-length array of bytes)
-			length  : the length of the key, counting by bytes
-			initval : can be any 4-byte value
-			Returns a 32-bit value.  Every bit of the key affects every bit of
-			the return value.  Two keys differing by one or two bits will have
-			totally different hash values.
-
-			The best hash table sizes are powers of 2.  There is no need to do
-			mod a prime (mod is sooo slow!).  If you need less than 32 bits,
-			use a bitmask.  For example, if you need only 10 bits, do
-			h = (h & hashmask(10));
-			In which case, the hash table should have hashsize(10) elements.
-
-			If you are hashing n strings (uint8_t **)k, do it like this:
-			for (i=0, h=0; i<n; ++i) h = hashlittle( k[i], len[i], h);
-
-			By Bob Jenkins, 2006.  bob_jenkins@burtleburtle.net.  You may use this
-			code any way you wish, private, educational, or commercial.  It's free.
-
-			Use for hash table lookup, or anything where one collision in 2^^32 is
-			acceptable.  Do NOT use for cryptographic purposes.
-			-------------------------------------------------------------------------------
-			*/
-
-			uint32_t hashlittle( const void *key, size_t length, uint32_t initval) const
-				{
-				uint32_t a,b,c;                                          /* internal state */
-				union { const void *ptr; size_t i; } u;     /* needed for Mac Powerbook G4 */
-
-				/* Set up the internal state */
-				a = b = c = 0xdeadbeef + ((uint32_t)length) + initval;
-
-				u.ptr = key;
-				if (HASH_LITTLE_ENDIAN && ((u.i & 0x3) == 0)) {
-					const uint32_t *k = (const uint32_t *)key;         /* read 32-bit chunks */
-					const uint8_t  *k8;
-
-					/*------ all but last block: aligned reads and affect 32 bits of (a,b,c) */
-					while (length > 12)
-						{
-						a += k[0];
-						b += k[1];
-						c += k[2];
-						mix(a,b,c);
-						length -= 12;
-						k += 3;
-						}
-
-					/*----------------------------- handle the last (probably partial) block */
-					/* 
-					* "k[2]&0xffffff" actually reads beyond the end of the string, but
-					* then masks off the part it's not allowed to read.  Because the
-					* string is aligned, the masked-off tail is in the same word as the
-					* rest of the string.  Every machine with memory protection I've seen
-					* does it on word boundaries, so is OK with this.  But VALGRIND will
-					* still catch it and complain.  The masking trick does make the hash
-					* noticably faster for short strings (like English words).
-					*/
-#ifndef VALGRIND
-
-					switch(length)
-						{
-						case 12: c+=k[2]; b+=k[1]; a+=k[0]; break;
-						case 11: c+=k[2]&0xffffff; b+=k[1]; a+=k[0]; break;
-						case 10: c+=k[2]&0xffff; b+=k[1]; a+=k[0]; break;
-						case 9 : c+=k[2]&0xff; b+=k[1]; a+=k[0]; break;
-						case 8 : b+=k[1]; a+=k[0]; break;
-						case 7 : b+=k[1]&0xffffff; a+=k[0]; break;
-						case 6 : b+=k[1]&0xffff; a+=k[0]; break;
-						case 5 : b+=k[1]&0xff; a+=k[0]; break;
-						case 4 : a+=k[0]; break;
-						case 3 : a+=k[0]&0xffffff; break;
-						case 2 : a+=k[0]&0xffff; break;
-						case 1 : a+=k[0]&0xff; break;
-						case 0 : return c;              /* zero length strings require no mixing */
-						}
-
-#else /* make valgrind happy */
-
-					k8 = (const uint8_t *)k;
-					switch(length)
-						{
-						case 12: c+=k[2]; b+=k[1]; a+=k[0]; break;
-						case 11: c+=((uint32_t)k8[10])<<16;  /* fall through */
-						case 10: c+=((uint32_t)k8[9])<<8;    /* fall through */
-						case 9 : c+=k8[8];                   /* fall through */
-						case 8 : b+=k[1]; a+=k[0]; break;
-						case 7 : b+=((uint32_t)k8[6])<<16;   /* fall through */
-						case 6 : b+=((uint32_t)k8[5])<<8;    /* fall through */
-						case 5 : b+=k8[4];                   /* fall through */
-						case 4 : a+=k[0]; break;
-						case 3 : a+=((uint32_t)k8[2])<<16;   /* fall through */
-						case 2 : a+=((uint32_t)k8[1])<<8;    /* fall through */
-						case 1 : a+=k8[0]; break;
-						case 0 : return c;
-						}
-
-#endif /* !valgrind */
-
-					} else if (HASH_LITTLE_ENDIAN && ((u.i & 0x1) == 0)) {
-						const uint16_t *k = (const uint16_t *)key;         /* read 16-bit chunks */
-						const uint8_t  *k8;
-
-						/*--------------- all but last block: aligned reads and different mixing */
-						while (length > 12)
-							{
-							a += k[0] + (((uint32_t)k[1])<<16);
-							b += k[2] + (((uint32_t)k[3])<<16);
-							c += k[4] + (((uint32_t)k[5])<<16);
-							mix(a,b,c);
-							length -= 12;
-							k += 6;
-							}
-
-						/*----------------------------- handle the last (probably partial) block */
-						k8 = (const uint8_t *)k;
-						switch(length)
-							{
-							case 12: c+=k[4]+(((uint32_t)k[5])<<16);
-								b+=k[2]+(((uint32_t)k[3])<<16);
-								a+=k[0]+(((uint32_t)k[1])<<16);
-								break;
-							case 11: c+=((uint32_t)k8[10])<<16;     /* fall through */
-							case 10: c+=k[4];
-								b+=k[2]+(((uint32_t)k[3])<<16);
-								a+=k[0]+(((uint32_t)k[1])<<16);
-								break;
-							case 9 : c+=k8[8];                      /* fall through */
-							case 8 : b+=k[2]+(((uint32_t)k[3])<<16);
-								a+=k[0]+(((uint32_t)k[1])<<16);
-								break;
-							case 7 : b+=((uint32_t)k8[6])<<16;      /* fall through */
-							case 6 : b+=k[2];
-								a+=k[0]+(((uint32_t)k[1])<<16);
-								break;
-							case 5 : b+=k8[4];                      /* fall through */
-							case 4 : a+=k[0]+(((uint32_t)k[1])<<16);
-								break;
-							case 3 : a+=((uint32_t)k8[2])<<16;      /* fall through */
-							case 2 : a+=k[0];
-								break;
-							case 1 : a+=k8[0];
-								break;
-							case 0 : return c;                     /* zero length requires no mixing */
-							}
-
-					} else {                        /* need to read the key one byte at a time */
-						const uint8_t *k = (const uint8_t *)key;
-
-						/*--------------- all but the last block: affect some 32 bits of (a,b,c) */
-						while (length > 12)
-							{
-							a += k[0];
-							a += ((uint32_t)k[1])<<8;
-							a += ((uint32_t)k[2])<<16;
-							a += ((uint32_t)k[3])<<24;
-							b += k[4];
-							b += ((uint32_t)k[5])<<8;
-							b += ((uint32_t)k[6])<<16;
-							b += ((uint32_t)k[7])<<24;
-							c += k[8];
-							c += ((uint32_t)k[9])<<8;
-							c += ((uint32_t)k[10])<<16;
-							c += ((uint32_t)k[11])<<24;
-							mix(a,b,c);
-							length -= 12;
-							k += 12;
-							}
+//! Hashes vertex positions, the same for the positions operator== finds equal
+struct VertexHasher {
+  unsigned long long operator()(const Vector3<float> & v) const {
+    unsigned long long h = 0;
+    for (unsigned int a = 0; a < 3; a++) {
+      // Adding zero turns -0 into 0, which compares equal
+      const float f = v[a] + 0.f;
+      unsigned int bits;
+      std::memcpy(&bits, &f, sizeof(bits));
+      h = hashMix(h ^ bits);
+    }
+    return h;
+  }
+};
+
+//! Returns the key of the edge between vertices v1 and v2, in either order
+inline unsigned long long edgeKey(unsigned int v1, unsigned int v2)
+{
+  return v1 < v2 ? ((unsigned long long)v1 << 32) | v2 : ((unsigned long long)v2 << 32) | v1;
+}
 
-						/*-------------------------------- last block: affect all 32 bits of (c) */
-						switch(length)                   /* all the case statements fall through */
-							{
-							case 12: c+=((uint32_t)k[11])<<24;
-							case 11: c+=((uint32_t)k[10])<<16;
-							case 10: c+=((uint32_t)k[9])<<8;
-							case 9 : c+=k[8];
-							case 8 : b+=((uint32_t)k[7])<<24;
-							case 7 : b+=((uint32_t)k[6])<<16;
-							case 6 : b+=((uint32_t)k[5])<<8;
-							case 5 : b+=k[4];
-							case 4 : a+=((uint32_t)k[3])<<24;
-							case 3 : a+=((uint32_t)k[2])<<16;
-							case 2 : a+=((uint32_t)k[1])<<8;
-							case 1 : a+=k[0];
-								break;
-							case 0 : return c;
-							}
-						}
+//! Hashes the keys of edgeKey()
+struct EdgeHasher {
+  unsigned long long operator()(unsigned long long key) const { return hashMix(key); }
+};
 
-					final(a,b,c);
-					return c;
-				}
-		};
+typedef OpenHashTable<Vector3<float>, unsigned int, VertexHasher> VertexHashTable;
+typedef OpenHashTable<unsigned long long, unsigned int, EdgeHasher> EdgeHashTable;
 
-typedef stdext::hash_map< Vector3<float>, unsigned int, VertexHasher> VertexHashTable;
-typedef stdext::hash_map< std::pair<unsigned int, unsigned int>, unsigned int, EdgeHasher> EdgeHashTable;
+#endif
@@ -15,6 +15,7 @@
 #include "Function3D.h"
 #include "Vector3.h"
 #include "Implicit.h"
+#include "ImplicitProgram.h"
 
 class ImplicitValueField : public Function3D<float>
 {
@@ -31,6 +32,12 @@ public:
     return mImplicit->getValue(x,y,z);
   }
 
+  //! Evaluate the function at the count points (x[n], y[n], z[n]) through an ImplicitProgram
+  virtual void getValues(const float * x, const float * y, const float * z, float * values, int count) const
+  {
+    ImplicitProgram(*mImplicit).getValues(x, y, z, values, count);
+  }
+
   //! Return a bound on the maximum value of the function
   virtual float getMaxValue() const
   {
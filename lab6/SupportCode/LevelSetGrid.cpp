@@ -14,87 +14,103 @@
 #include "Util.h"
 
 
-LevelSetGrid::Iterator::Iterator(const BitMask3D * mask, int i, int j, int k)
-{
-  // Initialize counters
-  this->mask = mask;
-  this->iMax = mask->getDimX();
-  this->jMax = mask->getDimY();
-  this->kMax = mask->getDimZ();
-  this->i = clamp(i, (int)0, iMax);
-  this->j = clamp(j, (int)0, jMax);
-  this->k = clamp(k, (int)0, kMax);
-
-  // Check if we're within range
-  if(i == iMax && j == jMax && k == kMax){
-    endState = true;
-  } else {
-    endState = false;
-  }
-
-  // Go to the first valid entry
-  if (!endState && !mask->getValue(i,j,k)) (*this)++;
-}
-
-
-float LevelSetGrid::getValue(int i, int j, int k) const
+void LevelSetGrid::setValue(int i, int j, int k, float f)
 {
-  // skip mask check, just access
-  return mPhi.getValue(i,j,k);
+  // Implicitly sets the mask of (i,j,k) to true
+  if (mPhi.setActive(i,j,k, true))
+    mNarrowBand.push_back(toIndex(i,j,k));
+  setPhi(i,j,k, f);
 }
 
 
-void LevelSetGrid::setValue(int i, int j, int k, float f)
+void LevelSetGrid::collectNarrowBand()
 {
-  // Implicitly sets the mask of (i,j,k) to true
-  mMask.setValue(i,j,k,true);
-  mPhi.setValue(i,j,k, f);
+  // Walking the blocks keeps grid points that are close in space close in the list
+  mNarrowBand.clear();
+  int t = 0, n = 0, i, j, k;
+  while (mPhi.findNextActive(t, n)) {
+    mPhi.getCoordinates(t, n, i, j, k);
+    mNarrowBand.push_back(toIndex(i,j,k));
+    n++;
+  }
 }
 
 
 void LevelSetGrid::dilate()
 {
-  BitMask3D newMask(mMask);
-  Iterator it = beginNarrowBand();
-  Iterator iend = endNarrowBand();
-  while(it!=iend){
-    int i = it.getI();
-    int j = it.getJ();
-    int k = it.getK();
-    newMask.setValue(i, j, k, true);
-    if (k < getDimZ()-1)  newMask.setValue(i, j, k+1, true);
-    if (k > 0)            newMask.setValue(i, j, k-1, true);
-    if (j < getDimY()-1)  newMask.setValue(i, j+1, k, true);
-    if (j > 0)            newMask.setValue(i, j-1, k, true);
-    if (i < getDimX()-1)  newMask.setValue(i+1, j, k, true);
-    if (i > 0)            newMask.setValue(i-1, j, k, true);
-    it++;
+  // Collect the 6-neighbours first, activating them while iterating
+  // would make the sweep visit the newly added grid points
+  std::vector<Vector3<int> > newPoints;
+  const size_t size = mNarrowBand.size();
+  for (size_t n = 0; n < size; n++) {
+    int i, j, k;
+    getNarrowBandPoint(n, i, j, k);
+    if (k < getDimZ()-1 && !mPhi.isActive(i, j, k+1))  newPoints.push_back(Vector3<int>(i, j, k+1));
+    if (k > 0           && !mPhi.isActive(i, j, k-1))  newPoints.push_back(Vector3<int>(i, j, k-1));
+    if (j < getDimY()-1 && !mPhi.isActive(i, j+1, k))  newPoints.push_back(Vector3<int>(i, j+1, k));
+    if (j > 0           && !mPhi.isActive(i, j-1, k))  newPoints.push_back(Vector3<int>(i, j-1, k));
+    if (i < getDimX()-1 && !mPhi.isActive(i+1, j, k))  newPoints.push_back(Vector3<int>(i+1, j, k));
+    if (i > 0           && !mPhi.isActive(i-1, j, k))  newPoints.push_back(Vector3<int>(i-1, j, k));
   }
-  mMask = newMask;
+
+  for (unsigned int n = 0; n < newPoints.size(); n++)
+    mPhi.setActive(newPoints[n].x(), newPoints[n].y(), newPoints[n].z(), true);
+
+  // Appending the new points would scatter them in memory, rebuild in block order instead
+  if (!newPoints.empty()) collectNarrowBand();
 }
 
 
-void LevelSetGrid::rebuild()
+void LevelSetGrid::rebuild(bool cullConstants)
 {
-  Iterator it = beginNarrowBand();
-  Iterator iend = endNarrowBand();
-  while(it!=iend){
-    int i = it.getI();
-    int j = it.getJ();
-    int k = it.getK();
+  // Cull the band in place, keeping the order of the remaining grid points
+  const size_t size = mNarrowBand.size();
+  size_t kept = 0;
+  for (size_t n = 0; n < size; n++) {
+    int i, j, k;
+    getNarrowBandPoint(n, i, j, k);
 
     //    std::cerr << mPhi.getValue(i,j,k) << " -> " ;
-    if(mPhi.getValue(i,j,k) > mOutsideConstant) {
-      mPhi.setValue(i, j, k, mOutsideConstant);
-      mMask.setValue(i, j, k, false);
+    const float val = mPhi.getValue(i,j,k);
+    if(val > mOutsideConstant || (cullConstants && val == mOutsideConstant)) {
+      setPhi(i, j, k, mOutsideConstant);
+      mPhi.setActive(i, j, k, false);
     }
-    else if(mPhi.getValue(i,j,k) < mInsideConstant) {
-      mPhi.setValue(i, j, k, mInsideConstant);
-      mMask.setValue(i, j, k, false);
+    else if(val < mInsideConstant || (cullConstants && val == mInsideConstant)) {
+      setPhi(i, j, k, mInsideConstant);
+      mPhi.setActive(i, j, k, false);
     }
+    else
+      mNarrowBand[kept++] = mNarrowBand[n];
     //    std::cerr << mPhi.getValue(i,j,k) << ", " ;
-    it++;
   }
+  mNarrowBand.resize(kept);
+
+  // Collapse blocks that are entirely inside or outside the narrow band
+  mPhi.prune();
+}
+
+
+float * LevelSetGrid::fillBlock(int bi, int bj, int bk)
+{
+  const int t = (bi*mPhi.getTilesY() + bj)*mPhi.getTilesZ() + bk;
+  mDirtyBlocks[t] = 1;
+  mPhi.setTileActive(t, true);
+  return mPhi.getLeafValues(t);
+}
+
+
+void LevelSetGrid::setConstantBlock(int bi, int bj, int bk, float value)
+{
+  const int t = (bi*mPhi.getTilesY() + bj)*mPhi.getTilesZ() + bk;
+  mDirtyBlocks[t] = 1;
+  mPhi.setTileValue(t, value);
+}
+
+
+bool LevelSetGrid::isConstantBlock(int bi, int bj, int bk, float & value) const
+{
+  return mPhi.isConstantTile((bi*mPhi.getTilesY() + bj)*mPhi.getTilesZ() + bk, value);
 }
 
 
@@ -102,4 +118,3 @@ Vector3<int> LevelSetGrid::getDimensions()
 {
   return Vector3<int>(getDimX(), getDimY(), getDimZ());
 }
-
@@ -12,73 +12,93 @@
 #ifndef __levelset_grid_h__
 #define __levelset_grid_h__
 
-#include "Volume.h"
+#include "SparseVolume.h"
 #include "Vector3.h"
-#include "BitMask3D.h"
 #include <iostream>
 #include <limits>
-
+#include <vector>
+#include <algorithm>
+
+/*!
+ * Level set grid storing phi and the narrow band in a sparse, block tiled volume.
+ * Blocks far away from the interface are stored as a single inside or outside
+ * constant, so memory and narrow band sweeps scale with the surface area.
+ *
+ * The narrow band is also kept as an explicit list of linear grid indices,
+ * i*dimY*dimZ + j*dimZ + k, so sweeps over the band never search for active
+ * grid points. The list is rebuilt by dilate() and rebuild() and grows when
+ * setValue() adds a grid point to the band.
+ *
+ * Every block has a dirty flag, set when one of its values changes, so meshes
+ * of the interface only need to be rebuilt where it moved, see BlockMarchingCubes.
+ * A new grid starts with all blocks dirty.
+ */
 class LevelSetGrid
 {
+public:
+  //! Linear index of a grid point
+  typedef size_t Index;
+
 protected:
-  Volume<float> mPhi;
-  BitMask3D mMask;
+  SparseVolume<float> mPhi;
   float mInsideConstant, mOutsideConstant;
 
+  //! Linear indices of all grid points in the narrow band
+  std::vector<Index> mNarrowBand;
+
+  //! One flag per block, non-zero if a value of the block changed since clearDirtyBlocks()
+  std::vector<unsigned char> mDirtyBlocks;
+
+  inline Index toIndex(int i, int j, int k) const {
+    return ((Index)i*mPhi.getDimY() + j)*mPhi.getDimZ() + k;
+  }
+
+  //! Sets the value at (i,j,k), marking its block dirty if the value changes
+  inline void setPhi(int i, int j, int k, float f) {
+    if (mPhi.getValue(i,j,k) != f) mDirtyBlocks[mPhi.getTileIndex(i,j,k)] = 1;
+    mPhi.setValue(i,j,k, f);
+  }
+
+
 
 public:
 
   LevelSetGrid(int dimX=0, int dimY=0, int dimZ=0,
                float insideConstant=-std::numeric_limits<float>::max(),
                float outsideConstant=std::numeric_limits<float>::max())
-    : mPhi(dimX, dimY, dimZ, outsideConstant), mMask(dimX, dimY, dimZ),
-      mInsideConstant(insideConstant), mOutsideConstant(outsideConstant) { }
+    : mPhi(dimX, dimY, dimZ, outsideConstant),
+      mInsideConstant(insideConstant), mOutsideConstant(outsideConstant),
+      mDirtyBlocks(mPhi.getNumTiles(), 1) { }
 
   ~LevelSetGrid() { }
 
 
 
+  //! Iterates over the narrow band list
   class Iterator
   {
     friend class LevelSetGrid;
 
   protected:
-    const BitMask3D * mask;
+    const LevelSetGrid * grid;
+    size_t n;
     int i,j,k;
-    int iMax, jMax, kMax;
-    bool endState;
 
-    Iterator(const BitMask3D * mask, int i=0, int j=0, int k=0);
+    Iterator(const LevelSetGrid * grid, size_t n) : grid(grid), n(n), i(0), j(0), k(0) {
+      if (n < grid->getNarrowBandSize()) grid->getNarrowBandPoint(n, i, j, k);
+    }
 
 
   public :
 
     inline Iterator & operator ++ (int) {
-      endState = false;
-      if (endState != true){
-        do{
-          ++k;
-          if(k >= kMax) {
-            k = 0;
-            ++j;
-            if(j >= jMax){
-              j = 0;
-              ++i;
-              if(i >= iMax){
-		            k = kMax;
-		            j = jMax;
-		            i = iMax;
-                endState = true;
-              }
-            }
-          }
-        } while (!endState && (mask->getValue(i,j,k) != true));
-      }
+      n++;
+      if (n < grid->getNarrowBandSize()) grid->getNarrowBandPoint(n, i, j, k);
       return *this;
     }
 
     bool operator !=(const Iterator & b) const {
-      return (this->i != b.i || this->j != b.j || this->k != b.k);
+      return (this->n != b.n);
     }
 
     int getI() const { return i; }
@@ -87,11 +107,46 @@ public:
   };
 
 
-  Iterator beginNarrowBand() { return Iterator(&mMask); }
-  const Iterator beginNarrowBand() const { return Iterator(&mMask); }
+  Iterator beginNarrowBand() { return Iterator(this, 0); }
+  const Iterator beginNarrowBand() const { return Iterator(this, 0); }
 
-  Iterator endNarrowBand() { return Iterator(&mMask, mMask.getDimX(), mMask.getDimY(), mMask.getDimZ()); }
-  const Iterator endNarrowBand() const { return Iterator(&mMask, mMask.getDimX(), mMask.getDimY(), mMask.getDimZ()); }
+  Iterator endNarrowBand() { return Iterator(this, mNarrowBand.size()); }
+  const Iterator endNarrowBand() const { return Iterator(this, mNarrowBand.size()); }
+
+  //! Number of grid points in the narrow band
+  inline size_t getNarrowBandSize() const { return mNarrowBand.size(); }
+
+  //! Returns the grid coordinates of the n:th grid point in the narrow band
+  inline void getNarrowBandPoint(size_t n, int & i, int & j, int & k) const {
+    const Index index = mNarrowBand[n];
+    const Index dimZ = mPhi.getDimZ();
+    const Index ij = index / dimZ;
+    k = (int)(index - ij*dimZ);
+    i = (int)(ij / mPhi.getDimY());
+    j = (int)(ij - (Index)i*mPhi.getDimY());
+  }
+
+  //! Returns the value of the n:th grid point in the narrow band
+  inline float getNarrowBandValue(size_t n) const {
+    int i, j, k;
+    getNarrowBandPoint(n, i, j, k);
+    return mPhi.getValue(i, j, k);
+  }
+
+  /*!
+   * Sets the value of the n:th grid point in the narrow band. The band itself is
+   * left untouched, so different grid points can be set from different threads.
+   * Threads setting grid points of the same block may both mark it dirty, which
+   * stores the same flag.
+   */
+  inline void setNarrowBandValue(size_t n, float f) {
+    int i, j, k;
+    getNarrowBandPoint(n, i, j, k);
+    setPhi(i, j, k, f);
+  }
+
+  //! Linear indices of the narrow band, in the order the band is traversed
+  const std::vector<Index> & getNarrowBand() const { return mNarrowBand; }
 
   inline int getDimX() const { return mPhi.getDimX(); }
   inline int getDimY() const { return mPhi.getDimY(); }
@@ -100,7 +155,7 @@ public:
   //! Return grid dimensions as measured in number of grid cells
 	Vector3<int> getDimensions();
 
-  float getValue(int i, int j, int k) const;
+  inline float getValue(int i, int j, int k) const { return mPhi.getValue(i,j,k); }
   void setValue(int i, int j, int k, float f);
 
   void setInsideConstant(float insideConstant) { mInsideConstant = insideConstant; }
@@ -112,8 +167,61 @@ public:
   //! Dilates the narrow band with 6 connectivity
   void dilate();
 
-  //! Rebuild the narrow band by culling too large values from mask
-  void rebuild();
+  /*!
+   * Rebuild the narrow band by culling too large values from mask. With
+   * cullConstants, values equal to the inside or outside constant are culled
+   * too, as they are for the grid points dilate() added but nothing reached.
+   */
+  void rebuild(bool cullConstants = false);
+
+  //! Stencil cursor over the grid values, see SparseVolume::Cursor
+  typedef SparseVolume<float>::Cursor Cursor;
+
+  //! Returns a stencil cursor pointing at grid point (i,j,k)
+  inline Cursor getCursor(int i, int j, int k) const { return Cursor(mPhi, i, j, k); }
+
+  //! Returns true if (i,j,k) is in the narrow band
+  bool isInNarrowBand(int i, int j, int k) const { return mPhi.isActive(i,j,k); }
+
+  //! Side length of the storage blocks, measured in grid points
+  static int getBlockDim() { return SparseVolume<float>::LEAF_DIM; }
+  //! Returns true if block (bi,bj,bk) stores a single constant for all its grid points
+  bool isConstantBlock(int bi, int bj, int bk, float & value) const;
+
+  //! Number of allocated (non constant) blocks
+  int getNumAllocatedBlocks() const { return mPhi.getNumLeafs(); }
+
+  //! Number of blocks along each axis
+  int getBlocksX() const { return mPhi.getTilesX(); }
+  int getBlocksY() const { return mPhi.getTilesY(); }
+  int getBlocksZ() const { return mPhi.getTilesZ(); }
+
+  /*!
+   * Adds all grid points of block (bi,bj,bk) to the narrow band and returns the
+   * values of the block for writing, indexed by getBlockOffset(). The block is
+   * allocated here, which may move the values of the other blocks, so fill all
+   * blocks serially first and fetch the pointers afterwards. The values of
+   * different blocks can then be written from different threads. Call
+   * collectNarrowBand() after the last block.
+   */
+  float * fillBlock(int bi, int bj, int bk);
+
+  //! Sets all grid points of block (bi,bj,bk) to value and removes them from the narrow band, call collectNarrowBand() afterwards
+  void setConstantBlock(int bi, int bj, int bk, float value);
+
+  //! Position of grid point (i,j,k) in the values returned by fillBlock()
+  static int getBlockOffset(int i, int j, int k) { return SparseVolume<float>::getLeafOffset(i,j,k); }
+
+  //! Rebuilds the narrow band list from the active grid points, in block order
+  void collectNarrowBand();
+
+  //! Returns true if a value of block (bi,bj,bk) changed since the last clearDirtyBlocks()
+  bool isDirtyBlock(int bi, int bj, int bk) const {
+    return mDirtyBlocks[(bi*mPhi.getTilesY() + bj)*mPhi.getTilesZ() + bk] != 0;
+  }
+
+  //! Marks all blocks clean, called once the changes have been picked up
+  void clearDirtyBlocks() { std::fill(mDirtyBlocks.begin(), mDirtyBlocks.end(), 0); }
 
 
 
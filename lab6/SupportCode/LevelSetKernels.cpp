@@ -0,0 +1,274 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+
+#include "LevelSetKernels.h"
+#include "Stopwatch.h"
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+// GCC only defines __SSE__ when the target has it, Visual C++ always
+// accepts the intrinsics on x86 so the CPU is checked at runtime
+#if defined(__SSE__) || defined(_M_IX86) || defined(_M_X64)
+#define LEVELSET_KERNELS_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+LevelSetKernels::Path LevelSetKernels::mPath = LevelSetKernels::getBestPath();
+
+
+LevelSetKernels::Path LevelSetKernels::getBestPath()
+{
+#if defined(_MSC_VER) && defined(_M_IX86)
+  // Bit 25 of edx from cpuid function 1 flags SSE
+  int info[4];
+  __cpuid(info, 1);
+  return (info[3] & (1 << 25)) ? SSE : SCALAR;
+#elif defined(LEVELSET_KERNELS_SSE)
+  return SSE;
+#else
+  return SCALAR;
+#endif
+}
+
+
+bool LevelSetKernels::setPath(Path path)
+{
+  if (path == SSE && getBestPath() != SSE) return false;
+  mPath = path;
+  return true;
+}
+
+
+const char * LevelSetKernels::getPathName(Path path)
+{
+  return path == SSE ? "SSE" : "scalar";
+}
+
+
+void LevelSetKernels::weno(const float * v1, const float * v2, const float * v3, const float * v4, const float * v5,
+                           float * out, int count)
+{
+  if (mPath == SSE)
+    wenoSSE(v1, v2, v3, v4, v5, out, count);
+  else
+    wenoScalar(v1, v2, v3, v4, v5, out, count);
+}
+
+
+void LevelSetKernels::godunov(const float * a, const float * ddm, const float * ddp, float * dd2, int count)
+{
+  if (mPath == SSE)
+    godunovSSE(a, ddm, ddp, dd2, count);
+  else
+    godunovScalar(a, ddm, ddp, dd2, count);
+}
+
+
+void LevelSetKernels::wenoScalar(const float * v1, const float * v2, const float * v3, const float * v4, const float * v5,
+                                 float * out, int count)
+{
+  for (int n = 0; n < count; n++)
+    out[n] = weno(v1[n], v2[n], v3[n], v4[n], v5[n]);
+}
+
+
+void LevelSetKernels::godunovScalar(const float * a, const float * ddm, const float * ddp, float * dd2, int count)
+{
+  for (int n = 0; n < count; n++)
+    dd2[n] = godunov(a[n], ddm[n], ddp[n]);
+}
+
+
+#ifdef LEVELSET_KERNELS_SSE
+
+void LevelSetKernels::wenoSSE(const float * v1, const float * v2, const float * v3, const float * v4, const float * v5,
+                              float * out, int count)
+{
+  const __m128 oneByThree = _mm_set1_ps(1.0f/3.0f);
+  const __m128 oneBySix = _mm_set1_ps(1.0f/6.0f);
+  const __m128 minusOneBySix = _mm_set1_ps(-(1.0f/6.0f));
+  const __m128 fiveBySix = _mm_set1_ps(5.0f/6.0f);
+  const __m128 sevenBySix = _mm_set1_ps(7.0f/6.0f);
+  const __m128 elevenBySix = _mm_set1_ps(11.0f/6.0f);
+  const __m128 thirteenByTwelve = _mm_set1_ps(13.0f/12.0f);
+  const __m128 oneByFour = _mm_set1_ps(1.0f/4.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 three = _mm_set1_ps(3.0f);
+  const __m128 four = _mm_set1_ps(4.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 epsilonScale = _mm_set1_ps(1e-6f);
+  const __m128 epsilonFloor = _mm_set1_ps(1e-15f);
+  const __m128 weight1 = _mm_set1_ps(0.1f);
+  const __m128 weight2 = _mm_set1_ps(0.6f);
+  const __m128 weight3 = _mm_set1_ps(0.3f);
+
+  // Four grid points at a time, the same operations as the scalar weno()
+  int n = 0;
+  for (; n + 4 <= count; n += 4) {
+    const __m128 a1 = _mm_loadu_ps(v1 + n);
+    const __m128 a2 = _mm_loadu_ps(v2 + n);
+    const __m128 a3 = _mm_loadu_ps(v3 + n);
+    const __m128 a4 = _mm_loadu_ps(v4 + n);
+    const __m128 a5 = _mm_loadu_ps(v5 + n);
+
+    __m128 maxV = _mm_max_ps(_mm_mul_ps(a1, a1), _mm_mul_ps(a2, a2));
+    maxV = _mm_max_ps(maxV, _mm_mul_ps(a3, a3));
+    maxV = _mm_max_ps(maxV, _mm_mul_ps(a4, a4));
+    maxV = _mm_max_ps(maxV, _mm_mul_ps(a5, a5));
+    const __m128 epsilon = _mm_add_ps(_mm_mul_ps(epsilonScale, maxV), epsilonFloor);
+
+    const __m128 phi1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(oneByThree, a1), _mm_mul_ps(sevenBySix, a2)),
+                                   _mm_mul_ps(elevenBySix, a3));
+    const __m128 phi2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(minusOneBySix, a2), _mm_mul_ps(fiveBySix, a3)),
+                                   _mm_mul_ps(oneByThree, a4));
+    const __m128 phi3 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(oneByThree, a3), _mm_mul_ps(fiveBySix, a4)),
+                                   _mm_mul_ps(oneBySix, a5));
+
+    __m128 term1 = _mm_add_ps(_mm_sub_ps(a1, _mm_mul_ps(two, a2)), a3);
+    __m128 term2 = _mm_add_ps(_mm_sub_ps(a1, _mm_mul_ps(four, a2)), _mm_mul_ps(three, a3));
+    __m128 S1 = _mm_add_ps(_mm_mul_ps(thirteenByTwelve, _mm_mul_ps(term1, term1)), _mm_mul_ps(oneByFour, _mm_mul_ps(term2, term2)));
+    S1 = _mm_add_ps(S1, epsilon);
+    term1 = _mm_add_ps(_mm_sub_ps(a2, _mm_mul_ps(two, a3)), a4);
+    term2 = _mm_sub_ps(a2, a4);
+    __m128 S2 = _mm_add_ps(_mm_mul_ps(thirteenByTwelve, _mm_mul_ps(term1, term1)), _mm_mul_ps(oneByFour, _mm_mul_ps(term2, term2)));
+    S2 = _mm_add_ps(S2, epsilon);
+    term1 = _mm_add_ps(_mm_sub_ps(a3, _mm_mul_ps(two, a4)), a5);
+    term2 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(three, a3), _mm_mul_ps(four, a4)), a5);
+    __m128 S3 = _mm_add_ps(_mm_mul_ps(thirteenByTwelve, _mm_mul_ps(term1, term1)), _mm_mul_ps(oneByFour, _mm_mul_ps(term2, term2)));
+    S3 = _mm_add_ps(S3, epsilon);
+
+    const __m128 alpha1 = _mm_div_ps(weight1, _mm_mul_ps(S1, S1));
+    const __m128 alpha2 = _mm_div_ps(weight2, _mm_mul_ps(S2, S2));
+    const __m128 alpha3 = _mm_div_ps(weight3, _mm_mul_ps(S3, S3));
+    const __m128 denominator = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(alpha1, alpha2), alpha3));
+
+    __m128 result = _mm_mul_ps(_mm_mul_ps(alpha1, denominator), phi1);
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_mul_ps(alpha2, denominator), phi2));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_mul_ps(alpha3, denominator), phi3));
+    _mm_storeu_ps(out + n, result);
+  }
+
+  // The remaining grid points of a partial batch
+  wenoScalar(v1 + n, v2 + n, v3 + n, v4 + n, v5 + n, out + n, count - n);
+}
+
+
+void LevelSetKernels::godunovSSE(const float * a, const float * ddm, const float * ddp, float * dd2, int count)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+
+  int n = 0;
+  for (; n + 4 <= count; n += 4) {
+    // Sign bit set in the lanes where a <= 0, the differentials are flipped there
+    const __m128 flip = _mm_andnot_ps(_mm_cmpgt_ps(_mm_loadu_ps(a + n), zero), signBit);
+    const __m128 m = _mm_xor_ps(_mm_loadu_ps(ddm + n), flip);
+    const __m128 p = _mm_xor_ps(_mm_loadu_ps(ddp + n), _mm_xor_ps(flip, signBit));
+    const __m128 dd = _mm_max_ps(_mm_max_ps(m, p), zero);
+    _mm_storeu_ps(dd2 + n, _mm_mul_ps(dd, dd));
+  }
+
+  godunovScalar(a + n, ddm + n, ddp + n, dd2 + n, count - n);
+}
+
+#else
+
+void LevelSetKernels::wenoSSE(const float * v1, const float * v2, const float * v3, const float * v4, const float * v5,
+                              float * out, int count)
+{
+  wenoScalar(v1, v2, v3, v4, v5, out, count);
+}
+
+
+void LevelSetKernels::godunovSSE(const float * a, const float * ddm, const float * ddp, float * dd2, int count)
+{
+  godunovScalar(a, ddm, ddp, dd2, count);
+}
+
+#endif
+
+
+void LevelSetKernels::benchmark(std::ostream & os, int count)
+{
+  // Random one sided differences around the unit gradient of a distance function,
+  // stored per grid point like the stencils the operators read
+  std::vector<float> stencil(6*count), a(count), out(count), ref(count);
+  for (int n = 0; n < 6*count; n++)
+    stencil[n] = 1.0f + 0.5f * (std::rand() / (float)RAND_MAX - 0.5f);
+  for (int n = 0; n < count; n++)
+    a[n] = std::rand() < RAND_MAX/2 ? -1.0f : 1.0f;
+
+  const int repeats = 10;
+  Stopwatch clock;
+  os << "Level set kernels, " << count << " grid points, batched path: " << getPathName(mPath) << std::endl;
+
+  // WENO one grid point at a time, as the operators did before the batched kernels
+  clock.start();
+  for (int r = 0; r < repeats; r++)
+    for (int n = 0; n < count; n++) {
+      const float * v = &stencil[6*n];
+      ref[n] = weno(v[0], v[1], v[2], v[3], v[4]);
+    }
+  const double wenoScalarTime = clock.stop();
+
+  // WENO in batches, gathering the stencils into one array per difference first
+  clock.start();
+  for (int r = 0; r < repeats; r++)
+    for (int first = 0; first < count; first += BATCH_SIZE) {
+      const int size = std::min((int)BATCH_SIZE, count - first);
+      float v[5][BATCH_SIZE];
+      for (int n = 0; n < size; n++)
+        for (int m = 0; m < 5; m++)
+          v[m][n] = stencil[6*(first + n) + m];
+      weno(v[0], v[1], v[2], v[3], v[4], &out[first], size);
+    }
+  const double wenoBatchTime = clock.stop();
+
+  float wenoError = 0;
+  for (int n = 0; n < count; n++)
+    wenoError = std::max(wenoError, std::abs(out[n] - ref[n]));
+
+  // Godunov, the same way
+  clock.start();
+  for (int r = 0; r < repeats; r++)
+    for (int n = 0; n < count; n++)
+      ref[n] = godunov(a[n], stencil[6*n] - 1.0f, stencil[6*n + 1] - 1.0f);
+  const double godunovScalarTime = clock.stop();
+
+  clock.start();
+  for (int r = 0; r < repeats; r++)
+    for (int first = 0; first < count; first += BATCH_SIZE) {
+      const int size = std::min((int)BATCH_SIZE, count - first);
+      float ddm[BATCH_SIZE], ddp[BATCH_SIZE];
+      for (int n = 0; n < size; n++) {
+        ddm[n] = stencil[6*(first + n)] - 1.0f;
+        ddp[n] = stencil[6*(first + n) + 1] - 1.0f;
+      }
+      godunov(&a[first], ddm, ddp, &out[first], size);
+    }
+  const double godunovBatchTime = clock.stop();
+
+  float godunovError = 0;
+  for (int n = 0; n < count; n++)
+    godunovError = std::max(godunovError, std::abs(out[n] - ref[n]));
+
+  const double points = (double)count * repeats;
+  os << "  WENO    scalar " << points / wenoScalarTime << " points/s, batched "
+     << points / wenoBatchTime << " points/s, max difference " << wenoError << std::endl;
+  os << "  Godunov scalar " << points / godunovScalarTime << " points/s, batched "
+     << points / godunovBatchTime << " points/s, max difference " << godunovError << std::endl;
+}
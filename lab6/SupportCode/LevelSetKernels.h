@@ -0,0 +1,122 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#ifndef __levelset_kernels_h__
+#define __levelset_kernels_h__
+
+#include <iostream>
+#include <algorithm>
+
+/*!
+ * The arithmetic kernels of the level set operators, the WENO5 approximation
+ * and the Godunov upwind selection, for a batch of grid points at a time.
+ *
+ * The batched kernels take one array per input (structure of arrays), so
+ * consecutive grid points of the narrow band map to the lanes of a SIMD
+ * register. An SSE path processes four grid points per instruction and is
+ * picked at startup if the CPU supports it, otherwise the scalar path is used.
+ * Both paths perform the same single precision operations in the same order,
+ * so they give identical results.
+ */
+class LevelSetKernels
+{
+public :
+
+  //! Number of narrow band grid points the operators hand to the kernels at once
+  static const int BATCH_SIZE = 8;
+
+  //! Instruction set used by the batched kernels
+  enum Path { SCALAR, SSE };
+
+  //! Returns the path used by the batched kernels
+  static Path getPath() { return mPath; }
+  //! Selects the path used by the batched kernels, returns false if the CPU does not support it
+  static bool setPath(Path path);
+  //! Returns the best path supported by the CPU
+  static Path getBestPath();
+  static const char * getPathName(Path path);
+
+  /*!
+   * The WENO5 approximation of a one sided differential from the five one
+   * sided differences v1..v5 along the upwind direction.
+   */
+  static inline float weno(float v1, float v2, float v3, float v4, float v5)
+  {
+    // The floor on epsilon keeps flat stencils, where all v are zero,
+    // from dividing zero by zero
+    const float maxV = std::max( std::max( std::max( std::max(v1*v1, v2*v2), v3*v3 ), v4*v4 ), v5*v5 );
+    const float epsilon = 1e-6f * maxV + 1e-15f;
+
+    // Possible HJ ENO approximations
+    const float phi1 =  (1.0f/3.0f) * v1 - (7.0f/6.0f) * v2 + (11.0f/6.0f) * v3;
+    const float phi2 = -(1.0f/6.0f) * v2 + (5.0f/6.0f) * v3 + (1.0f/3.0f)  * v4;
+    const float phi3 =  (1.0f/3.0f) * v3 + (5.0f/6.0f) * v4 - (1.0f/6.0f)  * v5;
+
+    // Approximate stencil smoothness
+    float term1 = v1 - 2.0f*v2 + v3;
+    float term2 = v1 - 4.0f*v2 + 3.0f*v3;
+    const float S1 = (13.0f/12.0f) * (term1*term1) + (1.0f/4.0f) * (term2*term2) + epsilon;
+    term1 = v2 - 2.0f*v3 + v4;
+    term2 = v2 - v4;
+    const float S2 = (13.0f/12.0f) * (term1*term1) + (1.0f/4.0f) * (term2*term2) + epsilon;
+    term1 = v3 - 2.0f*v4 + v5;
+    term2 = 3.0f*v3 - 4.0f*v4 + v5;
+    const float S3 = (13.0f/12.0f) * (term1*term1) + (1.0f/4.0f) * (term2*term2) + epsilon;
+
+    // Weights from the smoothness
+    const float alpha1 = 0.1f / (S1*S1);
+    const float alpha2 = 0.6f / (S2*S2);
+    const float alpha3 = 0.3f / (S3*S3);
+    const float denominator = 1.0f / (alpha1 + alpha2 + alpha3);
+
+    // The weighted ENO approximation
+    return (alpha1*denominator)*phi1 + (alpha2*denominator)*phi2 + (alpha3*denominator)*phi3;
+  }
+
+  /*!
+   * Godunov's upwind selection of the squared differential along one axis from
+   * the one sided differentials ddm and ddp, for speed a. Flipping the signs of
+   * the differentials when a <= 0 turns both cases into the same max, so there
+   * is no branch on the speed.
+   */
+  static inline float godunov(float a, float ddm, float ddp)
+  {
+    const float s = a > 0 ? 1.0f : -1.0f;
+    const float dd = std::max( std::max(s*ddm, -s*ddp), 0.0f );
+    return dd*dd;
+  }
+
+  //! Computes out[n] = weno(v1[n], .., v5[n]) for count grid points
+  static void weno(const float * v1, const float * v2, const float * v3, const float * v4, const float * v5,
+                   float * out, int count);
+
+  //! Computes dd2[n] = godunov(a[n], ddm[n], ddp[n]) for count grid points
+  static void godunov(const float * a, const float * ddm, const float * ddp, float * dd2, int count);
+
+  /*!
+   * Times the scalar kernels against the batched kernels on the selected path
+   * for count random grid points and prints the throughput in grid points per second.
+   */
+  static void benchmark(std::ostream & os, int count = 1 << 20);
+
+private :
+
+  static Path mPath;
+
+  static void wenoScalar(const float * v1, const float * v2, const float * v3, const float * v4, const float * v5,
+                         float * out, int count);
+  static void godunovScalar(const float * a, const float * ddm, const float * ddp, float * dd2, int count);
+  static void wenoSSE(const float * v1, const float * v2, const float * v3, const float * v4, const float * v5,
+                      float * out, int count);
+  static void godunovSSE(const float * a, const float * ddm, const float * ddp, float * dd2, int count);
+};
+
+#endif
@@ -11,6 +11,67 @@
 *************************************************************************************************/
 #include "LevelSetOperator.h"
 
+int LevelSetOperator::mNumThreads = 0;
+
+void LevelSetOperator::computeRate(std::vector<float> & rate)
+{
+  // Operators that do not step with integrate() leave phi unchanged
+  std::fill(rate.begin(), rate.end(), 0.0f);
+}
+
+/*!
+ * Each stage of the Shu-Osher form of the TVD Runge-Kutta schemes is a forward
+ * Euler step, blended with the values at the start of the step
+ *
+ * \f[
+ * \phi^{(s)} = a_s \phi^n + b_s \left( \phi^{(s-1)} + \Delta t L(\phi^{(s-1)}) \right)
+ * \f]
+ *
+ * where L is the spatial operator computed by computeRate().
+ */
+void LevelSetOperator::integrate(float dt)
+{
+  // Blend weights a_s and b_s for each stage, one row per integrator
+  static const float a[3][3] = { { 0, 0, 0 }, { 0, 0.5f, 0 }, { 0, 0.75f, 1.0f/3.0f } };
+  static const float b[3][3] = { { 1, 0, 0 }, { 1, 0.5f, 0 }, { 1, 0.25f, 2.0f/3.0f } };
+  const int stages = (int)mIntegrator;
+
+  const int size = (int)getGrid().getNarrowBandSize();
+  mRate.resize(size);
+
+  // Store phi^n for the blending
+  if (stages > 1) {
+    mPhiN.resize(size);
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+    for (int n = 0; n < size; n++)
+      mPhiN[n] = getGrid().getNarrowBandValue(n);
+  }
+
+  for (int s = 0; s < stages; s++) {
+    computeRate(mRate);
+
+    // The whole rate is computed before the grid is written, so the update can be done in place
+    const float as = a[stages-1][s], bs = b[stages-1][s];
+#pragma omp parallel for schedule(static) num_threads(getNumThreads())
+    for (int n = 0; n < size; n++) {
+      float phi = getGrid().getNarrowBandValue(n) + mRate[n] * dt;
+      if (as != 0) phi = as * mPhiN[n] + bs * phi;
+      getGrid().setNarrowBandValue(n, phi);
+    }
+  }
+}
+
+int LevelSetOperator::getNumThreads()
+{
+#ifdef _OPENMP
+  if (mNumThreads <= 0)
+    return omp_get_max_threads();
+  return mNumThreads;
+#else
+  return 1;
+#endif
+}
+
 /*! Computes the squares of the partial derivatives in x, y, z using the
  * Godunov method
  *
@@ -32,42 +93,58 @@
 void LevelSetOperator::godunov(unsigned int i, unsigned int j, unsigned int k, float a,
                                float & ddx2, float & ddy2, float & ddz2)
 {
-  float ddxm = mLS->diffXm(i,j,k);
-  float ddxp = mLS->diffXp(i,j,k);
-  float ddym = mLS->diffYm(i,j,k);
-  float ddyp = mLS->diffYp(i,j,k);
-  float ddzm = mLS->diffZm(i,j,k);
-  float ddzp = mLS->diffZp(i,j,k);
+  LevelSet::Derivatives d;
+  mLS->getDerivatives(i,j,k, d, LevelSet::FIRST_ORDER);
+  godunov(d, a, ddx2, ddy2, ddz2);
+}
 
-  if (a > 0) {
-    ddx2 = std::max( std::pow(std::max(ddxm,0.0f),2), std::pow(std::min(ddxp,0.0f),2) );
-    ddy2 = std::max( std::pow(std::max(ddym,0.0f),2), std::pow(std::min(ddyp,0.0f),2) );
-    ddz2 = std::max( std::pow(std::max(ddzm,0.0f),2), std::pow(std::min(ddzp,0.0f),2) );
-  }
-  else {
-    ddx2 = std::max( std::pow(std::min(ddxm,0.0f),2), std::pow(std::max(ddxp,0.0f),2) );
-    ddy2 = std::max( std::pow(std::min(ddym,0.0f),2), std::pow(std::max(ddyp,0.0f),2) );
-    ddz2 = std::max( std::pow(std::min(ddzm,0.0f),2), std::pow(std::max(ddzp,0.0f),2) );
+void LevelSetOperator::godunov(const LevelSet::Derivatives & d, float a,
+                               float & ddx2, float & ddy2, float & ddz2)
+{
+  ddx2 = LevelSetKernels::godunov(a, d.ddxm, d.ddxp);
+  ddy2 = LevelSetKernels::godunov(a, d.ddym, d.ddyp);
+  ddz2 = LevelSetKernels::godunov(a, d.ddzm, d.ddzp);
+}
+
+void LevelSetOperator::godunov(const LevelSet::Derivatives * d, const float * a, int count,
+                               float * ddx2, float * ddy2, float * ddz2)
+{
+  // Gather the one sided differentials so each axis is one array per side
+  float ddm[3][BATCH_SIZE], ddp[3][BATCH_SIZE];
+  for (int n = 0; n < count; n++) {
+    ddm[0][n] = d[n].ddxm;  ddp[0][n] = d[n].ddxp;
+    ddm[1][n] = d[n].ddym;  ddp[1][n] = d[n].ddyp;
+    ddm[2][n] = d[n].ddzm;  ddp[2][n] = d[n].ddzp;
   }
+  LevelSetKernels::godunov(a, ddm[0], ddp[0], ddx2, count);
+  LevelSetKernels::godunov(a, ddm[1], ddp[1], ddy2, count);
+  LevelSetKernels::godunov(a, ddm[2], ddp[2], ddz2, count);
 }
 
 Vector3<float> LevelSetOperator::gradient( const Vector3<float>& v, const float& i, const float& j, const float& k, bool useWENO )
+	{
+	LevelSet::Derivatives d;
+	mLS->getDerivatives(i, j, k, d, useWENO ? LevelSet::WENO : LevelSet::FIRST_ORDER);
+	return gradient(v, d, useWENO);
+	}
+
+Vector3<float> LevelSetOperator::gradient( const Vector3<float>& v, const LevelSet::Derivatives& d, bool useWENO )
 	{
 	// calculate upwind differentials
 	float ddx, ddy, ddz;
 	if(!useWENO)
 		{
 		// flow in the negative direction: use upwind difXp
-		ddx = ( v.x() < 0.0f ) ? mLS->diffXp(i, j, k) : mLS->diffXm(i, j, k);
-		ddy = ( v.y() < 0.0f ) ? mLS->diffYp(i, j, k) : mLS->diffYm(i, j, k);
-		ddz = ( v.z() < 0.0f ) ? mLS->diffZp(i, j, k) : mLS->diffZm(i, j, k);
+		ddx = ( v.x() < 0.0f ) ? d.ddxp : d.ddxm;
+		ddy = ( v.y() < 0.0f ) ? d.ddyp : d.ddym;
+		ddz = ( v.z() < 0.0f ) ? d.ddzp : d.ddzm;
 		}
 	else
 		{
 		// flow in the negative direction: use upwind difXp
-		ddx = ( v.x() < 0.0f ) ? mLS->diffXpWENO(i, j, k) : mLS->diffXmWENO(i, j, k);
-		ddy = ( v.y() < 0.0f ) ? mLS->diffYpWENO(i, j, k) : mLS->diffYmWENO(i, j, k);
-		ddz = ( v.z() < 0.0f ) ? mLS->diffZpWENO(i, j, k) : mLS->diffZmWENO(i, j, k);
+		ddx = ( v.x() < 0.0f ) ? d.ddxpWENO : d.ddxmWENO;
+		ddy = ( v.y() < 0.0f ) ? d.ddypWENO : d.ddymWENO;
+		ddz = ( v.z() < 0.0f ) ? d.ddzpWENO : d.ddzmWENO;
 		}
 
 	// compute time differential as dot product
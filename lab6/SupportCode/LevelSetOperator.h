@@ -14,11 +14,64 @@
 
 #include "LevelSet.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*!
+ * Base class for level set operators. The operators compute the values of the
+ * next time step for the whole narrow band into a buffer before writing them
+ * back, so the narrow band sweeps are split into one contiguous chunk per
+ * thread when the code is compiled with OpenMP.
+ */
 class LevelSetOperator
 	{
+	public :
+		/*!
+		 * Time integration schemes. The Runge-Kutta schemes are the total variation
+		 * diminishing (TVD) schemes of Shu and Osher, the value is the number of stages.
+		 */
+		enum Integrator { EULER = 1, TVD_RK2 = 2, TVD_RK3 = 3 };
+
+	private :
+		//! Number of threads used for narrow band sweeps, 0 uses all cores
+		static int mNumThreads;
+
+		//! Band sized buffers for integrate(), kept between steps so the time stepping does not allocate
+		std::vector<float> mRate;
+		std::vector<float> mPhiN;
+
 	protected :
 		LevelSet * mLS;
 
+		Integrator mIntegrator;
+
+		/*!
+		 * The spatial part of the operator. Computes the time derivative of phi at
+		 * every grid point of the narrow band from the current grid values into rate,
+		 * which has the size of the narrow band. Operators that step with integrate()
+		 * implement this, integrate() calls it once per stage.
+		 */
+		virtual void computeRate(std::vector<float> & rate);
+
+		/*!
+		 * Advances the narrow band by dt with the selected integrator. The narrow
+		 * band must stay the same during the step.
+		 */
+		void integrate(float dt);
+
+		/*!
+		 * Returns how much longer the stable time step of a diffusive operator, such as
+		 * mean curvature flow, is with the integrator than with forward Euler. The
+		 * stable interval on the negative real axis is 2 for Euler and TVD-RK2, and
+		 * 2.51 for TVD-RK3. The TVD schemes share the time step limit of forward Euler
+		 * for the upwind (hyperbolic) operators.
+		 */
+		static float getDiffusiveStabilityFactor(Integrator integrator)
+			{
+			return integrator == TVD_RK3 ? 1.25f : 1.0f;
+			}
+
 		//! Exposes access to the level set grid internally
 		LevelSetGrid & getGrid() { return mLS->mGrid; }
 		const LevelSetGrid & getGrid() const { return mLS->mGrid; }
@@ -27,6 +80,36 @@ class LevelSetOperator
 		void godunov(unsigned int i, unsigned int j, unsigned int k, float a,
 			float & ddx2, float & ddy2, float & ddz2);
 
+		//! Computes the squares of the gradients using Godunovs method from precomputed one sided differentials
+		void godunov(const LevelSet::Derivatives & d, float a,
+			float & ddx2, float & ddy2, float & ddz2);
+
+		//! Computes the squares of the gradients using Godunovs method for a batch of count grid points with the SIMD kernels
+		void godunov(const LevelSet::Derivatives * d, const float * a, int count,
+			float * ddx2, float * ddy2, float * ddz2);
+
+		//! Number of narrow band grid points processed together by the SIMD kernels
+		static const int BATCH_SIZE = LevelSetKernels::BATCH_SIZE;
+
+		//! Returns the number of batches covering the narrow band
+		int getNumBatches() const
+			{
+			return ((int)getGrid().getNarrowBandSize() + BATCH_SIZE - 1) / BATCH_SIZE;
+			}
+
+		/*!
+		 * Reads the coordinates of the grid points in batch b of the narrow band,
+		 * which starts at narrow band index b*BATCH_SIZE, and returns their number.
+		 */
+		int getNarrowBandBatch(int b, int * i, int * j, int * k) const
+			{
+			const int first = b*BATCH_SIZE;
+			const int count = std::min((int)BATCH_SIZE, (int)getGrid().getNarrowBandSize() - first);
+			for (int n = 0; n < count; n++)
+				getGrid().getNarrowBandPoint(first + n, i[n], j[n], k[n]);
+			return count;
+			}
+
 		float forwardEuler( const float& i, const float& j, const float& k, const float& velocity, const float& dt );
 
 		Vector3<float> gradient( const Vector3<float>& v, const float& i, const float& j, const float& k) 
@@ -36,12 +119,24 @@ class LevelSetOperator
 
 		Vector3<float> gradient( const Vector3<float>& v, const float& i, const float& j, const float& k, bool useWENO );
 
+		//! Upwind gradient from precomputed differentials, d must hold the WENO differentials if useWENO is set
+		Vector3<float> gradient( const Vector3<float>& v, const LevelSet::Derivatives& d, bool useWENO );
+
 
 	public :
 
-		LevelSetOperator(LevelSet * LS) : mLS(LS) { }
+		LevelSetOperator(LevelSet * LS) : mLS(LS), mIntegrator(EULER) { }
 		virtual ~LevelSetOperator() {}
 		virtual void propagate(float time) = 0;
+
+		//! Selects the time integration scheme of operators that step with integrate()
+		void setIntegrator(Integrator integrator) { mIntegrator = integrator; }
+		Integrator getIntegrator() const { return mIntegrator; }
+
+		//! Sets the number of threads used for narrow band sweeps, 1 runs serially and 0 uses all cores
+		static void setNumThreads(int numThreads) { mNumThreads = numThreads; }
+		//! Returns the number of threads used for narrow band sweeps
+		static int getNumThreads();
 	};
 
 
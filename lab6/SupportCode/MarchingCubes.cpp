@@ -10,6 +10,14 @@
  *
  *************************************************************************************************/
 #include "MarchingCubes.h"
+#include "MarchingCubesTable.h"
+#include <algorithm>
+#include <limits>
+#include <cassert>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /*!
  * Grabbed from:
@@ -19,9 +27,8 @@
  * NB! Uses clockwise orientation.
  */
 std::vector<Vector3<float> > triangulate(float voxelValues[8], float i, float j, float k, float delta) {
-#include "MarchingCubesTable.h"
   int cubeindex = 0;
-  static Vector3<float> vertlist[12];
+  Vector3<float> vertlist[12];
   std::vector<Vector3<float> > verts;
 
   if (voxelValues[0] < 0.f) cubeindex |= 1;
@@ -84,3 +91,230 @@ std::vector<Vector3<float> > triangulate(float voxelValues[8], float i, float j,
 
   return verts;
 }
+
+
+const unsigned int MarchingCubes::NONE = std::numeric_limits<unsigned int>::max();
+int MarchingCubes::mNumThreads = 0;
+
+// The corners at the ends of each edge in the order ::triangulate() finds the
+// roots, and the offsets of the corners from the first corner of the cell
+static const int edgeCorners[12][2] = {
+  {0,1}, {1,2}, {3,2}, {0,3}, {4,5}, {5,6}, {7,6}, {4,7}, {0,4}, {1,5}, {2,6}, {3,7}
+};
+static const int edgeAxis[12] = { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 };
+static const int cornerOffsets[8][3] = {
+  {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1}
+};
+
+
+MarchingCubes::MarchingCubes(const std::vector<float> & xs, const std::vector<float> & ys, const std::vector<float> & zs,
+                             float delta, IndexedMesh & mesh)
+  : mXs(xs), mYs(ys), mZs(zs), mDelta(delta), mMesh(mesh), mGradients(NULL), mSlab(-2)
+{
+  mChunkPlanes[0] = mChunkPlanes[1] = -1;
+
+  const unsigned int planeSize = mYs.size()*mZs.size();
+  mEdgeX.resize(planeSize);
+  for (unsigned int p = 0; p < 2; p++) {
+    mEdgeY[p].resize(planeSize);
+    mEdgeZ[p].resize(planeSize);
+    mCorner[p].resize(planeSize);
+  }
+}
+
+
+void MarchingCubes::setSlab(int i)
+{
+  if (i == mSlab) return;
+  assert(i > mSlab);
+
+  // The second plane of a slab is the first plane of the next
+  if (i == mSlab + 1) {
+    mEdgeY[0].swap(mEdgeY[1]);
+    mEdgeZ[0].swap(mEdgeZ[1]);
+    mCorner[0].swap(mCorner[1]);
+  }
+  else {
+    std::fill(mEdgeY[0].begin(), mEdgeY[0].end(), NONE);
+    std::fill(mEdgeZ[0].begin(), mEdgeZ[0].end(), NONE);
+    std::fill(mCorner[0].begin(), mCorner[0].end(), NONE);
+  }
+  std::fill(mEdgeY[1].begin(), mEdgeY[1].end(), NONE);
+  std::fill(mEdgeZ[1].begin(), mEdgeZ[1].end(), NONE);
+  std::fill(mCorner[1].begin(), mCorner[1].end(), NONE);
+  std::fill(mEdgeX.begin(), mEdgeX.end(), NONE);
+  mSlab = i;
+}
+
+
+unsigned int MarchingCubes::getVertex(int j, int k, int edge, const float voxelValues[8])
+{
+  const int c0 = edgeCorners[edge][0], c1 = edgeCorners[edge][1];
+  const float t = root(voxelValues[c0], voxelValues[c1]);
+  const int stride = mZs.size();
+
+  unsigned int * cached;
+  Vector3<float> v;
+  // The plane and the key of vertices not on an x edge, for the chunk vertices
+  int plane = -1, kind = 0, n = 0;
+  if (t == 0 || t == 1) {
+    // The vertex is at a corner, where ::triangulate() gives every edge the
+    // same position and the meshes weld them
+    const int * o = cornerOffsets[t == 0 ? c0 : c1];
+    n = (j+o[1])*stride + k+o[2];
+    cached = &mCorner[o[0]][n];
+    v = Vector3<float>(mXs[mSlab+o[0]], mYs[j+o[1]], mZs[k+o[2]]);
+    plane = mSlab + o[0];
+    kind = CORNER;
+  }
+  else {
+    const int * o = cornerOffsets[c0];
+    n = (j+o[1])*stride + k+o[2];
+    plane = mSlab + o[0];
+    switch (edgeAxis[edge]) {
+    case 0:
+      cached = &mEdgeX[n];
+      v = Vector3<float>(mXs[mSlab] + t*mDelta, mYs[j+o[1]], mZs[k+o[2]]);
+      plane = -1;
+      break;
+    case 1:
+      cached = &mEdgeY[o[0]][n];
+      v = Vector3<float>(mXs[mSlab+o[0]], mYs[j] + t*mDelta, mZs[k+o[2]]);
+      kind = Y_EDGE;
+      break;
+    default:
+      cached = &mEdgeZ[o[0]][n];
+      v = Vector3<float>(mXs[mSlab+o[0]], mYs[j+o[1]], mZs[k] + t*mDelta);
+      kind = Z_EDGE;
+      break;
+    }
+  }
+
+  if (*cached == NONE) {
+    *cached = mMesh.mFirstVert + mMesh.mVerts.size();
+    mMesh.mVerts.push_back(v);
+    if (mGradients != NULL)
+      mMesh.mNormals.push_back(getNormal(*mGradients, v));
+
+    for (unsigned int p = 0; p < 2; p++)
+      if (plane >= 0 && plane == mChunkPlanes[p])
+        mChunkVertices[p].push_back(std::make_pair(kind*mYs.size()*stride + n, *cached));
+  }
+  return *cached;
+}
+
+
+void MarchingCubes::addCell(int i, int j, int k, const float voxelValues[8])
+{
+  int cubeindex = 0;
+  for (int c = 0; c < 8; c++)
+    if (voxelValues[c] < 0.f) cubeindex |= 1 << c;
+
+  /* Cube is entirely in/out of the surface */
+  if (edgeTable[cubeindex] == 0)
+    return;
+
+  setSlab(i);
+  const int * tri = triTable[cubeindex];
+  for (unsigned int m = 0; tri[m] != -1; m += 3) {
+    // The table is clockwise, flip the triangles like the callers of ::triangulate()
+    const unsigned int v0 = getVertex(j, k, tri[m  ], voxelValues);
+    const unsigned int v2 = getVertex(j, k, tri[m+2], voxelValues);
+    const unsigned int v1 = getVertex(j, k, tri[m+1], voxelValues);
+    mMesh.mIndices.push_back(v0);
+    mMesh.mIndices.push_back(v2);
+    mMesh.mIndices.push_back(v1);
+  }
+}
+
+
+void MarchingCubes::setChunk(int firstSlab, int endSlab)
+{
+  mChunkPlanes[0] = firstSlab;
+  mChunkPlanes[1] = endSlab;
+}
+
+
+void MarchingCubes::merge(const std::vector<MarchingCubes *> & chunks, IndexedMesh & mesh)
+{
+  if (chunks.empty()) return;
+
+  // The indices in mesh of the vertices on the last plane of the previous
+  // chunk, by key. Only the recorded entries are reset between the chunks
+  std::vector<unsigned int> plane(3*chunks[0]->mYs.size()*chunks[0]->mZs.size(), NONE);
+  std::vector<unsigned int> remap;
+
+  for (unsigned int c = 0; c < chunks.size(); c++) {
+    const IndexedMesh & chunkMesh = chunks[c]->mMesh;
+    remap.assign(chunkMesh.mVerts.size(), NONE);
+
+    const std::vector<std::pair<unsigned int, unsigned int> > & first = chunks[c]->mChunkVertices[0];
+    for (unsigned int n = 0; n < first.size(); n++)
+      remap[first[n].second] = plane[first[n].first];
+
+    // The chunk numbers its vertices in order of first use, skipping those
+    // the previous chunk added keeps that order for the whole mesh
+    for (unsigned int v = 0; v < remap.size(); v++) {
+      if (remap[v] == NONE) {
+        remap[v] = mesh.mVerts.size();
+        mesh.mVerts.push_back(chunkMesh.mVerts[v]);
+        if (!chunkMesh.mNormals.empty())
+          mesh.mNormals.push_back(chunkMesh.mNormals[v]);
+      }
+    }
+    for (unsigned int n = 0; n < chunkMesh.mIndices.size(); n++)
+      mesh.mIndices.push_back(remap[chunkMesh.mIndices[n]]);
+
+    if (c > 0) {
+      const std::vector<std::pair<unsigned int, unsigned int> > & previous = chunks[c-1]->mChunkVertices[1];
+      for (unsigned int n = 0; n < previous.size(); n++)
+        plane[previous[n].first] = NONE;
+    }
+    const std::vector<std::pair<unsigned int, unsigned int> > & last = chunks[c]->mChunkVertices[1];
+    for (unsigned int n = 0; n < last.size(); n++)
+      plane[last[n].first] = remap[last[n].second];
+  }
+}
+
+
+Vector3<float> MarchingCubes::getNormal(const Function3D<Vector3<float> > & gradients, const Vector3<float> & v)
+{
+  Vector3<float> normal = gradients.getValue(v[0], v[1], v[2]);
+  const float length = normal.length();
+  return length > 0 ? normal / length : normal;
+}
+
+
+int MarchingCubes::getNumThreads()
+{
+#ifdef _OPENMP
+  if (mNumThreads <= 0)
+    return omp_get_max_threads();
+  return mNumThreads;
+#else
+  return 1;
+#endif
+}
+
+
+void MarchingCubes::addSlab(int i, const float * slab0, const float * slab1, const unsigned char * cells)
+{
+  const unsigned int cellsY = mYs.size() - 1, cellsZ = mZs.size() - 1;
+  for (unsigned int j = 0; j < cellsY; j++) {
+    for (unsigned int k = 0; k < cellsZ; k++) {
+      if (cells != NULL && !cells[j*cellsZ + k]) continue;
+      const unsigned int n0 = j*(cellsZ+1) + k, n1 = n0 + cellsZ+1;
+      const float voxelValues[8] = {
+        slab0[n0],
+        slab1[n0],
+        slab1[n1],
+        slab0[n1],
+        slab0[n0+1],
+        slab1[n0+1],
+        slab1[n1+1],
+        slab0[n1+1]
+      };
+      addCell(i, j, k, voxelValues);
+    }
+  }
+}
@@ -15,9 +15,130 @@
 #include <vector>
 #include "Vector3.h"
 #include "Util.h"
+#include "Function3D.h"
 
 //! Method to triangulate a voxel
 std::vector<Vector3<float> > triangulate(float voxelValues[8], float i, float j, float k, float delta);
 
 
+//! Triangles indexing into a list of vertices, three indices per triangle in counter clockwise order
+struct IndexedMesh {
+  IndexedMesh() : mFirstVert(0) { }
+
+  std::vector<Vector3<float> > mVerts;
+  std::vector<unsigned int> mIndices;
+  //! Unit normals of the vertices, empty unless the extractor was given gradients
+  std::vector<Vector3<float> > mNormals;
+  //! Index of mVerts[0], the vertices before it have been written out, see ObjIO::saveIndexed()
+  unsigned int mFirstVert;
+};
+
+
+/*! \brief Marching cubes with vertices shared between the cells
+ *
+ * ::triangulate() returns every triangle with its own copy of the vertices,
+ * which the meshes then weld by looking up their positions. MarchingCubes
+ * instead caches the index of the vertex on each edge of the slab of cells
+ * between two x planes, and on the edges and at the corners of both planes,
+ * so a vertex is computed once and reused by all cells around its edge. A
+ * vertex exactly at a grid corner is shared by all the edges meeting there.
+ * The triangles and vertices are written to an IndexedMesh in the order that
+ * ::triangulate() followed by Mesh::addTriangle() would give them.
+ *
+ * The cells are added in non-decreasing x order, in any order within a slab.
+ * Only the vertices of the current slab are looked up again, by index, so the
+ * mesh can be written out and cleared between the slabs, see ObjIO::saveIndexed().
+ *
+ * To extract in parallel the slabs are split into chunks, see setChunk(), each
+ * extracted by its own MarchingCubes into its own IndexedMesh. merge() then
+ * joins them into the mesh a single MarchingCubes would have given, so the
+ * result does not depend on the number of threads.
+ */
+class MarchingCubes
+{
+public :
+  /*!
+   * The corners of cell (i,j,k) are at (xs[i], ys[j], zs[k]) and the next
+   * coordinates, the cell size is delta, with xs[i+1] = xs[i] + delta and so
+   * on. The triangles are added to mesh.
+   */
+  MarchingCubes(const std::vector<float> & xs, const std::vector<float> & ys, const std::vector<float> & zs,
+                float delta, IndexedMesh & mesh);
+
+  //! Triangulates cell (i,j,k), with the corner values ordered as for ::triangulate()
+  void addCell(int i, int j, int k, const float voxelValues[8]);
+
+  /*!
+   * Triangulates all cells of slab i, slab0 and slab1 holding the values at
+   * the corners of the planes xs[i] and xs[i+1] with index j*zs.size() + k.
+   * If cells is not NULL only the cells (i,j,k) with cells[j*(zs.size()-1) + k]
+   * set are triangulated, and only their corners need to hold values.
+   */
+  void addSlab(int i, const float * slab0, const float * slab1, const unsigned char * cells = NULL);
+
+  /*!
+   * Makes this the extractor of the chunk of slabs firstSlab to endSlab-1,
+   * recording the vertices on the planes xs[firstSlab] and xs[endSlab] for merge()
+   */
+  void setChunk(int firstSlab, int endSlab);
+
+  /*!
+   * Adds the normalized value of gradients at every new vertex to the normals
+   * of the mesh, so it needs no pass over the triangles for its normals. NULL,
+   * the default, adds no normals. gradients is evaluated from all threads.
+   */
+  void setGradients(const Function3D<Vector3<float> > * gradients) { mGradients = gradients; }
+
+  //! Number of slabs before the first slab of a chunk it needs, see SurfaceNets
+  static const int CHUNK_OVERLAP = 0;
+
+  /*!
+   * Appends the meshes of chunks, which cover consecutive ranges of slabs in
+   * increasing x order, to mesh. The vertices on the plane between two chunks
+   * are added once, and all vertices in the order of first use, as if the
+   * chunks were extracted one after the other by a single MarchingCubes.
+   */
+  static void merge(const std::vector<MarchingCubes *> & chunks, IndexedMesh & mesh);
+
+  //! Sets the number of threads, and chunks, the triangulate() methods use. 0 uses all cores
+  static void setNumThreads(int numThreads) { mNumThreads = numThreads; }
+  static int getNumThreads();
+
+  //! Returns the normalized value of gradients at v, zero where it vanishes
+  static Vector3<float> getNormal(const Function3D<Vector3<float> > & gradients, const Vector3<float> & v);
+
+protected :
+  //! Marks edges and corners without a vertex in the caches
+  static const unsigned int NONE;
+  //! Number of threads for extraction, 0 uses all cores
+  static int mNumThreads;
+
+  //! The kinds of vertices on a plane, for the keys of the recorded vertices
+  enum PlaneVertex { Y_EDGE, Z_EDGE, CORNER };
+
+  //! Moves the caches to slab i
+  void setSlab(int i);
+  //! Returns the index of the vertex on an edge of cell (mSlab,j,k), adding it to the mesh the first time
+  unsigned int getVertex(int j, int k, int edge, const float voxelValues[8]);
+
+  std::vector<float> mXs, mYs, mZs;
+  float mDelta;
+  IndexedMesh & mMesh;
+  //! The gradients for the normals of the vertices, or NULL
+  const Function3D<Vector3<float> > * mGradients;
+
+  //! The slab the caches hold
+  int mSlab;
+  //! Vertex indices on the x edges of the slab, and on the y and z edges and at
+  //! the corners of its two planes, at j*zs.size() + k
+  std::vector<unsigned int> mEdgeX, mEdgeY[2], mEdgeZ[2], mCorner[2];
+
+  //! The planes bounding the chunk, -1 when not a chunk
+  int mChunkPlanes[2];
+  //! The vertices on the planes bounding the chunk, as pairs of
+  //! (kind*ys.size() + j)*zs.size() + k and vertex index, in order of creation
+  std::vector<std::pair<unsigned int, unsigned int> > mChunkVertices[2];
+};
+
+
 #endif
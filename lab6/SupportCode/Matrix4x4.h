@@ -14,6 +14,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <iostream>
 
 template <typename Real> class Vector3;
 template <typename Real> class Vector4;
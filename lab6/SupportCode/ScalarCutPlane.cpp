@@ -15,6 +15,7 @@
 #include "glext.h"
 #include "Util.h"
 #include <cassert>
+#include <vector>
 
 ScalarCutPlane::ScalarCutPlane(float dx, const Function3D<float> * function, const ColorMap * map)
   : mDx(dx), mFunction(function), mMap(map), mTextureID(0)
@@ -79,6 +80,10 @@ void ScalarCutPlane::update()
 
   std::cerr << "Building scalar cut plane of size " << mWidth << "x" << mHeight << std::endl;
 
+  // Transform the pixel centers first and evaluate the function for all of
+  // them at once, which lets it use a batched path
+  std::vector<float> px, py, pz;
+  std::vector<unsigned int> pixels;
   float x = 0;
   float y,z;
   unsigned int j = 0, k = 0;
@@ -87,17 +92,26 @@ void ScalarCutPlane::update()
       Vector4<float> vec(x,y,z,1);
       vec = mTransform*vec;
 
-      float val = mFunction->getValue(vec[0], vec[1], vec[2]);
-      Vector3<float> c = mMap->map(val, 0, 1);
-
       assert(j < mWidth && k < mHeight);
-      image[3*(j + mWidth*k)    ] = c[0];
-      image[3*(j + mWidth*k) + 1] = c[1];
-      image[3*(j + mWidth*k) + 2] = c[2];
+      px.push_back(vec[0]);
+      py.push_back(vec[1]);
+      pz.push_back(vec[2]);
+      pixels.push_back(j + mWidth*k);
     }
     k = 0;
   }
 
+  std::vector<float> values(pixels.size());
+  if (!pixels.empty())
+    mFunction->getValues(&px[0], &py[0], &pz[0], &values[0], pixels.size());
+
+  for (unsigned int n = 0; n < pixels.size(); n++) {
+    Vector3<float> c = mMap->map(values[n], 0, 1);
+    image[3*pixels[n]    ] = c[0];
+    image[3*pixels[n] + 1] = c[1];
+    image[3*pixels[n] + 2] = c[2];
+  }
+
   if (glIsTexture(mTextureID) == GL_FALSE)
     glGenTextures(1, &mTextureID);
 
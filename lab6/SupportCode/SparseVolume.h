@@ -0,0 +1,368 @@
+/*************************************************************************************************
+*
+* Modeling and animation (TNM079) 2007
+* Code base for lab assignments. Copyright:
+*   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+*   Ken Museth (ken.museth@itn.liu.se)
+*   Michael Bang Nielsen (bang@daimi.au.dk)
+*   Ola Nilsson (ola.nilsson@itn.liu.se)
+*   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+*
+*************************************************************************************************/
+#ifndef __sparse_volume_h__
+#define __sparse_volume_h__
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include "Util.h"
+
+/*!
+ * A sparse, block tiled 3D volume of templated type T.
+ *
+ * The index space is split into tiles of LEAF_DIM^3 voxels. A dense (but small)
+ * root table stores one entry per tile, which is either a constant tile value or
+ * a reference to a leaf holding LEAF_DIM^3 values and an active bit per voxel.
+ * Only tiles that are written to, i.e. tiles close to the interface of a level
+ * set, allocate leaves, so memory grows with the active area instead of the
+ * volume. Leaves are stored by index in an stl vector, so the volume can be
+ * copied and assigned like Volume<T>.
+ */
+template<class T>
+class SparseVolume{
+public:
+  class Cursor;
+  friend class Cursor;
+
+  //! log2 of the leaf side length
+  static const int LOG2_LEAF_DIM = 3;
+  //! Number of voxels along each side of a leaf
+  static const int LEAF_DIM = 1 << LOG2_LEAF_DIM;
+  //! Number of voxels in a leaf
+  static const int LEAF_SIZE = LEAF_DIM*LEAF_DIM*LEAF_DIM;
+  //! Denotes a tile without leaf
+  static const int NO_LEAF = -1;
+
+protected:
+  //! A dense block of LEAF_DIM^3 values together with their active state
+  struct Leaf {
+    T mData[LEAF_SIZE];
+    unsigned int mActive[LEAF_SIZE/32];
+    int mNumActive;
+  };
+
+  //! An entry in the root table, either a constant value or a leaf
+  struct Tile {
+    Tile() : mLeaf(NO_LEAF), mValue() { }
+    Tile(const T & val) : mLeaf(NO_LEAF), mValue(val) { }
+    int mLeaf;
+    T mValue;
+  };
+
+  //! Root table, one entry per tile
+  std::vector<Tile> mTiles;
+  //! Leaf storage, referenced by index from the root table
+  std::vector<Leaf> mLeafs;
+  //! Unused entries in mLeafs, reused before growing
+  std::vector<int> mFreeLeafs;
+  //! The dimensions of the volume
+  int mDimX, mDimY, mDimZ;
+  //! The dimensions of the root table
+  int mTilesX, mTilesY, mTilesZ;
+
+  inline int tileIndex(int i, int j, int k) const {
+    return ((i >> LOG2_LEAF_DIM)*mTilesY + (j >> LOG2_LEAF_DIM))*mTilesZ + (k >> LOG2_LEAF_DIM);
+  }
+  inline static int leafOffset(int i, int j, int k) {
+    const int m = LEAF_DIM-1;
+    return ((i & m) << (2*LOG2_LEAF_DIM)) | ((j & m) << LOG2_LEAF_DIM) | (k & m);
+  }
+
+  //! Returns the leaf of tile t, allocating it from the tile value if needed
+  Leaf & touchLeaf(int t) {
+    Tile & tile = mTiles[t];
+    if (tile.mLeaf == NO_LEAF) {
+      if (mFreeLeafs.empty()) {
+        tile.mLeaf = mLeafs.size();
+        mLeafs.push_back(Leaf());
+      } else {
+        tile.mLeaf = mFreeLeafs.back();
+        mFreeLeafs.pop_back();
+      }
+      Leaf & leaf = mLeafs[tile.mLeaf];
+      std::fill(leaf.mData, leaf.mData + LEAF_SIZE, tile.mValue);
+      std::fill(leaf.mActive, leaf.mActive + LEAF_SIZE/32, 0u);
+      leaf.mNumActive = 0;
+    }
+    return mLeafs[tile.mLeaf];
+  }
+
+public:
+  //! Default constructor initializes to zero volume
+  SparseVolume() : mDimX(0), mDimY(0), mDimZ(0), mTilesX(0), mTilesY(0), mTilesZ(0) {}
+
+  //! Sized constructor initializes all tiles to the constant defaultVal, no leafs are allocated
+  SparseVolume(int dimX, int dimY, int dimZ, T defaultVal = T())
+    : mDimX(dimX), mDimY(dimY), mDimZ(dimZ),
+      mTilesX((dimX + LEAF_DIM-1) >> LOG2_LEAF_DIM),
+      mTilesY((dimY + LEAF_DIM-1) >> LOG2_LEAF_DIM),
+      mTilesZ((dimZ + LEAF_DIM-1) >> LOG2_LEAF_DIM)
+  {
+    mTiles.resize(mTilesX*mTilesY*mTilesZ, Tile(defaultVal));
+  }
+
+  inline int getDimX() const { return mDimX; }
+  inline int getDimY() const { return mDimY; }
+  inline int getDimZ() const { return mDimZ; }
+
+  inline int getTilesX() const { return mTilesX; }
+  inline int getTilesY() const { return mTilesY; }
+  inline int getTilesZ() const { return mTilesZ; }
+  inline int getNumTiles() const { return mTiles.size(); }
+
+  //! Returns the number of allocated leafs
+  inline int getNumLeafs() const { return mLeafs.size() - mFreeLeafs.size(); }
+
+  //! Returns the value at i,j,k, indices are clamped to the volume like Volume<T>
+  T getValue(int i, int j, int k) const {
+    i = clamp(i, 0, mDimX-1);
+    j = clamp(j, 0, mDimY-1);
+    k = clamp(k, 0, mDimZ-1);
+    const Tile & tile = mTiles[tileIndex(i,j,k)];
+    if (tile.mLeaf == NO_LEAF) return tile.mValue;
+    return mLeafs[tile.mLeaf].mData[leafOffset(i,j,k)];
+  }
+
+  //! Sets the value at i,j,k to val, does not change the active state
+  void setValue(int i, int j, int k, const T & val){
+    assert(i < mDimX && i >= 0 && j < mDimY && j >= 0 && k < mDimZ && k >= 0);
+    touchLeaf(tileIndex(i,j,k)).mData[leafOffset(i,j,k)] = val;
+  }
+
+  //! Returns the active state at i,j,k
+  bool isActive(int i, int j, int k) const {
+    if (i < 0 || i >= mDimX || j < 0 || j >= mDimY || k < 0 || k >= mDimZ) return false;
+    const Tile & tile = mTiles[tileIndex(i,j,k)];
+    if (tile.mLeaf == NO_LEAF) return false;
+    const int n = leafOffset(i,j,k);
+    return (mLeafs[tile.mLeaf].mActive[n >> 5] & (1u << (n & 31))) != 0;
+  }
+
+  //! Sets the active state at i,j,k. Returns true if the state changed.
+  bool setActive(int i, int j, int k, bool active){
+    assert(i < mDimX && i >= 0 && j < mDimY && j >= 0 && k < mDimZ && k >= 0);
+    const int t = tileIndex(i,j,k);
+    if (!active && mTiles[t].mLeaf == NO_LEAF) return false;
+    Leaf & leaf = touchLeaf(t);
+    const int n = leafOffset(i,j,k);
+    const unsigned int bit = 1u << (n & 31);
+    const bool wasActive = (leaf.mActive[n >> 5] & bit) != 0;
+    if (wasActive == active) return false;
+    if (active) {
+      leaf.mActive[n >> 5] |= bit;
+      leaf.mNumActive++;
+    } else {
+      leaf.mActive[n >> 5] &= ~bit;
+      leaf.mNumActive--;
+    }
+    return true;
+  }
+
+  //! Returns the constant value of tile t if it has no leaf
+  bool isConstantTile(int t, T & value) const {
+    if (mTiles[t].mLeaf != NO_LEAF) return false;
+    value = mTiles[t].mValue;
+    return true;
+  }
+
+  /*!
+   * Returns the LEAF_SIZE values of tile t, ordered like getLeafOffset(), and
+   * allocates its leaf if needed. Allocation is not thread safe and may move the
+   * values of the other tiles, but once all leafs are allocated the values of
+   * different tiles can be written from different threads.
+   */
+  T * getLeafValues(int t) {
+    return touchLeaf(t).mData;
+  }
+
+  //! Sets the active state of all voxels of tile t that are inside the volume
+  void setTileActive(int t, bool active) {
+    Leaf & leaf = touchLeaf(t);
+    leaf.mNumActive = 0;
+    for (int n = 0; n < LEAF_SIZE; n++) {
+      int i, j, k;
+      getCoordinates(t, n, i, j, k);
+      const unsigned int bit = 1u << (n & 31);
+      if (active && i < mDimX && j < mDimY && k < mDimZ) {
+        leaf.mActive[n >> 5] |= bit;
+        leaf.mNumActive++;
+      }
+      else
+        leaf.mActive[n >> 5] &= ~bit;
+    }
+  }
+
+  //! Makes tile t a constant tile with value val, releasing its leaf and clearing its active state
+  void setTileValue(int t, const T & val) {
+    Tile & tile = mTiles[t];
+    if (tile.mLeaf != NO_LEAF) {
+      mFreeLeafs.push_back(tile.mLeaf);
+      tile.mLeaf = NO_LEAF;
+    }
+    tile.mValue = val;
+  }
+
+  //! Position of voxel i,j,k in the values of its leaf
+  inline static int getLeafOffset(int i, int j, int k) { return leafOffset(i,j,k); }
+
+  //! Index of the tile holding voxel i,j,k
+  inline int getTileIndex(int i, int j, int k) const { return tileIndex(i,j,k); }
+
+  //! Converts tile index t and leaf offset n to i,j,k
+  void getCoordinates(int t, int n, int & i, int & j, int & k) const {
+    const int m = LEAF_DIM-1;
+    const int tk = t % mTilesZ;
+    const int tj = (t / mTilesZ) % mTilesY;
+    const int ti = t / (mTilesZ*mTilesY);
+    i = (ti << LOG2_LEAF_DIM) + ((n >> (2*LOG2_LEAF_DIM)) & m);
+    j = (tj << LOG2_LEAF_DIM) + ((n >> LOG2_LEAF_DIM) & m);
+    k = (tk << LOG2_LEAF_DIM) + (n & m);
+  }
+
+  /*!
+   * Finds the first active voxel at or after position (t,n) in tile order.
+   * Returns false, and t = getNumTiles(), if there are no more active voxels.
+   */
+  bool findNextActive(int & t, int & n) const {
+    const int numTiles = mTiles.size();
+    for (; t < numTiles; t++, n = 0) {
+      const int l = mTiles[t].mLeaf;
+      if (l == NO_LEAF || mLeafs[l].mNumActive == 0) continue;
+      const unsigned int * active = mLeafs[l].mActive;
+      for (int w = n >> 5; w < LEAF_SIZE/32; w++) {
+        unsigned int word = active[w];
+        if (w == (n >> 5)) word &= ~0u << (n & 31);
+        if (word == 0) continue;
+        int b = 0;
+        while (!(word & (1u << b))) b++;
+        n = (w << 5) + b;
+        return true;
+      }
+    }
+    n = 0;
+    return false;
+  }
+
+  /*!
+   * Stencil cursor for reading the neighbourhood of a voxel.
+   *
+   * The cursor caches the leaf and the position within the leaf of the voxel it
+   * points at. The leaf acts as a padded block around the voxel: neighbours in the
+   * same leaf are read by pointer offsets without any clamping or tile lookups,
+   * only neighbours in other leafs, or outside the volume, go through
+   * SparseVolume::getValue(). The padding of partial leafs on the border of the
+   * volume is never read.
+   */
+  class Cursor
+  {
+  public:
+    Cursor() : mVolume(NULL), mData(NULL), mValue() { }
+    Cursor(const SparseVolume<T> & volume, int i, int j, int k) : mVolume(&volume) { moveTo(i,j,k); }
+
+    //! Moves the cursor to voxel (i,j,k)
+    void moveTo(int i, int j, int k) {
+      mI = i; mJ = j; mK = k;
+      if (i < 0 || i >= mVolume->mDimX || j < 0 || j >= mVolume->mDimY || k < 0 || k >= mVolume->mDimZ) {
+        // Outside the volume, every lookup is clamped
+        mData = NULL;
+        mLi = mLj = mLk = OUTSIDE;
+        mEndI = mEndJ = mEndK = 0;
+        return;
+      }
+      const int m = LEAF_DIM-1;
+      mLi = i & m;  mLj = j & m;  mLk = k & m;
+      // Border leafs end at the volume, not at LEAF_DIM
+      mEndI = std::min(LEAF_DIM, mVolume->mDimX - (i - mLi));
+      mEndJ = std::min(LEAF_DIM, mVolume->mDimY - (j - mLj));
+      mEndK = std::min(LEAF_DIM, mVolume->mDimZ - (k - mLk));
+      const Tile & tile = mVolume->mTiles[mVolume->tileIndex(i,j,k)];
+      if (tile.mLeaf == NO_LEAF) {
+        mData = NULL;
+        mValue = tile.mValue;
+      }
+      else
+        mData = mVolume->mLeafs[tile.mLeaf].mData + leafOffset(i,j,k);
+    }
+
+    //! Value at the cursor
+    inline T getValue() const {
+      if (mLi == OUTSIDE) return mVolume->getValue(mI, mJ, mK);
+      return mData != NULL ? *mData : mValue;
+    }
+
+    //! Value at offset (di,dj,dk) from the cursor
+    inline T getValue(int di, int dj, int dk) const {
+      if ((unsigned int)(mLi + di) < (unsigned int)mEndI &&
+          (unsigned int)(mLj + dj) < (unsigned int)mEndJ &&
+          (unsigned int)(mLk + dk) < (unsigned int)mEndK)
+        return mData != NULL ? mData[(di*LEAF_DIM + dj)*LEAF_DIM + dk] : mValue;
+      return mVolume->getValue(mI + di, mJ + dj, mK + dk);
+    }
+
+  protected:
+    //! Leaf position that makes every offset fall outside the leaf
+    static const int OUTSIDE = -(1 << 24);
+
+    const SparseVolume<T> * mVolume;
+    //! Pointer to the voxel in its leaf, NULL for constant tiles
+    const T * mData;
+    //! Value of a constant tile
+    T mValue;
+    int mI, mJ, mK;
+    int mLi, mLj, mLk;
+    //! Extent of the leaf within the volume
+    int mEndI, mEndJ, mEndK;
+  };
+
+  /*!
+   * Collapses leafs without active voxels into constant tiles. A leaf is only
+   * collapsed if all its values inside the volume are equal, so no information
+   * is lost. The padding of leafs on the border is never read.
+   */
+  void prune(){
+    const int numTiles = mTiles.size();
+    for (int t = 0; t < numTiles; t++) {
+      Tile & tile = mTiles[t];
+      if (tile.mLeaf == NO_LEAF) continue;
+      const Leaf & leaf = mLeafs[tile.mLeaf];
+      if (leaf.mNumActive != 0) continue;
+      const T & first = leaf.mData[0];
+      int n = 1;
+      for (; n < LEAF_SIZE; n++) {
+        int i, j, k;
+        getCoordinates(t, n, i, j, k);
+        if (i < mDimX && j < mDimY && k < mDimZ && !(leaf.mData[n] == first)) break;
+      }
+      if (n < LEAF_SIZE) continue;
+      tile.mValue = first;
+      mFreeLeafs.push_back(tile.mLeaf);
+      tile.mLeaf = NO_LEAF;
+    }
+
+    // Give memory back if most leafs are unused, e.g. after a dense initialization
+    if (mFreeLeafs.size() > mLeafs.size()/2) {
+      std::vector<Leaf> leafs;
+      leafs.reserve(mLeafs.size() - mFreeLeafs.size());
+      for (int t = 0; t < numTiles; t++) {
+        Tile & tile = mTiles[t];
+        if (tile.mLeaf == NO_LEAF) continue;
+        leafs.push_back(mLeafs[tile.mLeaf]);
+        tile.mLeaf = leafs.size()-1;
+      }
+      mLeafs.swap(leafs);
+      std::vector<int>().swap(mFreeLeafs);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,257 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#include "SurfaceNets.h"
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <cmath>
+
+const unsigned int SurfaceNets::NONE = std::numeric_limits<unsigned int>::max();
+const float DualContouring::MASS_POINT_WEIGHT = 0.05f;
+
+// The corners at the ends of each edge and the offsets of the corners from the
+// first corner of the cell, as in MarchingCubes.cpp
+static const int edgeCorners[12][2] = {
+  {0,1}, {1,2}, {3,2}, {0,3}, {4,5}, {5,6}, {7,6}, {4,7}, {0,4}, {1,5}, {2,6}, {3,7}
+};
+static const int cornerOffsets[8][3] = {
+  {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1}
+};
+
+
+SurfaceNets::SurfaceNets(const std::vector<float> & xs, const std::vector<float> & ys, const std::vector<float> & zs,
+                         float delta, IndexedMesh & mesh)
+  : mXs(xs), mYs(ys), mZs(zs), mDelta(delta), mMesh(mesh), mGradients(NULL), mSlab(-2), mFirstSlab(0), mFirstVerts(0)
+{
+  mLastVerts[0] = mLastVerts[1] = 0;
+
+  const unsigned int cells = (mYs.size()-1)*(mZs.size()-1);
+  mCells[0].assign(cells, NONE);
+  mCells[1].assign(cells, NONE);
+}
+
+
+void SurfaceNets::setChunk(int firstSlab, int endSlab)
+{
+  mFirstSlab = firstSlab;
+}
+
+
+Vector3<float> SurfaceNets::placeVertex(const float voxelValues[8]) const
+{
+  Vector3<float> sum(0,0,0);
+  int count = 0;
+  for (int e = 0; e < 12; e++) {
+    const int c0 = edgeCorners[e][0], c1 = edgeCorners[e][1];
+    if ((voxelValues[c0] < 0.f) == (voxelValues[c1] < 0.f)) continue;
+
+    const float t = root(voxelValues[c0], voxelValues[c1]);
+    for (unsigned int a = 0; a < 3; a++)
+      sum[a] += cornerOffsets[c0][a] + t*(cornerOffsets[c1][a] - cornerOffsets[c0][a]);
+    count++;
+  }
+  return sum / (float)count;
+}
+
+
+void SurfaceNets::addQuad(unsigned int v0, unsigned int v1, unsigned int v2, unsigned int v3, bool flip)
+{
+  if (v0 == NONE || v1 == NONE || v2 == NONE || v3 == NONE) return;
+  if (flip) std::swap(v1, v3);
+
+  const std::vector<Vector3<float> > & verts = mMesh.mVerts;
+  const unsigned int tris[2][2][3] = {
+    { {v0, v1, v2}, {v0, v2, v3} },
+    { {v0, v1, v3}, {v1, v2, v3} }
+  };
+  const int split = (verts[v2] - verts[v0]).norm() <= (verts[v3] - verts[v1]).norm() ? 0 : 1;
+  for (unsigned int t = 0; t < 2; t++)
+    for (unsigned int n = 0; n < 3; n++)
+      mMesh.mIndices.push_back(tris[split][t][n]);
+}
+
+
+void SurfaceNets::addSlab(int i, const float * slab0, const float * slab1, const unsigned char * cells)
+{
+  assert(i > mSlab);
+  const unsigned int cellsY = mYs.size() - 1, cellsZ = mZs.size() - 1;
+  const unsigned int stride = cellsZ + 1;
+
+  // The cells of the previous slab are kept only if it is slab i-1
+  mCells[0].swap(mCells[1]);
+  if (i != mSlab + 1)
+    std::fill(mCells[0].begin(), mCells[0].end(), NONE);
+  std::vector<unsigned int> & previous = mCells[0];
+  std::vector<unsigned int> & current = mCells[1];
+  mSlab = i;
+
+  // The vertices of the cells the surface passes through
+  const unsigned int firstVert = mMesh.mVerts.size();
+  for (unsigned int j = 0; j < cellsY; j++) {
+    for (unsigned int k = 0; k < cellsZ; k++) {
+      unsigned int & vertex = current[j*cellsZ + k];
+      vertex = NONE;
+      if (cells != NULL && !cells[j*cellsZ + k]) continue;
+
+      const unsigned int n0 = j*stride + k, n1 = n0 + stride;
+      const float voxelValues[8] = {
+        slab0[n0], slab1[n0], slab1[n1], slab0[n1],
+        slab0[n0+1], slab1[n0+1], slab1[n1+1], slab0[n1+1]
+      };
+      bool inside = false, outside = false;
+      for (unsigned int c = 0; c < 8; c++) {
+        if (voxelValues[c] < 0.f) inside = true;
+        else outside = true;
+      }
+      if (!inside || !outside) continue;
+
+      const Vector3<float> p = placeVertex(voxelValues);
+      vertex = mMesh.mVerts.size();
+      mMesh.mVerts.push_back(Vector3<float>(mXs[i] + p[0]*mDelta, mYs[j] + p[1]*mDelta, mZs[k] + p[2]*mDelta));
+      if (mGradients != NULL)
+        mMesh.mNormals.push_back(MarchingCubes::getNormal(*mGradients, mMesh.mVerts.back()));
+    }
+  }
+
+  // The vertices of the slab before the chunk are already in the previous
+  // chunk, which also added the quads that need them
+  if (i < mFirstSlab) {
+    mFirstVerts = mMesh.mVerts.size();
+    return;
+  }
+  mLastVerts[0] = firstVert;
+  mLastVerts[1] = mMesh.mVerts.size();
+
+  // The quads are oriented to face the positive side of their edge. Edges
+  // whose cells miss a vertex do not cross the surface, and their values may
+  // not have been evaluated, so the vertices are checked first
+
+  // Edges along x inside the slab
+  for (unsigned int j = 1; j < cellsY; j++) {
+    for (unsigned int k = 1; k < cellsZ; k++) {
+      const unsigned int n = j*stride + k;
+      if ((slab0[n] < 0.f) == (slab1[n] < 0.f)) continue;
+      addQuad(current[(j-1)*cellsZ + k-1], current[j*cellsZ + k-1],
+              current[j*cellsZ + k], current[(j-1)*cellsZ + k], slab0[n] >= 0.f);
+    }
+  }
+
+  // Edges along y and z on the plane between the slab and the previous one
+  for (unsigned int j = 0; j < cellsY; j++) {
+    for (unsigned int k = 1; k < cellsZ; k++) {
+      const unsigned int n = j*stride + k;
+      const unsigned int c0 = j*cellsZ + k-1, c1 = j*cellsZ + k;
+      if (previous[c0] == NONE || previous[c1] == NONE || current[c0] == NONE || current[c1] == NONE) continue;
+      if ((slab0[n] < 0.f) == (slab0[n + stride] < 0.f)) continue;
+      addQuad(previous[c0], previous[c1], current[c1], current[c0], slab0[n] >= 0.f);
+    }
+  }
+  for (unsigned int j = 1; j < cellsY; j++) {
+    for (unsigned int k = 0; k < cellsZ; k++) {
+      const unsigned int n = j*stride + k;
+      const unsigned int c0 = (j-1)*cellsZ + k, c1 = j*cellsZ + k;
+      if (previous[c0] == NONE || previous[c1] == NONE || current[c0] == NONE || current[c1] == NONE) continue;
+      if ((slab0[n] < 0.f) == (slab0[n+1] < 0.f)) continue;
+      addQuad(previous[c0], current[c0], current[c1], previous[c1], slab0[n] >= 0.f);
+    }
+  }
+}
+
+
+void SurfaceNets::merge(const std::vector<SurfaceNets *> & chunks, IndexedMesh & mesh)
+{
+  // The vertices a chunk added for the slab before its first slab are, in the
+  // same order, those of the last slab of the previous chunk
+  unsigned int lastVerts = 0;
+  for (unsigned int c = 0; c < chunks.size(); c++) {
+    const SurfaceNets & chunk = *chunks[c];
+    const IndexedMesh & chunkMesh = chunk.mMesh;
+    assert(c == 0 ? chunk.mFirstVerts == 0 :
+           chunk.mFirstVerts == chunks[c-1]->mLastVerts[1] - chunks[c-1]->mLastVerts[0]);
+
+    const unsigned int offset = mesh.mVerts.size();
+    mesh.mVerts.insert(mesh.mVerts.end(), chunkMesh.mVerts.begin() + chunk.mFirstVerts, chunkMesh.mVerts.end());
+    if (!chunkMesh.mNormals.empty())
+      mesh.mNormals.insert(mesh.mNormals.end(), chunkMesh.mNormals.begin() + chunk.mFirstVerts, chunkMesh.mNormals.end());
+    for (unsigned int n = 0; n < chunkMesh.mIndices.size(); n++) {
+      const unsigned int v = chunkMesh.mIndices[n];
+      mesh.mIndices.push_back(v < chunk.mFirstVerts ? lastVerts + v : offset + v - chunk.mFirstVerts);
+    }
+    lastVerts = offset + chunk.mLastVerts[0] - chunk.mFirstVerts;
+  }
+}
+
+
+void DualContouring::merge(const std::vector<DualContouring *> & chunks, IndexedMesh & mesh)
+{
+  SurfaceNets::merge(std::vector<SurfaceNets *>(chunks.begin(), chunks.end()), mesh);
+}
+
+
+Vector3<float> DualContouring::placeVertex(const float voxelValues[8]) const
+{
+  // The mean of the crossings, and the normal equations of the planes through
+  // the crossings, A^T A x = A^T b, with A the normals and b their dot
+  // products with the crossings
+  const Vector3<float> mean = SurfaceNets::placeVertex(voxelValues);
+  float ata[3][3] = { {0,0,0}, {0,0,0}, {0,0,0} };
+  float atb[3] = { 0, 0, 0 };
+  for (int e = 0; e < 12; e++) {
+    const int c0 = edgeCorners[e][0], c1 = edgeCorners[e][1];
+    if ((voxelValues[c0] < 0.f) == (voxelValues[c1] < 0.f)) continue;
+
+    const float t = root(voxelValues[c0], voxelValues[c1]);
+    float p[3];
+    for (unsigned int a = 0; a < 3; a++)
+      p[a] = cornerOffsets[c0][a] + t*(cornerOffsets[c1][a] - cornerOffsets[c0][a]);
+
+    // Gradient of the trilinear interpolation at the crossing
+    float normal[3] = { 0, 0, 0 };
+    for (unsigned int c = 0; c < 8; c++) {
+      const int * o = cornerOffsets[c];
+      const float w[3] = { o[0] ? p[0] : 1-p[0], o[1] ? p[1] : 1-p[1], o[2] ? p[2] : 1-p[2] };
+      normal[0] += voxelValues[c] * (o[0] ? 1.f : -1.f) * w[1]*w[2];
+      normal[1] += voxelValues[c] * (o[1] ? 1.f : -1.f) * w[0]*w[2];
+      normal[2] += voxelValues[c] * (o[2] ? 1.f : -1.f) * w[0]*w[1];
+    }
+    const float length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+    if (length == 0) continue;
+
+    // Solved relative to the mean, which the weight pulls the vertex towards
+    const float d = ((p[0]-mean[0])*normal[0] + (p[1]-mean[1])*normal[1] + (p[2]-mean[2])*normal[2]) / length;
+    for (unsigned int a = 0; a < 3; a++) {
+      const float na = normal[a] / length;
+      for (unsigned int b = 0; b < 3; b++)
+        ata[a][b] += na * normal[b] / length;
+      atb[a] += na * d;
+    }
+  }
+  for (unsigned int a = 0; a < 3; a++)
+    ata[a][a] += MASS_POINT_WEIGHT;
+
+  // The weight keeps the system positive definite, solve it by Cramer's rule
+  const float det = ata[0][0]*(ata[1][1]*ata[2][2] - ata[1][2]*ata[2][1])
+                  - ata[0][1]*(ata[1][0]*ata[2][2] - ata[1][2]*ata[2][0])
+                  + ata[0][2]*(ata[1][0]*ata[2][1] - ata[1][1]*ata[2][0]);
+  Vector3<float> vertex;
+  for (unsigned int a = 0; a < 3; a++) {
+    float m[3][3];
+    for (unsigned int r = 0; r < 3; r++)
+      for (unsigned int c = 0; c < 3; c++)
+        m[r][c] = c == a ? atb[r] : ata[r][c];
+    const float detA = m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+                     - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+                     + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+    vertex[a] = std::min(std::max(mean[a] + detA / det, 0.f), 1.f);
+  }
+  return vertex;
+}
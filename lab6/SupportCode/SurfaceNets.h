@@ -0,0 +1,133 @@
+/*************************************************************************************************
+ *
+ * Modeling and animation (TNM079) 2007
+ * Code base for lab assignments. Copyright:
+ *   Gunnar Johansson (gunnar.johansson@itn.liu.se)
+ *   Ken Museth (ken.museth@itn.liu.se)
+ *   Michael Bang Nielsen (bang@daimi.au.dk)
+ *   Ola Nilsson (ola.nilsson@itn.liu.se)
+ *   Andreas Sderstrm (andreas.soderstrom@itn.liu.se)
+ *
+ *************************************************************************************************/
+#ifndef __surface_nets_h__
+#define __surface_nets_h__
+
+#include <vector>
+#include "Vector3.h"
+#include "MarchingCubes.h"
+
+/*! \brief Surface nets, a dual alternative to MarchingCubes
+ *
+ * Instead of vertices on the edges of the cells, every cell the surface passes
+ * through gets a single vertex inside it, and every edge the surface crosses
+ * gets a quad joining the vertices of the four cells around it. The quads are
+ * split along their shorter diagonal. This gives about as many triangles as
+ * marching cubes, one quad per crossed edge against two triangles per crossed
+ * cell on average, but without the slivers marching cubes makes where the
+ * surface passes close to a corner. placeVertex() puts the vertex at the mean of the
+ * crossings on the edges of the cell, see DualContouring for a vertex placement
+ * that keeps sharp features.
+ *
+ * The cell vertices are created for a whole slab of cells between two x planes
+ * at a time, see addSlab(), so the quads of the edges between two slabs need
+ * both slabs. Quads at the boundary of the cells, which miss some of their
+ * cells, are left out, so the mesh is open where the surface leaves the cells.
+ *
+ * Chunks of slabs are extracted in parallel like with MarchingCubes, each chunk
+ * also adding the slab before its first one, see CHUNK_OVERLAP.
+ */
+class SurfaceNets
+{
+public :
+  /*!
+   * The corners of cell (i,j,k) are at (xs[i], ys[j], zs[k]) and the next
+   * coordinates, the cell size is delta. The triangles are added to mesh.
+   */
+  SurfaceNets(const std::vector<float> & xs, const std::vector<float> & ys, const std::vector<float> & zs,
+              float delta, IndexedMesh & mesh);
+  virtual ~SurfaceNets() { }
+
+  /*!
+   * Adds the vertices of slab i, and the quads of the edges in the slab and
+   * of the edges between it and slab i-1, see MarchingCubes::addSlab(). The
+   * slabs are added in increasing order, and for the quads between two slabs
+   * without a slab left out.
+   */
+  void addSlab(int i, const float * slab0, const float * slab1, const unsigned char * cells = NULL);
+
+  /*!
+   * Makes this the extractor of the chunk of slabs firstSlab to endSlab-1. The
+   * chunk is given slabs from firstSlab - CHUNK_OVERLAP, the first one only for
+   * the vertices of the quads between it and slab firstSlab.
+   */
+  void setChunk(int firstSlab, int endSlab);
+
+  //! Adds normals to the vertices, see MarchingCubes::setGradients()
+  void setGradients(const Function3D<Vector3<float> > * gradients) { mGradients = gradients; }
+
+  //! Number of slabs before the first slab of a chunk it needs
+  static const int CHUNK_OVERLAP = 1;
+
+  //! Appends the meshes of chunks to mesh, see MarchingCubes::merge()
+  static void merge(const std::vector<SurfaceNets *> & chunks, IndexedMesh & mesh);
+
+protected :
+  //! Marks cells without a vertex
+  static const unsigned int NONE;
+
+  /*!
+   * Returns the position of the vertex of a cell with corner values ordered as
+   * for ::triangulate(), in cell coordinates from 0 to 1
+   */
+  virtual Vector3<float> placeVertex(const float voxelValues[8]) const;
+
+  //! Adds the quad v0 v1 v2 v3, reversed if flip is set, unless one of them is NONE
+  void addQuad(unsigned int v0, unsigned int v1, unsigned int v2, unsigned int v3, bool flip);
+
+  std::vector<float> mXs, mYs, mZs;
+  float mDelta;
+  IndexedMesh & mMesh;
+  //! The gradients for the normals of the vertices, or NULL
+  const Function3D<Vector3<float> > * mGradients;
+
+  //! The last slab added
+  int mSlab;
+  //! Vertex indices of the cells of the last two slabs added, at j*(zs.size()-1) + k
+  std::vector<unsigned int> mCells[2];
+
+  //! The first slab of the chunk, the quads of earlier slabs are not added
+  int mFirstSlab;
+  //! Number of vertices of the slabs before the first slab of the chunk
+  unsigned int mFirstVerts;
+  //! Range of the vertices of the last slab added
+  unsigned int mLastVerts[2];
+};
+
+
+/*! \brief Dual contouring, surface nets with the vertices fitted to the surface
+ *
+ * The vertex of a cell is placed where the tangent planes at the crossings on
+ * its edges meet best, in the least squares sense, which puts it on edges and
+ * corners of the surface that surface nets round off. The normals are those of
+ * the trilinear interpolation of the corner values, so no more values than for
+ * surface nets are needed. The fit is pulled slightly towards the mean of the
+ * crossings, which decides the position along flat and creased parts, and the
+ * vertex is kept inside its cell.
+ */
+class DualContouring : public SurfaceNets
+{
+public :
+  DualContouring(const std::vector<float> & xs, const std::vector<float> & ys, const std::vector<float> & zs,
+                 float delta, IndexedMesh & mesh) : SurfaceNets(xs, ys, zs, delta, mesh) { }
+
+  //! Appends the meshes of chunks to mesh, see MarchingCubes::merge()
+  static void merge(const std::vector<DualContouring *> & chunks, IndexedMesh & mesh);
+
+protected :
+  //! Weight of the distance to the mean of the crossings in the fit
+  static const float MASS_POINT_WEIGHT;
+
+  virtual Vector3<float> placeVertex(const float voxelValues[8]) const;
+};
+
+#endif
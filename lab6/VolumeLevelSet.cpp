@@ -1,5 +1,6 @@
 #include "VolumeLevelSet.h"
 #include "ColorMap.h"
+#include "ObjIO.h"
 
 const float VolumeLevelSet::mInsideConstant = 0.5; //0.5
 
@@ -13,6 +14,12 @@ VolumeLevelSet::VolumeLevelSet(float dx, const Implicit & impl) : LevelSet(dx, i
   commonConstructorOps();
 }
 
+VolumeLevelSet::VolumeLevelSet(float dx, const Implicit & impl, float bandWidth, float maxGradient)
+  : LevelSet(dx, impl, bandWidth, maxGradient)
+{
+  commonConstructorOps();
+}
+
 VolumeLevelSet::~VolumeLevelSet()
 {
 	delete mVelocityField;
@@ -74,19 +81,36 @@ void VolumeLevelSet::buildMasks()
 	mVolumeMask.clear();
 	mInsideMask.clear();
 
+	// Loop over the grid block by block, constant blocks outside
+	// the fluid are skipped without touching their grid points
 	Vector3<unsigned int> gridDim = mGrid.getDimensions();
-	for (unsigned int i = 0; i < gridDim.x(); i++){
-    for (unsigned int j = 0; j < gridDim.y(); j++){
-      for (unsigned int k = 0; k < gridDim.z(); k++){
-				if (mGrid.getValue(i,j,k) < mGrid.getOutsideConstant())
-				{
-          mVolumeMask.push_back(Vector3<unsigned int>(i,j,k));
-				}
-
-				if (mGrid.getValue(i,j,k) <= mInsideConstant*mDx)
-				{
-          mInsideBoolMask->setValue(i,j,k, true);
-          mInsideMask.push_back(Vector3<unsigned int>(i,j,k));
+	const int blockDim = LevelSetGrid::getBlockDim();
+	for (unsigned int bi = 0; bi*blockDim < gridDim.x(); bi++){
+    for (unsigned int bj = 0; bj*blockDim < gridDim.y(); bj++){
+      for (unsigned int bk = 0; bk*blockDim < gridDim.z(); bk++){
+				float blockValue;
+				if (mGrid.isConstantBlock(bi,bj,bk, blockValue) &&
+				    blockValue >= mGrid.getOutsideConstant() && blockValue > mInsideConstant*mDx)
+					continue;
+
+				const unsigned int iEnd = std::min((bi+1)*blockDim, gridDim.x());
+				const unsigned int jEnd = std::min((bj+1)*blockDim, gridDim.y());
+				const unsigned int kEnd = std::min((bk+1)*blockDim, gridDim.z());
+				for (unsigned int i = bi*blockDim; i < iEnd; i++){
+					for (unsigned int j = bj*blockDim; j < jEnd; j++){
+						for (unsigned int k = bk*blockDim; k < kEnd; k++){
+							if (mGrid.getValue(i,j,k) < mGrid.getOutsideConstant())
+							{
+                mVolumeMask.push_back(Vector3<unsigned int>(i,j,k));
+							}
+
+							if (mGrid.getValue(i,j,k) <= mInsideConstant*mDx)
+							{
+                mInsideBoolMask->setValue(i,j,k, true);
+                mInsideMask.push_back(Vector3<unsigned int>(i,j,k));
+							}
+						}
+					}
 				}
 			}
 		}
@@ -324,6 +348,56 @@ void VolumeLevelSet::buildAdvectionField()
 	}
 }
 
+bool VolumeLevelSet::streamTriangulation(std::ostream & os, float sampleDensity, float maxGradient) const
+{
+  // The cells of the narrow band in grid coordinates, as for triangulate(),
+  // written out every time the extraction moves on to the next slab
+  std::vector<Vector3<int> > cells(mVolumeMask);
+  std::sort(cells.begin(), cells.end());
+
+  const Vector3<int> dim(mGrid.getDimX(), mGrid.getDimY(), mGrid.getDimZ());
+  std::vector<float> xs(dim.x()+1), ys(dim.y()+1), zs(dim.z()+1);
+  for (int i = 0; i <= dim.x(); i++) xs[i] = i;
+  for (int j = 0; j <= dim.y(); j++) ys[j] = j;
+  for (int k = 0; k <= dim.z(); k++) zs[k] = k;
+
+  IndexedMesh mesh;
+  MarchingCubes marchingCubes(xs, ys, zs, 1.f, mesh);
+  ObjIO objIO;
+  const Bbox b = getBoundingBox();
+  bool success = true;
+
+  std::cerr << "Triangulating (VolLS) to stream [";
+  for (unsigned int p = 0; p < cells.size() && success; p++) {
+    const Vector3<int>& pos = cells[p];
+    int i = pos.x();
+    int j = pos.y();
+    int k = pos.z();
+
+    float voxelValues[8] = {
+      mGrid.getValue(i,j,k),
+      mGrid.getValue(i+1, j, k),
+      mGrid.getValue(i+1, j+1, k),
+      mGrid.getValue(i, j+1, k),
+      mGrid.getValue(i, j, k+1),
+      mGrid.getValue(i+1, j, k+1),
+      mGrid.getValue(i+1, j+1, k+1),
+      mGrid.getValue(i, j+1, k+1)
+    };
+    marchingCubes.addCell(i, j, k, voxelValues);
+
+    if (p+1 == cells.size() || cells[p+1].x() != i) {
+      for (unsigned int n = 0; n < mesh.mVerts.size(); n++)
+        mesh.mVerts[n] = mesh.mVerts[n]*mDx + b.pMin;
+      success = objIO.saveIndexed(mesh, os);
+      if (i % std::max(dim.x() / 30, 1) == 0)
+        std::cerr << "=";
+    }
+  }
+  std::cerr << "] done" << std::endl;
+  return success;
+}
+
 NavierStokesVectorField* VolumeLevelSet::getAdvectionField()
 {
 	Matrix4x4<float> worldToObj = getTransform().inverse();
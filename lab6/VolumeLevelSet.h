@@ -11,6 +11,7 @@
 #include "GL/glut.h"
 #endif
 #include <vector>
+#include <algorithm>
 
 class VolumeLevelSet : public LevelSet{
 public:
@@ -19,6 +20,8 @@ public:
 
   	VolumeLevelSet(float dx);
   	VolumeLevelSet(float dx, const Implicit & impl);
+    //! Samples impl only near the interface, see LevelSet::LevelSet()
+  	VolumeLevelSet(float dx, const Implicit & impl, float bandWidth, float maxGradient = 1);
     ~VolumeLevelSet();
 
     virtual void setBoundingBox(const Bbox & b);
@@ -40,7 +43,13 @@ public:
     void buildAdvectionField();
     NavierStokesVectorField* getAdvectionField();
 
-    template <class MeshType> void triangulate(float sampleDensity);
+    /*!
+     * See Implicit::triangulate(), over the cells of the narrow band. The
+     * band already skips the empty space, so maxGradient is ignored
+     */
+    template <class MeshType> void triangulate(float sampleDensity, float maxGradient = 0, bool normals = false);
+    //! Writes the mesh of triangulate() to os, see Implicit::streamTriangulation()
+    virtual bool streamTriangulation(std::ostream & os, float sampleDensity, float maxGradient = 0) const;
 
 protected:
       void clearDisplayList();
@@ -63,7 +72,7 @@ protected:
 
 
 template <class MeshType>
-void VolumeLevelSet::triangulate(float delta)
+void VolumeLevelSet::triangulate(float delta, float /*maxGradient*/, bool normals)
 {
   if (mMesh != NULL) {
     delete mMesh;
@@ -76,39 +85,73 @@ void VolumeLevelSet::triangulate(float delta)
   // Get axis aligned bounding box (in world space)
   Bbox b = getBoundingBox();
 
-  // Prepare progress bar
-  unsigned int totalSamples = mVolumeMask.size();
-  unsigned int currentSample = 0;
-  unsigned int reportFreq = totalSamples / 30;
+  // The cells are extracted in grid coordinates, slab by slab along x
+  std::vector<Vector3<int> > cells(mVolumeMask);
+  std::sort(cells.begin(), cells.end());
+
+  const Vector3<int> dim = mGrid.getDimensions();
+  std::vector<float> xs(dim.x()+1), ys(dim.y()+1), zs(dim.z()+1);
+  for (int i = 0; i <= dim.x(); i++) xs[i] = i;
+  for (int j = 0; j <= dim.y(); j++) ys[j] = j;
+  for (int k = 0; k <= dim.z(); k++) zs[k] = k;
+
+  // One chunk of slabs per thread, see Implicit::triangulate(). The cells of
+  // chunk c are cells[chunkCells[c]] to cells[chunkCells[c+1]-1]
+  const int numChunks = std::max(std::min(MarchingCubes::getNumThreads(), dim.x()), 1);
+  std::vector<IndexedMesh> chunkMeshes(numChunks);
+  std::vector<MarchingCubes *> chunks(numChunks);
+  std::vector<unsigned int> chunkCells(numChunks+1, cells.size());
+  const GradientField gradientField(*this, mDx, b.pMin);
+  chunkCells[0] = 0;
+  for (int c = numChunks-1, p = cells.size(); c > 0; c--) {
+    while (p > 0 && cells[p-1].x() >= dim.x()*c/numChunks) p--;
+    chunkCells[c] = p;
+  }
+
+  // Prepare progress bar, reported by the first chunk
+  unsigned int reportFreq = std::max((chunkCells[1] - chunkCells[0]) / 30, 1u);
 
   // Loop over narrow band
   std::cerr << "Triangulating (VolLS) [";
-
-  for (unsigned int p = 0; p < mVolumeMask.size(); p++) {
-    const Vector3<int>& pos = mVolumeMask[p];
-    int i = pos.x();
-    int j = pos.y();
-    int k = pos.z();
-
-    float voxelValues[8] = {
-      mGrid.getValue(i,j,k),
-      mGrid.getValue(i+1, j, k),
-      mGrid.getValue(i+1, j+1, k),
-      mGrid.getValue(i, j+1, k),
-      mGrid.getValue(i, j, k+1),
-      mGrid.getValue(i+1, j, k+1),
-      mGrid.getValue(i+1, j+1, k+1),
-      mGrid.getValue(i, j+1, k+1)
-    };
-    std::vector<Vector3<float> > tris = ::triangulate(voxelValues, i, j, k, delta);
-    for(unsigned int n = 0; n < tris.size(); n+=3){
-      mMesh->addTriangle(tris.at(n)*mDx + b.pMin, tris.at(n+2)*mDx + b.pMin, tris.at(n+1)*mDx + b.pMin); // triangulation uses clockwise orientation
+#pragma omp parallel for schedule(static, 1) num_threads(numChunks)
+  for (int c = 0; c < numChunks; c++) {
+    chunks[c] = new MarchingCubes(xs, ys, zs, delta, chunkMeshes[c]);
+    chunks[c]->setChunk(dim.x()*c/numChunks, dim.x()*(c+1)/numChunks);
+    chunks[c]->setGradients(normals ? &gradientField : NULL);
+
+    for (unsigned int p = chunkCells[c]; p < chunkCells[c+1]; p++) {
+      const Vector3<int>& pos = cells[p];
+      int i = pos.x();
+      int j = pos.y();
+      int k = pos.z();
+
+      float voxelValues[8] = {
+        mGrid.getValue(i,j,k),
+        mGrid.getValue(i+1, j, k),
+        mGrid.getValue(i+1, j+1, k),
+        mGrid.getValue(i, j+1, k),
+        mGrid.getValue(i, j, k+1),
+        mGrid.getValue(i+1, j, k+1),
+        mGrid.getValue(i+1, j+1, k+1),
+        mGrid.getValue(i, j+1, k+1)
+      };
+      chunks[c]->addCell(i, j, k, voxelValues);
+
+      if (c == 0 && (p + 1) % reportFreq == 0)
+        std::cerr << "=";
     }
-
-    currentSample++;
-    if (currentSample % reportFreq == 0)
-      std::cerr << "=";
   }
+
+  IndexedMesh indexed;
+  MarchingCubes::merge(chunks, indexed);
+  for (int c = 0; c < numChunks; c++)
+    delete chunks[c];
+
+  for (unsigned int n = 0; n < indexed.mVerts.size(); n++)
+    indexed.mVerts[n] = indexed.mVerts[n]*mDx + b.pMin;
+  mMesh->buildFromIndexed(indexed.mVerts, indexed.mIndices);
+  if (normals)
+    mMesh->setVertexNormals(indexed.mNormals);
   std::cerr << "] done" << std::endl;
 }
 